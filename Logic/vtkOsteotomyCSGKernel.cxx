@@ -0,0 +1,237 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyCSGKernel.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+# include <intrin.h>
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+# include <arm_neon.h>
+#endif
+
+namespace
+{
+bool ForceScalar = false;
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+//----------------------------------------------------------------------------
+// NEON is part of the aarch64 base architecture, so no run-time check is needed
+void EvaluateNEON(const int* code, int codeSize, const double* planes, int stackDepth,
+                  const double* x, const double* y, const double* z, vtkIdType n,
+                  double* values, double* stack)
+{
+  const int B = vtkOsteotomyCSGKernel::BlockSize;
+  const vtkIdType fullBlocks = n - n % B;
+  for (vtkIdType start = 0; start < fullBlocks; start += B)
+    {
+    double* top = stack - B;
+    for (int pc = 0; pc < codeSize; pc++)
+      {
+      const int instruction = code[pc];
+      if (instruction >= 0)
+        {
+        top += B;
+        const double* p = planes + 4*instruction;
+        const float64x2_t a = vdupq_n_f64(p[0]);
+        const float64x2_t b = vdupq_n_f64(p[1]);
+        const float64x2_t c = vdupq_n_f64(p[2]);
+        const float64x2_t d = vdupq_n_f64(p[3]);
+        for (int j = 0; j < B; j += 2)
+          {
+          float64x2_t v = vaddq_f64(vmulq_f64(a, vld1q_f64(x + start + j)),
+                                    vmulq_f64(b, vld1q_f64(y + start + j)));
+          v = vaddq_f64(v, vmulq_f64(c, vld1q_f64(z + start + j)));
+          vst1q_f64(top + j, vaddq_f64(v, d));
+          }
+        }
+      else
+        {
+        double* below = top - B;
+        const bool isUnion = (instruction == vtkOsteotomyCSGKernel::Union);
+        for (int j = 0; j < B; j += 2)
+          {
+          const float64x2_t t = vld1q_f64(top + j);
+          const float64x2_t u = vld1q_f64(below + j);
+          const uint64x2_t takeTop = isUnion ? vcltq_f64(t, u) : vcgtq_f64(t, u);
+          vst1q_f64(below + j, vbslq_f64(takeTop, t, u));
+          }
+        top = below;
+        }
+      }
+    for (int j = 0; j < B; j++)
+      {
+      values[start + j] = top[j];
+      }
+    }
+  vtkOsteotomyCSGKernel::EvaluateScalar(code, codeSize, planes, stackDepth,
+                                        x + fullBlocks, y + fullBlocks, z + fullBlocks,
+                                        n - fullBlocks, values + fullBlocks, stack);
+}
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGKernel::EvaluateScalar(
+  const int* code, int codeSize, const double* planes, int /*stackDepth*/,
+  const double* x, const double* y, const double* z, vtkIdType n,
+  double* values, double* stack)
+{
+  const int B = BlockSize;
+  for (vtkIdType start = 0; start < n; start += B)
+    {
+    const int count = (n - start < B) ? static_cast<int>(n - start) : B;
+    const double* bx = x + start;
+    const double* by = y + start;
+    const double* bz = z + start;
+    double* top = stack - B;
+    for (int pc = 0; pc < codeSize; pc++)
+      {
+      const int instruction = code[pc];
+      if (instruction >= 0)
+        {
+        top += B;
+        const double* p = planes + 4*instruction;
+        const double a = p[0], b = p[1], c = p[2], d = p[3];
+        for (int j = 0; j < count; j++)
+          {
+          double v = a*bx[j] + b*by[j];
+          v = v + c*bz[j];
+          top[j] = v + d;
+          }
+        }
+      else
+        {
+        double* below = top - B;
+        if (instruction == vtkOsteotomyCSGKernel::Union)
+          {
+          for (int j = 0; j < count; j++)
+            {
+            below[j] = top[j] < below[j] ? top[j] : below[j];
+            }
+          }
+        else
+          {
+          for (int j = 0; j < count; j++)
+            {
+            below[j] = top[j] > below[j] ? top[j] : below[j];
+            }
+          }
+        top = below;
+        }
+      }
+    for (int j = 0; j < count; j++)
+      {
+      values[start + j] = top[j];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCSGKernel::KernelType vtkOsteotomyCSGKernel::GetNEONKernel()
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+  return EvaluateNEON;
+#else
+  return 0;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyCSGKernel::CPUHasAVX2()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int info[4];
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx)
+    {
+    return false;
+    }
+  // The operating system must save the YMM registers
+  if ((_xgetbv(0) & 0x6) != 0x6)
+    {
+    return false;
+    }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCSGKernel::KernelType vtkOsteotomyCSGKernel::SelectKernel()
+{
+  if (GetAVX2Kernel() && CPUHasAVX2())
+    {
+    return GetAVX2Kernel();
+    }
+  if (GetNEONKernel())
+    {
+    return GetNEONKernel();
+    }
+  return EvaluateScalar;
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCSGKernel::KernelType vtkOsteotomyCSGKernel::GetKernel()
+{
+  if (ForceScalar)
+    {
+    return EvaluateScalar;
+    }
+  // Initialized once, on the first call; the compiler guards the initialization
+  // of a local static against the clip threads calling it together
+  static const KernelType selectedKernel = SelectKernel();
+  return selectedKernel;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGKernel::SetForceScalar(bool force)
+{
+  ForceScalar = force;
+}
+
+//----------------------------------------------------------------------------
+const char* vtkOsteotomyCSGKernel::GetKernelName()
+{
+  KernelType kernel = GetKernel();
+  if (kernel == GetAVX2Kernel())
+    {
+    return "AVX2";
+    }
+  if (kernel == GetNEONKernel())
+    {
+    return "NEON";
+    }
+  return "Scalar";
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGKernel::Evaluate(
+  const int* code, int codeSize, const double* planes, int stackDepth,
+  const double* x, const double* y, const double* z, vtkIdType n,
+  double* values, double* stack)
+{
+  GetKernel()(code, codeSize, planes, stackDepth, x, y, z, n, values, stack);
+}
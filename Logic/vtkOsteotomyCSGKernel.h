@@ -0,0 +1,85 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyCSGKernel - batched evaluation of a postfix CSG program
+// .SECTION Description
+// vtkOsteotomyCSGKernel runs the instructions of a vtkOsteotomyCSGProgram on
+// points stored as separate x, y and z arrays (SoA). Points are processed in
+// blocks of BlockSize: every plane is evaluated for the whole block at once
+// and the results are folded by the min/max instructions. An AVX2 kernel
+// (x86) or a NEON kernel (aarch64) is selected at run time; other machines
+// use the scalar kernel. All kernels use separate multiplies and adds, and
+// the library is built with -ffp-contract=off, so they return bit-identical
+// values.
+// This class is internal to the logic library.
+
+#ifndef __vtkOsteotomyCSGKernel_h
+#define __vtkOsteotomyCSGKernel_h
+
+// VTK includes
+#include <vtkType.h>
+
+class vtkOsteotomyCSGKernel
+{
+public:
+  /// Number of points evaluated together.
+  enum { BlockSize = 16 };
+
+  /// Instruction codes. Non-negative instructions push the distance to the plane of that slot.
+  enum Instruction
+  {
+    Union = -1,        // pop two values, push the minimum
+    Intersection = -2  // pop two values, push the maximum
+  };
+
+  /// Signature shared by all kernels. The stack must hold stackDepth*BlockSize doubles.
+  typedef void (*KernelType)(const int* code, int codeSize, const double* planes, int stackDepth,
+                             const double* x, const double* y, const double* z, vtkIdType n,
+                             double* values, double* stack);
+
+  /// Evaluate n points with the best kernel of this machine.
+  static void Evaluate(const int* code, int codeSize, const double* planes, int stackDepth,
+                       const double* x, const double* y, const double* z, vtkIdType n,
+                       double* values, double* stack);
+
+  /// Portable kernel, also used for the tail of the vectorized kernels.
+  static void EvaluateScalar(const int* code, int codeSize, const double* planes, int stackDepth,
+                             const double* x, const double* y, const double* z, vtkIdType n,
+                             double* values, double* stack);
+
+  /// The AVX2 kernel, or NULL if the library was built without AVX2 support.
+  static KernelType GetAVX2Kernel();
+
+  /// The NEON kernel, or NULL if the library was built for another architecture.
+  static KernelType GetNEONKernel();
+
+  /// Name of the kernel used by Evaluate(): "AVX2", "NEON" or "Scalar".
+  static const char* GetKernelName();
+
+  /// Force the scalar kernel, e.g. to compare results. Off by default.
+  /// Must not be called while points are being evaluated.
+  static void SetForceScalar(bool force);
+
+protected:
+  /// The kernel used by Evaluate(). The best kernel of the machine is
+  /// selected once, on the first call.
+  static KernelType GetKernel();
+  static KernelType SelectKernel();
+  static bool CPUHasAVX2();
+};
+
+#endif
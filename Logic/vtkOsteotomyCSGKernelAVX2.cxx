@@ -0,0 +1,117 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// This file is compiled with AVX2 code generation enabled (see CMakeLists.txt).
+// Nothing in it may run before vtkOsteotomyCSGKernel has checked the CPU, and
+// it only includes headers without inline code that other files could share.
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyCSGKernel.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace
+{
+//----------------------------------------------------------------------------
+// Multiplies and adds are kept separate (no FMA) so the values are
+// bit-identical to the scalar kernel.
+void EvaluateAVX2(const int* code, int codeSize, const double* planes, int stackDepth,
+                  const double* x, const double* y, const double* z, vtkIdType n,
+                  double* values, double* stack)
+{
+  const int B = vtkOsteotomyCSGKernel::BlockSize;
+  const vtkIdType fullBlocks = n - n % B;
+  for (vtkIdType start = 0; start < fullBlocks; start += B)
+    {
+    // A block of 16 points fits in 12 registers
+    __m256d bx[4], by[4], bz[4];
+    for (int k = 0; k < 4; k++)
+      {
+      bx[k] = _mm256_loadu_pd(x + start + 4*k);
+      by[k] = _mm256_loadu_pd(y + start + 4*k);
+      bz[k] = _mm256_loadu_pd(z + start + 4*k);
+      }
+
+    double* top = stack - B;
+    for (int pc = 0; pc < codeSize; pc++)
+      {
+      const int instruction = code[pc];
+      if (instruction >= 0)
+        {
+        top += B;
+        const double* p = planes + 4*instruction;
+        const __m256d a = _mm256_broadcast_sd(p);
+        const __m256d b = _mm256_broadcast_sd(p + 1);
+        const __m256d c = _mm256_broadcast_sd(p + 2);
+        const __m256d d = _mm256_broadcast_sd(p + 3);
+        for (int k = 0; k < 4; k++)
+          {
+          __m256d v = _mm256_add_pd(_mm256_mul_pd(a, bx[k]), _mm256_mul_pd(b, by[k]));
+          v = _mm256_add_pd(v, _mm256_mul_pd(c, bz[k]));
+          _mm256_storeu_pd(top + 4*k, _mm256_add_pd(v, d));
+          }
+        }
+      else
+        {
+        double* below = top - B;
+        if (instruction == vtkOsteotomyCSGKernel::Union)
+          {
+          for (int k = 0; k < 4; k++)
+            {
+            _mm256_storeu_pd(below + 4*k, _mm256_min_pd(_mm256_loadu_pd(top + 4*k),
+                                                        _mm256_loadu_pd(below + 4*k)));
+            }
+          }
+        else
+          {
+          for (int k = 0; k < 4; k++)
+            {
+            _mm256_storeu_pd(below + 4*k, _mm256_max_pd(_mm256_loadu_pd(top + 4*k),
+                                                        _mm256_loadu_pd(below + 4*k)));
+            }
+          }
+        top = below;
+        }
+      }
+    for (int k = 0; k < 4; k++)
+      {
+      _mm256_storeu_pd(values + start + 4*k, _mm256_loadu_pd(top + 4*k));
+      }
+    }
+  vtkOsteotomyCSGKernel::EvaluateScalar(code, codeSize, planes, stackDepth,
+                                        x + fullBlocks, y + fullBlocks, z + fullBlocks,
+                                        n - fullBlocks, values + fullBlocks, stack);
+}
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCSGKernel::KernelType vtkOsteotomyCSGKernel::GetAVX2Kernel()
+{
+  return EvaluateAVX2;
+}
+
+#else
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCSGKernel::KernelType vtkOsteotomyCSGKernel::GetAVX2Kernel()
+{
+  return 0;
+}
+
+#endif
@@ -0,0 +1,301 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyCSGProgram.h"
+#include "vtkOsteotomyPlaneChain.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <algorithm>
+
+namespace
+{
+// Points transposed to SoA together. Small enough for the three coordinate
+// arrays to stay in the first level cache.
+const int ChunkSize = 1024;
+
+//----------------------------------------------------------------------------
+template <class T>
+void EvaluateChunks(const int* code, int codeSize, const double* planes, int stackDepth,
+                    const T* xyz, vtkIdType n, double* values)
+{
+  std::vector<double> soa(3*ChunkSize);
+  std::vector<double> stack(static_cast<size_t>(stackDepth) * vtkOsteotomyCSGKernel::BlockSize);
+  double* x = &soa[0];
+  double* y = x + ChunkSize;
+  double* z = y + ChunkSize;
+  for (vtkIdType start = 0; start < n; start += ChunkSize)
+    {
+    const int count = static_cast<int>(std::min<vtkIdType>(ChunkSize, n - start));
+    const T* p = xyz + 3*start;
+    for (int j = 0; j < count; j++)
+      {
+      x[j] = static_cast<double>(p[3*j]);
+      y[j] = static_cast<double>(p[3*j+1]);
+      z[j] = static_cast<double>(p[3*j+2]);
+      }
+    vtkOsteotomyCSGKernel::Evaluate(code, codeSize, planes, stackDepth,
+                                    x, y, z, count, values + start, &stack[0]);
+    }
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkOsteotomyCSGProgram);
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCSGProgram::vtkOsteotomyCSGProgram()
+{
+  this->StackDepth = 0;
+  this->Chain = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCSGProgram::~vtkOsteotomyCSGProgram()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGProgram::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number Of Planes: " << this->GetNumberOfPlanes() << "\n";
+  os << indent << "Number Of Instructions: " << this->GetNumberOfInstructions() << "\n";
+  os << indent << "Stack Depth: " << this->StackDepth << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyCSGProgram::Compile(vtkOsteotomyPlaneChain* chain)
+{
+  this->Planes.clear();
+  this->PlaneIds.clear();
+  this->Code.clear();
+  this->StackDepth = 0;
+  this->Chain = chain;
+
+  if (!chain || chain->GetNumberOfPlanes() == 0)
+    {
+    this->Modified();
+    return false;
+    }
+
+  this->EmitBody(chain, chain->DetermineFirstPlaneOfClipping(), chain->GetNumberOfPlanes()-1);
+  if (chain->GetHasDepthPlane())
+    {
+    double abcd[4];
+    chain->GetDepthPlaneCoefficients(abcd);
+    this->Code.push_back(this->AddPlane(abcd, DepthPlaneId));
+    this->Code.push_back(Intersection);
+    }
+
+  // Depth of the stack after every instruction
+  int depth = 0;
+  for (size_t pc = 0; pc < this->Code.size(); pc++)
+    {
+    depth += (this->Code[pc] >= 0) ? 1 : -1;
+    this->StackDepth = std::max(this->StackDepth, depth);
+    }
+
+  this->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyCSGProgram::IsCompiledFrom(vtkOsteotomyPlaneChain* chain)
+{
+  // Compile() modifies the program, so it is newer than the chain it compiled
+  return chain && chain == this->Chain && this->GetMTime() > chain->GetMTime();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGProgram::EmitBody(vtkOsteotomyPlaneChain* chain, int m, int n)
+{
+  if (m == n)
+    {
+    double abcd[4];
+    chain->GetPlaneCoefficients(m, abcd);
+    this->Code.push_back(this->AddPlane(abcd, m));
+    return;
+    }
+
+  // Planes m..i-1 and i..n, joined as plane i meets plane i-1
+  int i = (n - m == 1) ? n : chain->GetSplitPlane(m, n);
+  this->EmitBody(chain, m, i-1);
+  this->EmitBody(chain, i, n);
+  this->Code.push_back(chain->IsPlaneInside(i) ? Intersection : Union);
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyCSGProgram::AddPlane(const double abcd[4], int planeId)
+{
+  this->Planes.insert(this->Planes.end(), abcd, abcd + 4);
+  this->PlaneIds.push_back(planeId);
+  return static_cast<int>(this->PlaneIds.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+double vtkOsteotomyCSGProgram::EvaluateFunction(const double x[3]) const
+{
+  if (this->Code.empty())
+    {
+    return 0.0;
+    }
+
+  // Interpreted directly; the batched path is only worth it for many points
+  double localStack[64];
+  std::vector<double> heapStack;
+  double* stack = localStack;
+  if (this->StackDepth > 64)
+    {
+    heapStack.resize(this->StackDepth);
+    stack = &heapStack[0];
+    }
+
+  int top = -1;
+  for (size_t pc = 0; pc < this->Code.size(); pc++)
+    {
+    const int instruction = this->Code[pc];
+    if (instruction >= 0)
+      {
+      const double* p = &this->Planes[4*instruction];
+      double v = p[0]*x[0] + p[1]*x[1];
+      v = v + p[2]*x[2];
+      stack[++top] = v + p[3];
+      }
+    else
+      {
+      const double v = stack[top--];
+      if (instruction == Union)
+        {
+        stack[top] = v < stack[top] ? v : stack[top];
+        }
+      else
+        {
+        stack[top] = v > stack[top] ? v : stack[top];
+        }
+      }
+    }
+  return stack[0];
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGProgram::EvaluateFunction(const float* xyz, vtkIdType n, double* values) const
+{
+  if (this->Code.empty() || n <= 0)
+    {
+    return;
+    }
+  EvaluateChunks(&this->Code[0], static_cast<int>(this->Code.size()), &this->Planes[0],
+                 this->StackDepth, xyz, n, values);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGProgram::EvaluateFunction(const double* xyz, vtkIdType n, double* values) const
+{
+  if (this->Code.empty() || n <= 0)
+    {
+    return;
+    }
+  EvaluateChunks(&this->Code[0], static_cast<int>(this->Code.size()), &this->Planes[0],
+                 this->StackDepth, xyz, n, values);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGProgram::EvaluateFunction(vtkDataArray* points, vtkDoubleArray* values) const
+{
+  if (!points || !values || points->GetNumberOfComponents() != 3)
+    {
+    return;
+    }
+
+  vtkIdType n = points->GetNumberOfTuples();
+  values->SetNumberOfComponents(1);
+  values->SetNumberOfTuples(n);
+  double* output = values->GetPointer(0);
+
+  if (vtkFloatArray* floats = vtkFloatArray::SafeDownCast(points))
+    {
+    this->EvaluateFunction(floats->GetPointer(0), n, output);
+    }
+  else if (vtkDoubleArray* doubles = vtkDoubleArray::SafeDownCast(points))
+    {
+    this->EvaluateFunction(doubles->GetPointer(0), n, output);
+    }
+  else
+    {
+    // Other point types are rare in models; convert them once
+    std::vector<double> xyz(3*n);
+    for (vtkIdType i = 0; i < n; i++)
+      {
+      points->GetTuple(i, &xyz[3*i]);
+      }
+    this->EvaluateFunction(n > 0 ? &xyz[0] : 0, n, output);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCSGProgram::Fold(const double* const* columns, vtkIdType n, double* values) const
+{
+  if (this->Code.empty() || n <= 0)
+    {
+    return;
+    }
+
+  const int B = vtkOsteotomyCSGKernel::BlockSize;
+  std::vector<double> stack(static_cast<size_t>(this->StackDepth) * B);
+  for (vtkIdType start = 0; start < n; start += B)
+    {
+    const int count = static_cast<int>(std::min<vtkIdType>(B, n - start));
+    double* top = &stack[0] - B;
+    for (size_t pc = 0; pc < this->Code.size(); pc++)
+      {
+      const int instruction = this->Code[pc];
+      if (instruction >= 0)
+        {
+        top += B;
+        std::copy(columns[instruction] + start, columns[instruction] + start + count, top);
+        }
+      else
+        {
+        double* below = top - B;
+        if (instruction == Union)
+          {
+          for (int j = 0; j < count; j++)
+            {
+            below[j] = top[j] < below[j] ? top[j] : below[j];
+            }
+          }
+        else
+          {
+          for (int j = 0; j < count; j++)
+            {
+            below[j] = top[j] > below[j] ? top[j] : below[j];
+            }
+          }
+        top = below;
+        }
+      }
+    std::copy(top, top + count, values + start);
+    }
+}
@@ -0,0 +1,125 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyCSGProgram - flat postfix form of the osteotomy clipping body
+// .SECTION Description
+// vtkOsteotomyCSGProgram compiles the clipping body of a vtkOsteotomyPlaneChain
+// (the recursive union and intersection of its planes, and the depth plane)
+// into a postfix program over a contiguous array of plane coefficients (a,b,c,d).
+// Union nodes become a min instruction, intersection nodes a max
+// instruction. Many points are evaluated at once by vtkOsteotomyCSGKernel
+// (SIMD when the CPU supports it) with no virtual calls; the result is the
+// value a vtkImplicitBoolean tree of the same body returns from EvaluateFunction().
+
+#ifndef __vtkOsteotomyCSGProgram_h
+#define __vtkOsteotomyCSGProgram_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkOsteotomyCSGKernel.h"
+#include "vtkSlicerSmartModelClipModuleLogicExport.h"
+
+class vtkDataArray;
+class vtkDoubleArray;
+class vtkOsteotomyPlaneChain;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkOsteotomyCSGProgram :
+  public vtkObject
+{
+public:
+  static vtkOsteotomyCSGProgram *New();
+  vtkTypeMacro(vtkOsteotomyCSGProgram, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Instruction codes. Non-negative instructions push the distance to the plane of that slot.
+  enum Instruction
+  {
+    Union = vtkOsteotomyCSGKernel::Union,
+    Intersection = vtkOsteotomyCSGKernel::Intersection
+  };
+
+  /// Slot of the depth plane in PlaneIds.
+  enum { DepthPlaneId = -1 };
+
+  /// Compile the clipping function of the chain. Returns false if the chain has no plane.
+  bool Compile(vtkOsteotomyPlaneChain* chain);
+
+  /// True if the program was compiled from the chain after its last change,
+  /// so that filters sharing the program need not compile it again.
+  bool IsCompiledFrom(vtkOsteotomyPlaneChain* chain);
+
+  /// Number of planes referenced by the program, the depth plane included.
+  int GetNumberOfPlanes() const
+    { return static_cast<int>(this->PlaneIds.size()); }
+
+  /// Plane coefficients packed as (a,b,c,d) per slot.
+  const double* GetPlaneCoefficients() const
+    { return this->Planes.empty() ? 0 : &this->Planes[0]; }
+
+  /// Index of the chain plane stored in a slot, or DepthPlaneId.
+  int GetPlaneId(int slot) const
+    { return this->PlaneIds[slot]; }
+
+  int GetNumberOfInstructions() const
+    { return static_cast<int>(this->Code.size()); }
+  const int* GetInstructions() const
+    { return this->Code.empty() ? 0 : &this->Code[0]; }
+
+  /// Maximum depth of the evaluation stack.
+  int GetStackDepth() const
+    { return this->StackDepth; }
+
+  /// Evaluate the clipping function at a single point.
+  double EvaluateFunction(const double x[3]) const;
+
+  /// Evaluate the clipping function at n interleaved xyz points.
+  void EvaluateFunction(const float* xyz, vtkIdType n, double* values) const;
+  void EvaluateFunction(const double* xyz, vtkIdType n, double* values) const;
+
+  /// Evaluate the clipping function for every tuple of a 3-component array.
+  void EvaluateFunction(vtkDataArray* points, vtkDoubleArray* values) const;
+
+  /// Fold precomputed plane values: columns[slot][i] is the value of the plane
+  /// of that slot at point i. Gives the same values as EvaluateFunction().
+  void Fold(const double* const* columns, vtkIdType n, double* values) const;
+
+protected:
+  vtkOsteotomyCSGProgram();
+  virtual ~vtkOsteotomyCSGProgram();
+
+  void EmitBody(vtkOsteotomyPlaneChain* chain, int m, int n);
+  int AddPlane(const double abcd[4], int planeId);
+
+//BTX
+  std::vector<double> Planes;
+  std::vector<int> PlaneIds;
+  std::vector<int> Code;
+//ETX
+  int StackDepth;
+  vtkOsteotomyPlaneChain* Chain; // not referenced, only compared
+
+private:
+  vtkOsteotomyCSGProgram(const vtkOsteotomyCSGProgram&); // Not implemented
+  void operator=(const vtkOsteotomyCSGProgram&);          // Not implemented
+};
+
+#endif
@@ -0,0 +1,256 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyCellBlocks.h"
+#include "vtkOsteotomyCSGProgram.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+// STD includes
+#include <algorithm>
+
+namespace
+{
+//----------------------------------------------------------------------------
+void InitializeBounds(double* bounds)
+{
+  bounds[0] = bounds[2] = bounds[4] = VTK_DOUBLE_MAX;
+  bounds[1] = bounds[3] = bounds[5] = -VTK_DOUBLE_MAX;
+}
+
+//----------------------------------------------------------------------------
+void AddPoint(double* bounds, const double x[3])
+{
+  for (int i = 0; i < 3; i++)
+    {
+    bounds[2*i] = std::min(bounds[2*i], x[i]);
+    bounds[2*i+1] = std::max(bounds[2*i+1], x[i]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void AddBounds(double* bounds, const double* other)
+{
+  for (int i = 0; i < 3; i++)
+    {
+    bounds[2*i] = std::min(bounds[2*i], other[2*i]);
+    bounds[2*i+1] = std::max(bounds[2*i+1], other[2*i+1]);
+    }
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkOsteotomyCellBlocks);
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCellBlocks::vtkOsteotomyCellBlocks()
+{
+  this->Input = NULL;
+  this->InputMTime = 0;
+  this->NumberOfStraddlingBlocks = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyCellBlocks::~vtkOsteotomyCellBlocks()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCellBlocks::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number Of Blocks: " << this->GetNumberOfBlocks() << "\n";
+  os << indent << "Number Of Straddling Blocks: " << this->NumberOfStraddlingBlocks << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCellBlocks::Build(vtkPolyData* input)
+{
+  if (!input)
+    {
+    return;
+    }
+  if (input == this->Input && input->GetMTime() == this->InputMTime)
+    {
+    return;
+    }
+
+  vtkIdType numCells = input->GetNumberOfCells();
+  vtkIdType numBlocks = (numCells + BlockSize - 1) / BlockSize;
+  vtkIdType numGroups = (numBlocks + BlocksPerGroup - 1) / BlocksPerGroup;
+  this->BlockBounds.resize(6 * numBlocks);
+  this->GroupBounds.resize(6 * numGroups);
+  this->BlockClasses.assign(numBlocks, Straddling);
+
+  bool polygonsOnly = input->GetNumberOfVerts() == 0 && input->GetNumberOfLines() == 0 &&
+    input->GetNumberOfStrips() == 0;
+  if (!polygonsOnly)
+    {
+    input->BuildCells();
+    }
+
+  vtkIdType npts;
+  vtkIdType* pts;
+  vtkCellArray* polys = input->GetPolys();
+  if (polygonsOnly)
+    {
+    polys->InitTraversal();
+    }
+  for (vtkIdType block = 0; block < numBlocks; block++)
+    {
+    double* bounds = &this->BlockBounds[6*block];
+    InitializeBounds(bounds);
+    vtkIdType end = std::min((block + 1) * BlockSize, numCells);
+    for (vtkIdType cellId = block * BlockSize; cellId < end; cellId++)
+      {
+      if (polygonsOnly)
+        {
+        polys->GetNextCell(npts, pts);
+        }
+      else
+        {
+        input->GetCellPoints(cellId, npts, pts);
+        }
+      for (vtkIdType i = 0; i < npts; i++)
+        {
+        double x[3];
+        input->GetPoint(pts[i], x);
+        AddPoint(bounds, x);
+        }
+      }
+    }
+
+  for (vtkIdType group = 0; group < numGroups; group++)
+    {
+    double* bounds = &this->GroupBounds[6*group];
+    InitializeBounds(bounds);
+    vtkIdType end = std::min((group + 1) * BlocksPerGroup, numBlocks);
+    for (vtkIdType block = group * BlocksPerGroup; block < end; block++)
+      {
+      AddBounds(bounds, &this->BlockBounds[6*block]);
+      }
+    }
+
+  this->Input = input;
+  this->InputMTime = input->GetMTime();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCellBlocks::EvaluateRange(vtkOsteotomyCSGProgram* program,
+                                           const double bounds[6], double range[2])
+{
+  const int* code = program->GetInstructions();
+  const double* planes = program->GetPlaneCoefficients();
+  int codeSize = program->GetNumberOfInstructions();
+  if (codeSize == 0 || bounds[0] > bounds[1])
+    {
+    range[0] = range[1] = 0.0;
+    return;
+    }
+
+  std::vector<double> stack(2 * program->GetStackDepth());
+  int top = -1;
+  for (int pc = 0; pc < codeSize; pc++)
+    {
+    const int instruction = code[pc];
+    if (instruction >= 0)
+      {
+      // Range of a linear function over a box
+      const double* p = planes + 4*instruction;
+      double lo = p[3], hi = p[3];
+      for (int i = 0; i < 3; i++)
+        {
+        double a = p[i] * bounds[2*i];
+        double b = p[i] * bounds[2*i+1];
+        lo += std::min(a, b);
+        hi += std::max(a, b);
+        }
+      top++;
+      stack[2*top] = lo;
+      stack[2*top+1] = hi;
+      }
+    else
+      {
+      double lo = stack[2*top], hi = stack[2*top+1];
+      top--;
+      if (instruction == vtkOsteotomyCSGProgram::Union)
+        {
+        stack[2*top] = std::min(stack[2*top], lo);
+        stack[2*top+1] = std::min(stack[2*top+1], hi);
+        }
+      else
+        {
+        stack[2*top] = std::max(stack[2*top], lo);
+        stack[2*top+1] = std::max(stack[2*top+1], hi);
+        }
+      }
+    }
+  range[0] = stack[0];
+  range[1] = stack[1];
+}
+
+//----------------------------------------------------------------------------
+signed char vtkOsteotomyCellBlocks::ClassifyBounds(vtkOsteotomyCSGProgram* program,
+                                                   const double bounds[6])
+{
+  double range[2];
+  EvaluateRange(program, bounds, range);
+  if (range[0] > GetTolerance())
+    {
+    return Positive;
+    }
+  if (range[1] < -GetTolerance())
+    {
+    return Negative;
+    }
+  return Straddling;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyCellBlocks::Classify(vtkOsteotomyCSGProgram* program)
+{
+  this->NumberOfStraddlingBlocks = 0;
+  vtkIdType numBlocks = this->GetNumberOfBlocks();
+  vtkIdType numGroups = static_cast<vtkIdType>(this->GroupBounds.size() / 6);
+  for (vtkIdType group = 0; group < numGroups; group++)
+    {
+    vtkIdType begin = group * BlocksPerGroup;
+    vtkIdType end = std::min(begin + BlocksPerGroup, numBlocks);
+    signed char groupClass = ClassifyBounds(program, &this->GroupBounds[6*group]);
+    if (groupClass != Straddling)
+      {
+      std::fill(this->BlockClasses.begin() + begin, this->BlockClasses.begin() + end, groupClass);
+      continue;
+      }
+    for (vtkIdType block = begin; block < end; block++)
+      {
+      this->BlockClasses[block] = ClassifyBounds(program, &this->BlockBounds[6*block]);
+      if (this->BlockClasses[block] == Straddling)
+        {
+        this->NumberOfStraddlingBlocks++;
+        }
+      }
+    }
+}
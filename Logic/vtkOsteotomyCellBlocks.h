@@ -0,0 +1,117 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyCellBlocks - bounding boxes of consecutive cells for culling
+// .SECTION Description
+// vtkOsteotomyCellBlocks groups the cells of a polygonal model into blocks of
+// BlockSize consecutive cells and blocks into groups of BlocksPerGroup, and
+// keeps the bounding box of each. The boxes are rebuilt only when the model
+// changes. Classify() evaluates the clipping program on every box with
+// interval arithmetic: a box where the program is positive everywhere is
+// entirely reserved, a box where it is negative everywhere is entirely
+// clipped, and only the remaining boxes contain cells to cut. Groups are
+// tested first, so a model far from the planes is decided in a few tests.
+//
+// The boxes are tested against the infinite planes of the program. The finite
+// quads of the widgets cannot be used to cull: the clipping body extends every
+// plane beyond its quad, so a cell away from all quads can still be cut.
+
+#ifndef __vtkOsteotomyCellBlocks_h
+#define __vtkOsteotomyCellBlocks_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerSmartModelClipModuleLogicExport.h"
+
+class vtkOsteotomyCSGProgram;
+class vtkPolyData;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkOsteotomyCellBlocks :
+  public vtkObject
+{
+public:
+  static vtkOsteotomyCellBlocks *New();
+  vtkTypeMacro(vtkOsteotomyCellBlocks, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  enum
+  {
+    BlockSize = 256,
+    BlocksPerGroup = 64
+  };
+
+  /// Block classes returned by Classify()
+  enum
+  {
+    Straddling = 0,
+    Positive = 1,
+    Negative = -1
+  };
+
+  /// Compute the boxes of the cells of input. Nothing is done if the boxes
+  /// were built from the same model and the model did not change since.
+  void Build(vtkPolyData* input);
+
+  vtkIdType GetNumberOfBlocks() const
+    { return static_cast<vtkIdType>(this->BlockBounds.size() / 6); }
+
+  /// Classify every block with a compiled program.
+  void Classify(vtkOsteotomyCSGProgram* program);
+
+  /// Classes of the blocks computed by the last Classify().
+  const signed char* GetBlockClasses() const
+    { return this->BlockClasses.empty() ? 0 : &this->BlockClasses[0]; }
+  signed char GetBlockClass(vtkIdType cellId) const
+    { return this->BlockClasses[cellId / BlockSize]; }
+
+  /// Number of blocks left to cut by the last Classify().
+  vtkGetMacro(NumberOfStraddlingBlocks, vtkIdType);
+
+  /// Range of the program over a box, using interval arithmetic.
+  static void EvaluateRange(vtkOsteotomyCSGProgram* program, const double bounds[6],
+                            double range[2]);
+
+  /// Values closer to zero than this are not trusted to decide a box, in model units.
+  static double GetTolerance() { return 1e-6; }
+
+protected:
+  vtkOsteotomyCellBlocks();
+  virtual ~vtkOsteotomyCellBlocks();
+
+  static signed char ClassifyBounds(vtkOsteotomyCSGProgram* program, const double bounds[6]);
+
+  vtkPolyData* Input; // not referenced, only compared
+  unsigned long InputMTime;
+
+//BTX
+  std::vector<double> BlockBounds;
+  std::vector<double> GroupBounds;
+  std::vector<signed char> BlockClasses;
+//ETX
+  vtkIdType NumberOfStraddlingBlocks;
+
+private:
+  vtkOsteotomyCellBlocks(const vtkOsteotomyCellBlocks&); // Not implemented
+  void operator=(const vtkOsteotomyCellBlocks&);          // Not implemented
+};
+
+#endif
@@ -0,0 +1,316 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipHistory.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkZLibDataCompressor.h>
+
+// STD includes
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkOsteotomyClipHistory);
+
+//----------------------------------------------------------------------------
+vtkOsteotomyClipHistory::vtkOsteotomyClipHistory()
+{
+  this->MemoryBudget = 2 * 1024 * 1024; // 2 GiB
+  this->UseCount = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyClipHistory::~vtkOsteotomyClipHistory()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipHistory::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Memory Budget: " << this->MemoryBudget << " KiB\n";
+  os << indent << "Number Of Entries: " << this->GetNumberOfEntries() << "\n";
+  os << indent << "In Memory Size: " << this->GetInMemorySize() << " KiB\n";
+  os << indent << "Compressed Size: " << this->GetCompressedSize() << " KiB\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipHistory::SetMemoryBudget(unsigned long budget)
+{
+  if (this->MemoryBudget == budget)
+    {
+    return;
+    }
+  this->MemoryBudget = budget;
+  this->EnforceBudget(-1);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipHistory::AddEntry(vtkPolyData* polyData)
+{
+  if (!polyData)
+    {
+    return -1;
+    }
+  Entry entry;
+  entry.PolyData = polyData;
+  entry.UncompressedLength = 0;
+  entry.LastUse = ++this->UseCount;
+  this->Entries.push_back(entry);
+
+  int id = static_cast<int>(this->Entries.size()) - 1;
+  this->EnforceBudget(id);
+  this->Modified();
+  return id;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipHistory::RemoveEntry(int id)
+{
+  if (id < 0 || id >= this->GetNumberOfEntries())
+    {
+    return;
+    }
+  Entry& entry = this->Entries[id];
+  entry.PolyData = NULL;
+  std::vector<unsigned char>().swap(entry.Compressed);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipHistory::RemoveAllEntries()
+{
+  this->Entries.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyClipHistory::Restore(int id)
+{
+  if (id < 0 || id >= this->GetNumberOfEntries() || !this->Entries[id].PolyData)
+    {
+    return false;
+    }
+  this->Entries[id].LastUse = ++this->UseCount;
+  if (this->IsCompressed(id))
+    {
+    this->Decompress(id);
+    this->EnforceBudget(id);
+    this->Modified();
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipHistory::RestoreAllEntries()
+{
+  for (int id = 0; id < this->GetNumberOfEntries(); id++)
+    {
+    if (this->IsCompressed(id))
+      {
+      this->Decompress(id);
+      }
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkOsteotomyClipHistory::GetPolyData(int id)
+{
+  if (id < 0 || id >= this->GetNumberOfEntries())
+    {
+    return NULL;
+    }
+  return this->Entries[id].PolyData;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyClipHistory::IsCompressed(int id)
+{
+  if (id < 0 || id >= this->GetNumberOfEntries())
+    {
+    return false;
+    }
+  return !this->Entries[id].Compressed.empty();
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipHistory::GetNumberOfEntries()
+{
+  return static_cast<int>(this->Entries.size());
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkOsteotomyClipHistory::GetInMemorySize()
+{
+  unsigned long size = 0;
+  for (size_t i = 0; i < this->Entries.size(); i++)
+    {
+    const Entry& entry = this->Entries[i];
+    if (entry.PolyData && entry.Compressed.empty())
+      {
+      size += entry.PolyData->GetActualMemorySize();
+      }
+    }
+  return size;
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkOsteotomyClipHistory::GetCompressedSize()
+{
+  unsigned long size = 0;
+  for (size_t i = 0; i < this->Entries.size(); i++)
+    {
+    size += static_cast<unsigned long>(this->Entries[i].Compressed.size());
+    }
+  return size / 1024;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipHistory::EnforceBudget(int pinned)
+{
+  if (this->MemoryBudget == 0)
+    {
+    return;
+    }
+  unsigned long size = this->GetInMemorySize();
+  std::vector<bool> kept(this->Entries.size(), false); // could not be compressed
+  while (size > this->MemoryBudget)
+    {
+    int oldest = -1;
+    for (int i = 0; i < this->GetNumberOfEntries(); i++)
+      {
+      const Entry& entry = this->Entries[i];
+      if (i == pinned || kept[i] || !entry.PolyData || !entry.Compressed.empty() ||
+          entry.PolyData->GetNumberOfPoints() == 0)
+        {
+        continue;
+        }
+      if (oldest < 0 || entry.LastUse < this->Entries[oldest].LastUse)
+        {
+        oldest = i;
+        }
+      }
+    if (oldest < 0)
+      {
+      return; // only the pinned entry is left
+      }
+    unsigned long entrySize = this->Entries[oldest].PolyData->GetActualMemorySize();
+    if (!this->Compress(oldest))
+      {
+      kept[oldest] = true;
+      continue;
+      }
+    size -= std::min(size, entrySize);
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyClipHistory::Compress(int id)
+{
+  Entry& entry = this->Entries[id];
+  vtkPolyData* polyData = entry.PolyData;
+
+  // The reader takes the string length as an int, so an entry whose binary
+  // form may not fit stays in memory rather than being cut when restored
+  if (polyData->GetActualMemorySize() > static_cast<unsigned long>(VTK_INT_MAX / 1024))
+    {
+    vtkWarningMacro(<< "Compress: entry " << id << " is too large to be compressed, it is kept in memory");
+    return false;
+    }
+
+  // Models are acquired in single precision, so double points are narrowed
+  vtkSmartPointer<vtkPolyData> copy = vtkSmartPointer<vtkPolyData>::New();
+  copy->ShallowCopy(polyData);
+  if (polyData->GetPoints() && polyData->GetPoints()->GetDataType() != VTK_FLOAT)
+    {
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToFloat();
+    points->GetData()->DeepCopy(polyData->GetPoints()->GetData());
+    copy->SetPoints(points);
+    }
+
+  vtkSmartPointer<vtkPolyDataWriter> writer = vtkSmartPointer<vtkPolyDataWriter>::New();
+  writer->SetInput(copy);
+  writer->SetFileTypeToBinary();
+  writer->WriteToOutputStringOn();
+  writer->Write();
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(writer->GetOutputString());
+  if (!data || writer->GetOutputStringLength() <= 0)
+    {
+    vtkWarningMacro(<< "Compress: entry " << id << " cannot be written, it is kept in memory");
+    return false;
+    }
+  unsigned long length = static_cast<unsigned long>(writer->GetOutputStringLength());
+
+  vtkSmartPointer<vtkZLibDataCompressor> compressor = vtkSmartPointer<vtkZLibDataCompressor>::New();
+  std::vector<unsigned char> compressed(compressor->GetMaximumCompressionSpace(length));
+  unsigned long compressedLength =
+    compressor->Compress(data, length, &compressed[0], static_cast<unsigned long>(compressed.size()));
+  if (compressedLength == 0)
+    {
+    vtkErrorMacro(<< "Compress: cannot compress entry " << id);
+    return false;
+    }
+  compressed.resize(compressedLength);
+  entry.Compressed.swap(compressed);
+  entry.UncompressedLength = length;
+
+  // Empty the object in place, so that its observers keep a valid pointer
+  polyData->Initialize();
+  polyData->Modified();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipHistory::Decompress(int id)
+{
+  Entry& entry = this->Entries[id];
+  if (entry.UncompressedLength > static_cast<unsigned long>(VTK_INT_MAX))
+    {
+    vtkErrorMacro(<< "Decompress: entry " << id << " is too large to be read");
+    return;
+    }
+
+  vtkSmartPointer<vtkZLibDataCompressor> compressor = vtkSmartPointer<vtkZLibDataCompressor>::New();
+  std::vector<char> data(entry.UncompressedLength);
+  unsigned long length = compressor->Uncompress(
+    &entry.Compressed[0], static_cast<unsigned long>(entry.Compressed.size()),
+    reinterpret_cast<unsigned char*>(&data[0]), entry.UncompressedLength);
+  if (length != entry.UncompressedLength)
+    {
+    vtkErrorMacro(<< "Decompress: entry " << id << " is corrupted");
+    return;
+    }
+
+  vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
+  reader->ReadFromInputStringOn();
+  reader->SetBinaryInputString(&data[0], static_cast<int>(length));
+  reader->Update();
+
+  entry.PolyData->ShallowCopy(reader->GetOutput());
+  std::vector<unsigned char>().swap(entry.Compressed);
+  entry.UncompressedLength = 0;
+}
@@ -0,0 +1,120 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyClipHistory - clip results kept within a memory budget
+// .SECTION Description
+// vtkOsteotomyClipHistory keeps the poly data produced by successive clips.
+// The entries share their vtkPolyData objects with the caller (typically the
+// model nodes of the results). When the entries held in memory exceed
+// MemoryBudget, the least recently used ones are compressed: their geometry
+// is written in binary, with double points stored as float, compressed with
+// zlib, and the poly data object is emptied in place. Restore() decompresses
+// an entry back into the same object, so the observers of the poly data see
+// it come back. Entries too large for vtkPolyDataReader to read back from a
+// string, about 2 GiB, are never compressed.
+// Sizes are in kibibytes, as returned by vtkDataObject::GetActualMemorySize().
+// Arrays shared by several entries, such as the points of the two parts of a
+// clip, are counted once per entry.
+
+#ifndef __vtkOsteotomyClipHistory_h
+#define __vtkOsteotomyClipHistory_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerSmartModelClipModuleLogicExport.h"
+
+class vtkPolyData;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkOsteotomyClipHistory :
+  public vtkObject
+{
+public:
+  static vtkOsteotomyClipHistory *New();
+  vtkTypeMacro(vtkOsteotomyClipHistory, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Memory allowed to the uncompressed entries, in kibibytes.
+  /// Set to 0 to keep every entry in memory.
+  virtual void SetMemoryBudget(unsigned long budget);
+  vtkGetMacro(MemoryBudget, unsigned long);
+
+  /// Add the poly data as the most recently used entry and return its id.
+  /// Older entries may be compressed to stay within the budget.
+  int AddEntry(vtkPolyData* polyData);
+
+  /// Forget an entry, releasing its data. Ids of other entries do not change.
+  void RemoveEntry(int id);
+  void RemoveAllEntries();
+
+  /// Decompress the entry into its poly data if needed and mark it as the
+  /// most recently used. Other entries may be compressed to stay within the
+  /// budget. Returns false if the id is unknown.
+  bool Restore(int id);
+
+  /// Decompress every entry, ignoring the budget until the next Trim(), for
+  /// instance while the results are saved. The entries are decompressed one
+  /// after the other, each compressed buffer being released as soon as its
+  /// entry is back, but the peak memory is still the uncompressed size of the
+  /// whole history: GetInMemorySize() plus the uncompressed size of the
+  /// compressed entries, which may be well over MemoryBudget.
+  void RestoreAllEntries();
+
+  /// Compress the least recently used entries until the budget is met.
+  void Trim() { this->EnforceBudget(-1); }
+
+  vtkPolyData* GetPolyData(int id);
+  bool IsCompressed(int id);
+  int GetNumberOfEntries();
+
+  /// Memory used by the uncompressed entries and by the compressed ones.
+  unsigned long GetInMemorySize();
+  unsigned long GetCompressedSize();
+
+protected:
+  vtkOsteotomyClipHistory();
+  virtual ~vtkOsteotomyClipHistory();
+
+  /// Compress least recently used entries until the budget is met, but never pinned.
+  void EnforceBudget(int pinned);
+  bool Compress(int id);
+  void Decompress(int id);
+
+//BTX
+  struct Entry
+  {
+    vtkSmartPointer<vtkPolyData> PolyData; // NULL once removed
+    std::vector<unsigned char> Compressed; // empty while in memory
+    unsigned long UncompressedLength;
+    unsigned long LastUse;
+  };
+  std::vector<Entry> Entries;
+//ETX
+  unsigned long MemoryBudget;
+  unsigned long UseCount;
+
+private:
+  vtkOsteotomyClipHistory(const vtkOsteotomyClipHistory&); // Not implemented
+  void operator=(const vtkOsteotomyClipHistory&);          // Not implemented
+};
+
+#endif
@@ -0,0 +1,960 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyCellBlocks.h"
+#include "vtkOsteotomyClipProfiler.h"
+#include "vtkOsteotomyCSGProgram.h"
+#include "vtkOsteotomyPlanarClipper.h"
+#include "vtkOsteotomyPlaneChain.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkClipPolyData.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkGenericCell.h>
+#include <vtkIdList.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkMergePoints.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+const char* ClipFunctionArrayName = "OsteotomyClipFunction";
+
+// The work is split into chunks of fixed size, never by the number of
+// threads, so the output does not depend on how many threads run. A cell
+// chunk holds a whole number of vtkOsteotomyCellBlocks blocks.
+const vtkIdType PointChunkSize = 65536;
+const vtkIdType CellChunkSize = 128 * vtkOsteotomyCellBlocks::BlockSize;
+
+//----------------------------------------------------------------------------
+// Clipped cells of one chunk, with chunk-local point ids
+struct ClipChunk
+{
+  vtkSmartPointer<vtkPoints> Points;
+  vtkSmartPointer<vtkPointData> PointData;
+  vtkSmartPointer<vtkCellArray> Polys[2];
+  vtkSmartPointer<vtkCellData> CellData[2];
+};
+
+//----------------------------------------------------------------------------
+// Values of one plane at every point, computed by point chunk when needed
+struct PlaneColumn
+{
+  unsigned long MTime;
+  std::vector<std::vector<double> > Chunks;
+};
+
+//----------------------------------------------------------------------------
+struct ClipThreadData
+{
+  enum { EvaluateStage, ClipStage };
+  int Stage;
+
+  vtkOsteotomyCSGProgram* Program;
+  const float* FloatPoints;
+  const double* DoublePoints;
+  vtkPolyData* Input;
+  double Bounds[6];
+  vtkDoubleArray* ClipScalars;
+  int InsideOut;
+  std::vector<ClipChunk>* Chunks;
+
+  // Block culling: class of each block of cells and the points that need a
+  // value, both NULL when every point is evaluated and every cell is cut
+  const signed char* BlockClasses;
+  std::vector<unsigned char>* PointMask;
+
+  // Incremental clipping: plane columns of the program slots, values and
+  // block classes of the last clip, and the points whose value changed.
+  // Columns is NULL when the filter is not incremental.
+  std::vector<PlaneColumn*>* Columns;
+  std::vector<double>* PreviousValues;
+  const std::vector<signed char>* PreviousBlockClasses;
+  std::vector<unsigned char>* ChangedPoints;
+
+  // The first thread reports the progress of the stage between these bounds;
+  // every thread stops taking chunks once the filter is aborted
+  vtkAlgorithm* Filter;
+  double ProgressBegin;
+  double ProgressEnd;
+
+  vtkIdType NumberOfChunks;
+  vtkIdType NextChunk;
+  vtkMutexLock* Lock;
+};
+
+//----------------------------------------------------------------------------
+bool TakeChunk(ClipThreadData* data, vtkIdType& chunk)
+{
+  if (data->Filter->GetAbortExecute())
+    {
+    return false;
+    }
+  data->Lock->Lock();
+  chunk = data->NextChunk;
+  if (chunk < data->NumberOfChunks)
+    {
+    data->NextChunk++;
+    }
+  data->Lock->Unlock();
+  return chunk < data->NumberOfChunks;
+}
+
+//----------------------------------------------------------------------------
+// Flag the points used by the cells that have to be cut. Run on one thread:
+// the chunks share points, so threads would write the same flags.
+void MarkChunk(ClipThreadData* data, vtkIdType chunk)
+{
+  vtkPolyData* input = data->Input;
+  vtkIdType begin = chunk * CellChunkSize;
+  vtkIdType end = std::min(begin + CellChunkSize, input->GetNumberOfCells());
+  std::vector<unsigned char>& mask = *data->PointMask;
+  for (vtkIdType cellId = begin; cellId < end; cellId += vtkOsteotomyCellBlocks::BlockSize)
+    {
+    if (data->BlockClasses[cellId / vtkOsteotomyCellBlocks::BlockSize] !=
+        vtkOsteotomyCellBlocks::Straddling)
+      {
+      continue;
+      }
+    vtkIdType blockEnd = std::min(cellId + vtkOsteotomyCellBlocks::BlockSize, end);
+    for (vtkIdType id = cellId; id < blockEnd; id++)
+      {
+      vtkIdType npts;
+      vtkIdType* pts;
+      input->GetCellPoints(id, npts, pts);
+      for (vtkIdType i = 0; i < npts; i++)
+        {
+        mask[pts[i]] = 1;
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Same arithmetic order as vtkOsteotomyCSGKernel, so the folded values are identical
+void ComputePlaneColumn(ClipThreadData* data, const double* p, vtkIdType begin, vtkIdType n,
+                        double* values)
+{
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    double x[3];
+    if (data->FloatPoints)
+      {
+      const float* f = data->FloatPoints + 3*(begin + i);
+      x[0] = f[0];
+      x[1] = f[1];
+      x[2] = f[2];
+      }
+    else if (data->DoublePoints)
+      {
+      const double* d = data->DoublePoints + 3*(begin + i);
+      x[0] = d[0];
+      x[1] = d[1];
+      x[2] = d[2];
+      }
+    else
+      {
+      data->Input->GetPoint(begin + i, x);
+      }
+    double v = p[0]*x[0] + p[1]*x[1];
+    v = v + p[2]*x[2];
+    values[i] = v + p[3];
+    }
+}
+
+//----------------------------------------------------------------------------
+// Incremental evaluation: only the columns of planes that moved are computed,
+// then the program folds the cached columns
+void EvaluateChunkColumns(ClipThreadData* data, vtkIdType chunk)
+{
+  vtkIdType begin = chunk * PointChunkSize;
+  vtkIdType n = std::min(PointChunkSize, data->Input->GetNumberOfPoints() - begin);
+  double* values = data->ClipScalars->GetPointer(begin);
+
+  bool needed = true;
+  if (data->PointMask)
+    {
+    const unsigned char* mask = &(*data->PointMask)[begin];
+    needed = std::find(mask, mask + n, 1) != mask + n;
+    }
+
+  if (needed)
+    {
+    const double* planes = data->Program->GetPlaneCoefficients();
+    std::vector<const double*> columns(data->Columns->size());
+    for (size_t slot = 0; slot < columns.size(); slot++)
+      {
+      std::vector<double>& column = (*data->Columns)[slot]->Chunks[chunk];
+      if (column.empty())
+        {
+        column.resize(n);
+        ComputePlaneColumn(data, planes + 4*slot, begin, n, &column[0]);
+        }
+      columns[slot] = &column[0];
+      }
+    data->Program->Fold(&columns[0], n, values);
+    }
+  else
+    {
+    std::fill(values, values + n, 0.0);
+    }
+
+  double* previous = &(*data->PreviousValues)[begin];
+  unsigned char* changed = &(*data->ChangedPoints)[begin];
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    // The previous values start as NaN, which differs from everything
+    changed[i] = !(values[i] == previous[i]);
+    previous[i] = values[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+// A chunk must be cut again if a block changed class or a point of a cut cell changed value
+bool IsChunkDirty(ClipThreadData* data, vtkIdType chunkId)
+{
+  if (!(*data->Chunks)[chunkId].Points)
+    {
+    return true;
+    }
+  vtkPolyData* input = data->Input;
+  vtkIdType begin = chunkId * CellChunkSize;
+  vtkIdType end = std::min(begin + CellChunkSize, input->GetNumberOfCells());
+  const std::vector<signed char>& previousClasses = *data->PreviousBlockClasses;
+  const std::vector<unsigned char>& changed = *data->ChangedPoints;
+  for (vtkIdType cellId = begin; cellId < end; cellId += vtkOsteotomyCellBlocks::BlockSize)
+    {
+    vtkIdType block = cellId / vtkOsteotomyCellBlocks::BlockSize;
+    signed char blockClass = data->BlockClasses ?
+      data->BlockClasses[block] : vtkOsteotomyCellBlocks::Straddling;
+    if (block >= static_cast<vtkIdType>(previousClasses.size()) ||
+        previousClasses[block] != blockClass)
+      {
+      return true;
+      }
+    if (blockClass != vtkOsteotomyCellBlocks::Straddling)
+      {
+      continue;
+      }
+    vtkIdType blockEnd = std::min(cellId + vtkOsteotomyCellBlocks::BlockSize, end);
+    for (vtkIdType id = cellId; id < blockEnd; id++)
+      {
+      vtkIdType npts;
+      vtkIdType* pts;
+      input->GetCellPoints(id, npts, pts);
+      for (vtkIdType i = 0; i < npts; i++)
+        {
+        if (changed[pts[i]])
+          {
+          return true;
+          }
+        }
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void EvaluateChunk(ClipThreadData* data, vtkIdType chunk)
+{
+  if (data->Columns)
+    {
+    EvaluateChunkColumns(data, chunk);
+    return;
+    }
+
+  vtkIdType begin = chunk * PointChunkSize;
+  vtkIdType n = std::min(PointChunkSize, data->Input->GetNumberOfPoints() - begin);
+  double* values = data->ClipScalars->GetPointer(begin);
+  if (data->PointMask)
+    {
+    // Only the points of cut cells; the others are never read by the clipper
+    const unsigned char* mask = &(*data->PointMask)[begin];
+    std::vector<vtkIdType> ids;
+    std::vector<double> xyz;
+    for (vtkIdType i = 0; i < n; i++)
+      {
+      values[i] = 0.0;
+      if (mask[i])
+        {
+        double x[3];
+        data->Input->GetPoint(begin + i, x);
+        ids.push_back(i);
+        xyz.insert(xyz.end(), x, x + 3);
+        }
+      }
+    if (ids.empty())
+      {
+      return;
+      }
+    std::vector<double> masked(ids.size());
+    data->Program->EvaluateFunction(&xyz[0], static_cast<vtkIdType>(ids.size()), &masked[0]);
+    for (size_t i = 0; i < ids.size(); i++)
+      {
+      values[ids[i]] = masked[i];
+      }
+    }
+  else if (data->FloatPoints)
+    {
+    data->Program->EvaluateFunction(data->FloatPoints + 3*begin, n, values);
+    }
+  else
+    {
+    data->Program->EvaluateFunction(data->DoublePoints + 3*begin, n, values);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Same per-cell work as vtkClipPolyData::RequestData, restricted to the cells of one chunk
+void ClipCellChunk(ClipThreadData* data, vtkIdType chunkId, vtkGenericCell* cell,
+                   vtkDoubleArray* cellScalars)
+{
+  ClipChunk& chunk = (*data->Chunks)[chunkId];
+  vtkPolyData* input = data->Input;
+  vtkPointData* inPD = input->GetPointData();
+  vtkCellData* inCD = input->GetCellData();
+
+  vtkIdType begin = chunkId * CellChunkSize;
+  vtkIdType end = std::min(begin + CellChunkSize, input->GetNumberOfCells());
+  vtkIdType estimatedSize = end - begin;
+
+  chunk.Points = vtkSmartPointer<vtkPoints>::New();
+  chunk.Points->Allocate(estimatedSize, estimatedSize/2);
+  vtkSmartPointer<vtkMergePoints> locator = vtkSmartPointer<vtkMergePoints>::New();
+  locator->InitPointInsertion(chunk.Points, data->Bounds);
+  chunk.PointData = vtkSmartPointer<vtkPointData>::New();
+  chunk.PointData->InterpolateAllocate(inPD, estimatedSize, estimatedSize/2);
+  for (int k = 0; k < 2; k++)
+    {
+    chunk.Polys[k] = vtkSmartPointer<vtkCellArray>::New();
+    chunk.Polys[k]->Allocate(estimatedSize, estimatedSize/2);
+    chunk.CellData[k] = vtkSmartPointer<vtkCellData>::New();
+    chunk.CellData[k]->CopyAllocate(inCD, estimatedSize, estimatedSize/2);
+    }
+
+  for (vtkIdType cellId = begin; cellId < end; cellId++)
+    {
+    if (data->BlockClasses)
+      {
+      signed char blockClass = data->BlockClasses[cellId / vtkOsteotomyCellBlocks::BlockSize];
+      if (blockClass != vtkOsteotomyCellBlocks::Straddling)
+        {
+        // The whole block is on one side: its cells are clipped by a constant
+        // value of the block sign instead of the clipping function, into their
+        // output only. Clip() then keeps what vtkClipPolyData keeps: triangles
+        // and quads unchanged unless their merged points repeat, larger
+        // polygons triangulated.
+        int out = ((blockClass == vtkOsteotomyCellBlocks::Positive) != (data->InsideOut != 0)) ? 0 : 1;
+        int insideOut = out ? !data->InsideOut : data->InsideOut;
+        double side = (blockClass == vtkOsteotomyCellBlocks::Positive) ? 1.0 : -1.0;
+        vtkIdType blockEnd = std::min(
+          (cellId / vtkOsteotomyCellBlocks::BlockSize + 1) * vtkOsteotomyCellBlocks::BlockSize, end);
+        for (; cellId < blockEnd; cellId++)
+          {
+          input->GetCell(cellId, cell);
+          vtkIdType npts = cell->GetNumberOfPoints();
+          cellScalars->SetNumberOfTuples(npts);
+          for (vtkIdType i = 0; i < npts; i++)
+            {
+            cellScalars->SetValue(i, side);
+            }
+          cell->Clip(0.0, cellScalars, locator, chunk.Polys[out], inPD, chunk.PointData,
+                     inCD, cellId, chunk.CellData[out], insideOut);
+          }
+        cellId--;
+        continue;
+        }
+      }
+
+    input->GetCell(cellId, cell);
+    vtkIdList* cellPts = cell->GetPointIds();
+    vtkIdType npts = cellPts->GetNumberOfIds();
+    cellScalars->SetNumberOfTuples(npts);
+    for (vtkIdType i = 0; i < npts; i++)
+      {
+      cellScalars->SetValue(i, data->ClipScalars->GetValue(cellPts->GetId(i)));
+      }
+    cell->Clip(0.0, cellScalars, locator, chunk.Polys[0], inPD, chunk.PointData,
+               inCD, cellId, chunk.CellData[0], data->InsideOut);
+    cell->Clip(0.0, cellScalars, locator, chunk.Polys[1], inPD, chunk.PointData,
+               inCD, cellId, chunk.CellData[1], !data->InsideOut);
+    }
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE ClipThreadedExecute(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ClipThreadData* data = static_cast<ClipThreadData*>(info->UserData);
+
+  vtkSmartPointer<vtkGenericCell> cell = vtkSmartPointer<vtkGenericCell>::New();
+  vtkSmartPointer<vtkDoubleArray> cellScalars = vtkSmartPointer<vtkDoubleArray>::New();
+  cellScalars->Allocate(VTK_CELL_SIZE);
+
+  vtkIdType chunk;
+  while (TakeChunk(data, chunk))
+    {
+    if (data->Stage == ClipThreadData::EvaluateStage)
+      {
+      EvaluateChunk(data, chunk);
+      }
+    else if (!data->Columns || IsChunkDirty(data, chunk))
+      {
+      ClipCellChunk(data, chunk, cell, cellScalars);
+      }
+    // The chunk taken tells how far the stage is without reading NextChunk,
+    // which the other threads change
+    if (info->ThreadID == 0)
+      {
+      data->Filter->UpdateProgress(data->ProgressBegin + (data->ProgressEnd - data->ProgressBegin) *
+                                   (chunk + 1) / data->NumberOfChunks);
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+void RunThreads(ClipThreadData* data, int stage, vtkIdType numberOfChunks, int numberOfThreads,
+                double progressBegin, double progressEnd)
+{
+  data->Stage = stage;
+  data->ProgressBegin = progressBegin;
+  data->ProgressEnd = progressEnd;
+  data->NumberOfChunks = numberOfChunks;
+  data->NextChunk = 0;
+
+  vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+  threader->SetNumberOfThreads(
+    static_cast<int>(std::min<vtkIdType>(numberOfThreads, numberOfChunks)));
+  threader->SetSingleMethod(ClipThreadedExecute, data);
+  threader->SingleMethodExecute();
+}
+
+//----------------------------------------------------------------------------
+void RemoveClipFunctionArray(vtkPolyData* polyData, const std::string& activeScalars)
+{
+  vtkPointData* pointData = polyData->GetPointData();
+  pointData->RemoveArray(ClipFunctionArrayName);
+  if (!activeScalars.empty())
+    {
+    pointData->SetActiveScalars(activeScalars.c_str());
+    }
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkOsteotomyClipPolyData::vtkInternal
+{
+public:
+  vtkInternal()
+    {
+    this->Reset(NULL);
+    }
+
+  void Reset(vtkPolyData* input)
+    {
+    this->Input = input;
+    this->InputMTime = input ? input->GetMTime() : 0;
+    this->InsideOut = -1;
+    this->Columns.clear();
+    this->Values.assign(input ? input->GetNumberOfPoints() : 0,
+                        std::numeric_limits<double>::quiet_NaN());
+    this->Changed.assign(this->Values.size(), 1);
+    this->BlockClasses.clear();
+    this->Chunks.clear();
+    }
+
+  vtkPolyData* Input; // not referenced, only compared
+  unsigned long InputMTime;
+  int InsideOut;
+
+  // Key: index of the plane in the chain, -1 for the depth plane
+  std::map<int, PlaneColumn> Columns;
+  std::vector<double> Values;
+  std::vector<unsigned char> Changed;
+  std::vector<signed char> BlockClasses;
+  std::vector<ClipChunk> Chunks;
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkOsteotomyClipPolyData);
+vtkCxxSetObjectMacro(vtkOsteotomyClipPolyData, PlaneChain, vtkOsteotomyPlaneChain);
+vtkCxxSetObjectMacro(vtkOsteotomyClipPolyData, Profiler, vtkOsteotomyClipProfiler);
+
+//----------------------------------------------------------------------------
+vtkOsteotomyClipPolyData::vtkOsteotomyClipPolyData()
+{
+  this->PlaneChain = NULL;
+  this->Program = vtkOsteotomyCSGProgram::New();
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->ClipMode = ClipModeScalars;
+  this->BlockCulling = 1;
+  this->CellBlocks = vtkOsteotomyCellBlocks::New();
+  this->Incremental = 0;
+  this->Profiler = NULL;
+  this->Internal = new vtkInternal;
+  this->SetNumberOfOutputPorts(2);
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyClipPolyData::~vtkOsteotomyClipPolyData()
+{
+  this->SetPlaneChain(NULL);
+  this->SetProfiler(NULL);
+  this->Program->Delete();
+  this->CellBlocks->Delete();
+  delete this->Internal;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipPolyData::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Plane Chain: " << this->PlaneChain << "\n";
+  os << indent << "Number Of Threads: " << this->NumberOfThreads << "\n";
+  os << indent << "Clip Mode: "
+     << (this->ClipMode == ClipModeExact ? "Exact" : "Scalars") << "\n";
+  os << indent << "Block Culling: " << this->BlockCulling << "\n";
+  os << indent << "Incremental: " << this->Incremental << "\n";
+  os << indent << "Profiler: " << this->Profiler << "\n";
+  os << indent << "Program:\n";
+  this->Program->PrintSelf(os, indent.GetNextIndent());
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipPolyData::SetProgram(vtkOsteotomyCSGProgram* program)
+{
+  if (!program || program == this->Program)
+    {
+    return;
+    }
+  this->Program->Delete();
+  this->Program = program;
+  this->Program->Register(this);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkOsteotomyClipPolyData::GetReservedOutput()
+{
+  return this->GetOutput(0);
+}
+
+//----------------------------------------------------------------------------
+vtkPolyData* vtkOsteotomyClipPolyData::GetClippedOutput()
+{
+  return this->GetOutput(1);
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkOsteotomyClipPolyData::GetMTime()
+{
+  unsigned long mTime = this->Superclass::GetMTime();
+  if (this->PlaneChain)
+    {
+    unsigned long chainMTime = this->PlaneChain->GetMTime();
+    mTime = (chainMTime > mTime) ? chainMTime : mTime;
+    }
+  return mTime;
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipPolyData::RequestData(
+  vtkInformation* vtkNotUsed(request),
+  vtkInformationVector** inputVector,
+  vtkInformationVector* outputVector)
+{
+  vtkInformation* inInfo = inputVector[0]->GetInformationObject(0);
+  vtkInformation* reservedInfo = outputVector->GetInformationObject(0);
+  vtkInformation* clippedInfo = outputVector->GetInformationObject(1);
+
+  vtkPolyData* input = vtkPolyData::SafeDownCast(inInfo->Get(vtkDataObject::DATA_OBJECT()));
+  vtkPolyData* reserved = vtkPolyData::SafeDownCast(reservedInfo->Get(vtkDataObject::DATA_OBJECT()));
+  vtkPolyData* clipped = vtkPolyData::SafeDownCast(clippedInfo->Get(vtkDataObject::DATA_OBJECT()));
+
+  if (!this->PlaneChain || this->PlaneChain->GetNumberOfPlanes() == 0)
+    {
+    vtkErrorMacro(<< "A plane chain with at least one plane is required");
+    return 0;
+    }
+  if (!input || input->GetNumberOfPoints() == 0)
+    {
+    vtkDebugMacro(<< "Empty input");
+    return 1;
+    }
+
+  // Evaluate the compiled clipping body once per point and clip by the scalars,
+  // instead of letting vtkClipPolyData walk the vtkImplicitBoolean tree
+  if (!this->Program->IsCompiledFrom(this->PlaneChain))
+    {
+    vtkOsteotomyClipProfiler::ScopedTimer timer(this->Profiler, vtkOsteotomyClipProfiler::TreeBuild);
+    this->Program->Compile(this->PlaneChain);
+    }
+
+  bool polygonsOnly = input->GetNumberOfVerts() == 0 && input->GetNumberOfLines() == 0 &&
+    input->GetNumberOfStrips() == 0;
+
+  // Decide the blocks of cells far from every plane without looking at their points
+  const signed char* blockClasses = NULL;
+  if (this->BlockCulling && polygonsOnly)
+    {
+    vtkOsteotomyClipProfiler::ScopedTimer timer(this->Profiler, vtkOsteotomyClipProfiler::Evaluate);
+    this->CellBlocks->Build(input);
+    this->CellBlocks->Classify(this->Program);
+    blockClasses = this->CellBlocks->GetBlockClasses();
+    vtkDebugMacro(<< this->CellBlocks->GetNumberOfStraddlingBlocks() << " of "
+                  << this->CellBlocks->GetNumberOfBlocks() << " cell blocks to cut");
+    }
+
+  if (this->ClipMode == ClipModeExact)
+    {
+    if (polygonsOnly)
+      {
+      vtkOsteotomyClipProfiler::ScopedTimer timer(this->Profiler, vtkOsteotomyClipProfiler::Clip);
+      vtkSmartPointer<vtkOsteotomyPlanarClipper> planarClipper =
+        vtkSmartPointer<vtkOsteotomyPlanarClipper>::New();
+      planarClipper->Clip(input, this->Program, this->PlaneChain->GetReverseClipping(),
+                          reserved, clipped, blockClasses);
+      return 1;
+      }
+    vtkWarningMacro(<< "Exact clipping needs polygons only, clipping by scalars instead");
+    }
+
+  vtkSmartPointer<vtkDoubleArray> clipFunction = vtkSmartPointer<vtkDoubleArray>::New();
+  clipFunction->SetName(ClipFunctionArrayName);
+
+  std::string activeScalars;
+  if (input->GetPointData()->GetScalars() && input->GetPointData()->GetScalars()->GetName())
+    {
+    activeScalars = input->GetPointData()->GetScalars()->GetName();
+    }
+
+  vtkSmartPointer<vtkPolyData> inputCopy = vtkSmartPointer<vtkPolyData>::New();
+  inputCopy->ShallowCopy(input);
+
+  // The chunked clipper handles polygons only; other cells are rare in models.
+  // It also runs on one thread when blocks can be culled or chunks reused.
+  bool chunked = polygonsOnly && (blockClasses || this->Incremental ||
+    (this->NumberOfThreads > 1 && input->GetNumberOfCells() > CellChunkSize));
+
+  if (chunked)
+    {
+    this->PrepareIncrementalClip(input);
+    vtkOsteotomyClipProfiler::ScopedTimer timer(this->Profiler, vtkOsteotomyClipProfiler::Evaluate);
+    this->EvaluateParallel(inputCopy, clipFunction, blockClasses);
+    timer.Stop();
+    if (!this->GetAbortExecute())
+      {
+      inputCopy->GetPointData()->SetScalars(clipFunction);
+      this->ClipParallel(inputCopy, clipFunction, reserved, clipped, blockClasses);
+      }
+    if (this->GetAbortExecute())
+      {
+      // Some chunks were skipped, so nothing of this update can be reused
+      this->Internal->Reset(NULL);
+      reserved->Initialize();
+      clipped->Initialize();
+      return 1;
+      }
+    }
+  else
+    {
+    vtkOsteotomyClipProfiler::ScopedTimer evaluateTimer(this->Profiler, vtkOsteotomyClipProfiler::Evaluate);
+    this->Program->EvaluateFunction(input->GetPoints()->GetData(), clipFunction);
+    inputCopy->GetPointData()->SetScalars(clipFunction);
+    evaluateTimer.Stop();
+
+    vtkOsteotomyClipProfiler::ScopedTimer clipTimer(this->Profiler, vtkOsteotomyClipProfiler::Clip);
+    vtkSmartPointer<vtkClipPolyData> clipper = vtkSmartPointer<vtkClipPolyData>::New();
+    clipper->SetInput(inputCopy);
+    clipper->GenerateClippedOutputOn();
+    clipper->SetValue(0.0);
+    clipper->SetInsideOut(this->PlaneChain->GetReverseClipping());
+    clipper->Update();
+    clipTimer.Stop();
+
+    vtkOsteotomyClipProfiler::ScopedTimer copyTimer(this->Profiler, vtkOsteotomyClipProfiler::Copy);
+    reserved->ShallowCopy(clipper->GetOutput());
+    clipped->ShallowCopy(clipper->GetClippedOutput());
+    }
+
+  RemoveClipFunctionArray(reserved, activeScalars);
+  RemoveClipFunctionArray(clipped, activeScalars);
+
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipPolyData::EvaluateParallel(vtkPolyData* input, vtkDoubleArray* clipFunction,
+                                                const signed char* blockClasses)
+{
+  vtkDataArray* points = input->GetPoints()->GetData();
+  vtkFloatArray* floats = vtkFloatArray::SafeDownCast(points);
+  vtkDoubleArray* doubles = vtkDoubleArray::SafeDownCast(points);
+  if (!floats && !doubles && !blockClasses && !this->Incremental)
+    {
+    this->Program->EvaluateFunction(points, clipFunction);
+    return;
+    }
+
+  vtkIdType numPts = input->GetNumberOfPoints();
+  clipFunction->SetNumberOfComponents(1);
+  clipFunction->SetNumberOfTuples(numPts);
+
+  vtkSmartPointer<vtkMutexLock> lock = vtkSmartPointer<vtkMutexLock>::New();
+  ClipThreadData data;
+  data.Program = this->Program;
+  data.FloatPoints = floats ? floats->GetPointer(0) : NULL;
+  data.DoublePoints = doubles ? doubles->GetPointer(0) : NULL;
+  data.Input = input;
+  data.ClipScalars = clipFunction;
+  data.Chunks = NULL;
+  data.Lock = lock;
+  data.BlockClasses = blockClasses;
+  data.PointMask = NULL;
+  data.Columns = NULL;
+  data.Filter = this;
+
+  std::vector<PlaneColumn*> columns;
+  if (this->Incremental)
+    {
+    // Invalidate the columns of the planes that moved and drop the unused ones
+    std::map<int, PlaneColumn> used;
+    vtkIdType numChunks = (numPts + PointChunkSize - 1) / PointChunkSize;
+    for (int slot = 0; slot < this->Program->GetNumberOfPlanes(); slot++)
+      {
+      int planeId = this->Program->GetPlaneId(slot);
+      unsigned long mTime = (planeId == vtkOsteotomyCSGProgram::DepthPlaneId) ?
+        this->PlaneChain->GetDepthPlaneMTime() : this->PlaneChain->GetPlaneMTime(planeId);
+      std::map<int, PlaneColumn>::iterator it = this->Internal->Columns.find(planeId);
+      PlaneColumn& column = used[planeId];
+      if (it != this->Internal->Columns.end() && it->second.MTime == mTime)
+        {
+        column.Chunks.swap(it->second.Chunks);
+        }
+      column.MTime = mTime;
+      column.Chunks.resize(numChunks);
+      }
+    this->Internal->Columns.swap(used);
+    for (int slot = 0; slot < this->Program->GetNumberOfPlanes(); slot++)
+      {
+      columns.push_back(&this->Internal->Columns[this->Program->GetPlaneId(slot)]);
+      }
+    data.Columns = &columns;
+    data.PreviousValues = &this->Internal->Values;
+    data.ChangedPoints = &this->Internal->Changed;
+    }
+
+  std::vector<unsigned char> pointMask;
+  if (blockClasses)
+    {
+    input->BuildCells();
+    pointMask.assign(numPts, 0);
+    data.PointMask = &pointMask;
+    // A cheap pass over the point ids of the cut cells
+    vtkIdType numCells = input->GetNumberOfCells();
+    vtkIdType numCellChunks = (numCells + CellChunkSize - 1) / CellChunkSize;
+    for (vtkIdType chunk = 0; chunk < numCellChunks && !this->GetAbortExecute(); chunk++)
+      {
+      MarkChunk(&data, chunk);
+      }
+    this->UpdateProgress(0.05);
+    }
+
+  RunThreads(&data, ClipThreadData::EvaluateStage,
+             (numPts + PointChunkSize - 1) / PointChunkSize, this->NumberOfThreads, 0.05, 0.3);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipPolyData::ClipParallel(vtkPolyData* input, vtkDoubleArray* clipFunction,
+                                            vtkPolyData* reserved, vtkPolyData* clipped,
+                                            const signed char* blockClasses)
+{
+  vtkIdType numPts = input->GetNumberOfPoints();
+  vtkIdType numCells = input->GetNumberOfCells();
+
+  // Cells are read concurrently, so the cell links must exist before the threads start
+  input->BuildCells();
+
+  // Chunks of the last clip are kept and reused when incremental
+  std::vector<ClipChunk> localChunks;
+  std::vector<ClipChunk>& chunks = this->Incremental ? this->Internal->Chunks : localChunks;
+  chunks.resize((numCells + CellChunkSize - 1) / CellChunkSize);
+  vtkSmartPointer<vtkMutexLock> lock = vtkSmartPointer<vtkMutexLock>::New();
+  ClipThreadData data;
+  data.Program = this->Program;
+  data.FloatPoints = NULL;
+  data.DoublePoints = NULL;
+  data.Input = input;
+  input->GetBounds(data.Bounds);
+  data.ClipScalars = clipFunction;
+  data.InsideOut = this->PlaneChain->GetReverseClipping();
+  data.Chunks = &chunks;
+  data.Lock = lock;
+  data.BlockClasses = blockClasses;
+  data.PointMask = NULL;
+  data.Columns = NULL;
+  data.Filter = this;
+  std::vector<PlaneColumn*> noColumns;
+  if (this->Incremental)
+    {
+    data.Columns = &noColumns; // only tested for NULL in this stage
+    data.PreviousBlockClasses = &this->Internal->BlockClasses;
+    data.ChangedPoints = &this->Internal->Changed;
+    }
+  vtkOsteotomyClipProfiler::ScopedTimer clipTimer(this->Profiler, vtkOsteotomyClipProfiler::Clip);
+  RunThreads(&data, ClipThreadData::ClipStage,
+             static_cast<vtkIdType>(chunks.size()), this->NumberOfThreads, 0.3, 0.9);
+  clipTimer.Stop();
+  if (this->GetAbortExecute())
+    {
+    return;
+    }
+
+  if (this->Incremental)
+    {
+    vtkIdType numBlocks = (numCells + vtkOsteotomyCellBlocks::BlockSize - 1) /
+      vtkOsteotomyCellBlocks::BlockSize;
+    if (blockClasses)
+      {
+      this->Internal->BlockClasses.assign(blockClasses, blockClasses + numBlocks);
+      }
+    else
+      {
+      this->Internal->BlockClasses.assign(numBlocks, vtkOsteotomyCellBlocks::Straddling);
+      }
+    }
+
+  vtkOsteotomyClipProfiler::ScopedTimer copyTimer(this->Profiler, vtkOsteotomyClipProfiler::Copy);
+
+  // Merge the chunks in order. Points are merged by coordinates exactly as the
+  // single locator of vtkClipPolyData does, so the point and cell order is the
+  // one of the serial clip whatever the number of threads.
+  vtkSmartPointer<vtkPoints> newPoints = vtkSmartPointer<vtkPoints>::New();
+  newPoints->Allocate(numPts, numPts/2);
+  vtkSmartPointer<vtkMergePoints> locator = vtkSmartPointer<vtkMergePoints>::New();
+  locator->InitPointInsertion(newPoints, data.Bounds);
+
+  vtkPointData* outPD = reserved->GetPointData();
+  outPD->InterpolateAllocate(input->GetPointData(), numPts, numPts/2);
+
+  vtkSmartPointer<vtkCellArray> newPolys[2];
+  vtkCellData* outCD[2] = { reserved->GetCellData(), clipped->GetCellData() };
+  vtkIdType numNewCells[2] = { 0, 0 };
+  for (int k = 0; k < 2; k++)
+    {
+    newPolys[k] = vtkSmartPointer<vtkCellArray>::New();
+    newPolys[k]->Allocate(numCells, numCells/2);
+    outCD[k]->CopyAllocate(input->GetCellData(), numCells, numCells/2);
+    }
+
+  std::vector<vtkIdType> pointMap;
+  std::vector<vtkIdType> cellPts;
+  for (size_t c = 0; c < chunks.size(); c++)
+    {
+    if (c % 16 == 0)
+      {
+      this->UpdateProgress(0.9 + 0.1 * c / chunks.size());
+      if (this->GetAbortExecute())
+        {
+        return;
+        }
+      }
+    ClipChunk& chunk = chunks[c];
+    vtkIdType numChunkPts = chunk.Points->GetNumberOfPoints();
+    pointMap.resize(numChunkPts);
+    for (vtkIdType j = 0; j < numChunkPts; j++)
+      {
+      double x[3];
+      chunk.Points->GetPoint(j, x);
+      if (locator->InsertUniquePoint(x, pointMap[j]))
+        {
+        outPD->CopyData(chunk.PointData, j, pointMap[j]);
+        }
+      }
+
+    for (int k = 0; k < 2; k++)
+      {
+      vtkIdType npts;
+      vtkIdType* pts;
+      vtkIdType localId = 0;
+      vtkCellArray* polys = chunk.Polys[k];
+      for (polys->InitTraversal(); polys->GetNextCell(npts, pts); localId++)
+        {
+        cellPts.resize(npts);
+        for (vtkIdType i = 0; i < npts; i++)
+          {
+          cellPts[i] = pointMap[pts[i]];
+          }
+        newPolys[k]->InsertNextCell(npts, &cellPts[0]);
+        outCD[k]->CopyData(chunk.CellData[k], localId, numNewCells[k]++);
+        }
+      }
+
+    // Release the chunk as soon as it is merged, unless it can be reused
+    if (!this->Incremental)
+      {
+      chunk = ClipChunk();
+      }
+    }
+
+  reserved->SetPoints(newPoints);
+  reserved->SetPolys(newPolys[0]);
+  reserved->Squeeze();
+
+  clipped->SetPoints(newPoints);
+  clipped->GetPointData()->ShallowCopy(outPD);
+  clipped->SetPolys(newPolys[1]);
+  clipped->Squeeze();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipPolyData::PrepareIncrementalClip(vtkPolyData* input)
+{
+  if (!this->Incremental)
+    {
+    this->Internal->Reset(NULL);
+    return;
+    }
+  int insideOut = this->PlaneChain->GetReverseClipping();
+  if (input != this->Internal->Input || input->GetMTime() != this->Internal->InputMTime ||
+      insideOut != this->Internal->InsideOut)
+    {
+    this->Internal->Reset(input);
+    this->Internal->InsideOut = insideOut;
+    }
+}
@@ -0,0 +1,165 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyClipPolyData - clip polygonal data with an osteotomy plane chain
+// .SECTION Description
+// vtkOsteotomyClipPolyData cuts its input with the clipping body described by
+// a vtkOsteotomyPlaneChain. The first output holds the reserved part of the
+// model and the second output the clipped part. The filter needs no render
+// window or widget, so it can run from scripts, worker threads and tests.
+// The clipping body is compiled into a vtkOsteotomyCSGProgram and evaluated
+// once per point; the points are then clipped by the resulting scalars.
+// Large polygonal inputs are evaluated and clipped by several threads. The
+// cells are split into chunks of fixed size and the chunks are merged in
+// order, so the output is the one of vtkClipPolyData whatever the number
+// of threads.
+// With BlockCulling on, blocks of cells that lie entirely on one side of the
+// clipping body (see vtkOsteotomyCellBlocks) are copied to their output
+// without evaluating or cutting them, so the work grows with the cut area
+// rather than with the model size. Their cells still go through Clip() with
+// a constant value, so degenerate cells are dropped and larger polygons are
+// triangulated as by vtkClipPolyData, and the output is the same.
+// With Incremental on, the values of each plane at every point are kept
+// between updates, keyed by the plane index and its modification time. When
+// a single plane moves only its values are recomputed before the program is
+// folded again, and only the chunks of cells with a changed point or block
+// class are cut again; the other chunks reuse their previous cells.
+// With ClipModeToExact, polygonal inputs are instead cut exactly along the
+// planes by vtkOsteotomyPlanarClipper.
+// The chunked clip reports its progress, and it stops between chunks when
+// AbortExecute is set, for instance from a ProgressEvent observer; both
+// outputs are then left empty.
+// When a vtkOsteotomyClipProfiler is set, the stages of every update are
+// timed into it.
+
+#ifndef __vtkOsteotomyClipPolyData_h
+#define __vtkOsteotomyClipPolyData_h
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkPolyDataAlgorithm.h>
+
+#include "vtkSlicerSmartModelClipModuleLogicExport.h"
+
+class vtkDoubleArray;
+class vtkOsteotomyCellBlocks;
+class vtkOsteotomyClipProfiler;
+class vtkOsteotomyCSGProgram;
+class vtkOsteotomyPlaneChain;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkOsteotomyClipPolyData :
+  public vtkPolyDataAlgorithm
+{
+public:
+  static vtkOsteotomyClipPolyData *New();
+  vtkTypeMacro(vtkOsteotomyClipPolyData, vtkPolyDataAlgorithm);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// The plane chain describing the clipping body.
+  virtual void SetPlaneChain(vtkOsteotomyPlaneChain*);
+  vtkGetObjectMacro(PlaneChain, vtkOsteotomyPlaneChain);
+
+  /// The program compiled from the plane chain by the last update.
+  /// Filters clipping several models with the same chain may share a program
+  /// compiled once by the caller; it is only compiled again by an update if
+  /// the chain changed since. Cannot be set to NULL.
+  virtual void SetProgram(vtkOsteotomyCSGProgram*);
+  vtkGetObjectMacro(Program, vtkOsteotomyCSGProgram);
+
+  /// The reserved part of the model (first output).
+  vtkPolyData* GetReservedOutput();
+
+  /// The clipped part of the model (second output).
+  vtkPolyData* GetClippedOutput();
+
+  /// Number of threads used for large polygonal inputs. With 1, the serial
+  /// vtkClipPolyData runs unless BlockCulling or Incremental need the chunked
+  /// clip, which then runs on one thread; the output is the same either way.
+  /// The default is the global default of vtkMultiThreader.
+  vtkSetClampMacro(NumberOfThreads, int, 1, VTK_MAX_THREADS);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /// How the cut is computed. Scalars (default) clips by the interpolated
+  /// clipping function like vtkClipPolyData; Exact splits the triangles
+  /// along the planes. Exact applies to polygonal inputs only.
+  enum
+  {
+    ClipModeScalars = 0,
+    ClipModeExact
+  };
+  vtkSetClampMacro(ClipMode, int, ClipModeScalars, ClipModeExact);
+  vtkGetMacro(ClipMode, int);
+  void SetClipModeToScalars() { this->SetClipMode(ClipModeScalars); }
+  void SetClipModeToExact() { this->SetClipMode(ClipModeExact); }
+
+  /// Copy the blocks of cells far from the planes instead of clipping them. On by default.
+  vtkSetMacro(BlockCulling, int);
+  vtkGetMacro(BlockCulling, int);
+  vtkBooleanMacro(BlockCulling, int);
+
+  /// Keep per-plane values and clipped chunks to speed up the next update.
+  /// Off by default. The cache holds about one double per point and plane
+  /// and the cells of every chunk, which doubles the peak memory of a clip,
+  /// so it only pays for small models re-clipped as a plane moves.
+  vtkSetMacro(Incremental, int);
+  vtkGetMacro(Incremental, int);
+  vtkBooleanMacro(Incremental, int);
+
+  /// Block boxes of the last input, kept between updates.
+  vtkGetObjectMacro(CellBlocks, vtkOsteotomyCellBlocks);
+
+  /// Profiler receiving the durations of the stages of each update. NULL by default.
+  virtual void SetProfiler(vtkOsteotomyClipProfiler*);
+  vtkGetObjectMacro(Profiler, vtkOsteotomyClipProfiler);
+
+  /// The modification time also depends on the plane chain.
+  unsigned long GetMTime();
+
+protected:
+  vtkOsteotomyClipPolyData();
+  virtual ~vtkOsteotomyClipPolyData();
+
+  virtual int RequestData(vtkInformation*, vtkInformationVector**, vtkInformationVector*);
+
+  void PrepareIncrementalClip(vtkPolyData* input);
+  void EvaluateParallel(vtkPolyData* input, vtkDoubleArray* clipFunction,
+                        const signed char* blockClasses);
+  void ClipParallel(vtkPolyData* input, vtkDoubleArray* clipFunction,
+                    vtkPolyData* reserved, vtkPolyData* clipped,
+                    const signed char* blockClasses);
+
+  vtkOsteotomyPlaneChain* PlaneChain;
+  vtkOsteotomyCSGProgram* Program;
+  int NumberOfThreads;
+  int ClipMode;
+  int BlockCulling;
+  vtkOsteotomyCellBlocks* CellBlocks;
+  int Incremental;
+  vtkOsteotomyClipProfiler* Profiler;
+
+//BTX
+  class vtkInternal;
+  vtkInternal* Internal;
+//ETX
+
+private:
+  vtkOsteotomyClipPolyData(const vtkOsteotomyClipPolyData&); // Not implemented
+  void operator=(const vtkOsteotomyClipPolyData&);            // Not implemented
+};
+
+#endif
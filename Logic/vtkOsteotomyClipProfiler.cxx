@@ -0,0 +1,439 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipProfiler.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+#ifdef _WIN32
+# include <vtkWindows.h>
+#else
+# include <time.h>
+#endif
+
+// STD includes
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+class vtkOsteotomyClipProfiler::vtkInternal
+{
+public:
+  // Trace events name threads by their order of appearance
+  std::vector<vtkMultiThreaderIDType> ThreadIds;
+};
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkOsteotomyClipProfiler);
+
+//----------------------------------------------------------------------------
+vtkOsteotomyClipProfiler::vtkOsteotomyClipProfiler()
+{
+  this->Enabled = 1;
+  this->HistorySize = 256;
+  this->MaximumNumberOfTraceEvents = 10000;
+  this->Lock = vtkSimpleMutexLock::New();
+  this->Internal = new vtkInternal;
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyClipProfiler::~vtkOsteotomyClipProfiler()
+{
+  delete this->Internal;
+  this->Lock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Enabled: " << this->Enabled << "\n";
+  os << indent << "History Size: " << this->HistorySize << "\n";
+  os << indent << "Maximum Number Of Trace Events: " << this->MaximumNumberOfTraceEvents << "\n";
+  for (int stage = 0; stage < NumberOfStages; stage++)
+    {
+    os << indent << GetStageName(stage) << ": " << this->GetNumberOfSamples(stage)
+       << " samples, mean " << 1000.0 * this->GetMeanDuration(stage) << " ms\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+const char* vtkOsteotomyClipProfiler::GetStageName(int stage)
+{
+  switch (stage)
+    {
+    case TreeBuild: return "TreeBuild";
+    case Evaluate: return "Evaluate";
+    case Clip: return "Clip";
+    case Copy: return "Copy";
+    case NodeCreation: return "NodeCreation";
+    case Display: return "Display";
+    default: return "Unknown";
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::SetHistorySize(int size)
+{
+  size = std::max(1, size);
+  if (size == this->HistorySize)
+    {
+    return;
+    }
+  this->Lock->Lock();
+  this->HistorySize = size;
+  for (int stage = 0; stage < NumberOfStages; stage++)
+    {
+    this->Durations[stage].clear();
+    this->NextDuration[stage] = 0;
+    }
+  this->Lock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::SetMaximumNumberOfTraceEvents(int number)
+{
+  number = std::max(1, number);
+  if (number == this->MaximumNumberOfTraceEvents)
+    {
+    return;
+    }
+  this->Lock->Lock();
+  this->MaximumNumberOfTraceEvents = number;
+  this->TraceEvents.clear();
+  this->NextTraceEvent = 0;
+  this->Lock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double vtkOsteotomyClipProfiler::GetTime()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return static_cast<double>(counter.QuadPart) / static_cast<double>(frequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + 1.0e-9 * now.tv_nsec;
+#else
+  return vtkTimerLog::GetUniversalTime();
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::AddSample(int stage, double begin, double end)
+{
+  if (stage < 0 || stage >= NumberOfStages)
+    {
+    return;
+    }
+
+  this->Lock->Lock();
+  std::vector<double>& durations = this->Durations[stage];
+  if (static_cast<int>(durations.size()) < this->HistorySize)
+    {
+    durations.push_back(end - begin);
+    }
+  else
+    {
+    durations[this->NextDuration[stage]] = end - begin;
+    }
+  this->NextDuration[stage] = (this->NextDuration[stage] + 1) % this->HistorySize;
+
+  TraceEvent event;
+  event.Stage = stage;
+  event.Thread = this->ThreadIndex();
+  event.Begin = begin - this->StartTime;
+  event.Duration = end - begin;
+  if (static_cast<int>(this->TraceEvents.size()) < this->MaximumNumberOfTraceEvents)
+    {
+    this->TraceEvents.push_back(event);
+    }
+  else
+    {
+    this->TraceEvents[this->NextTraceEvent] = event;
+    }
+  this->NextTraceEvent = (this->NextTraceEvent + 1) % this->MaximumNumberOfTraceEvents;
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipProfiler::ThreadIndex()
+{
+  vtkMultiThreaderIDType id = vtkMultiThreader::GetCurrentThreadID();
+  std::vector<vtkMultiThreaderIDType>& ids = this->Internal->ThreadIds;
+  for (size_t i = 0; i < ids.size(); i++)
+    {
+    if (vtkMultiThreader::ThreadsEqual(ids[i], id))
+      {
+      return static_cast<int>(i);
+      }
+    }
+  ids.push_back(id);
+  return static_cast<int>(ids.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::Reset()
+{
+  this->Lock->Lock();
+  for (int stage = 0; stage < NumberOfStages; stage++)
+    {
+    this->Durations[stage].clear();
+    this->NextDuration[stage] = 0;
+    }
+  this->TraceEvents.clear();
+  this->NextTraceEvent = 0;
+  this->Internal->ThreadIds.clear();
+  this->StartTime = GetTime();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipProfiler::GetNumberOfSamples(int stage)
+{
+  if (stage < 0 || stage >= NumberOfStages)
+    {
+    return 0;
+    }
+  this->Lock->Lock();
+  int number = static_cast<int>(this->Durations[stage].size());
+  this->Lock->Unlock();
+  return number;
+}
+
+//----------------------------------------------------------------------------
+double vtkOsteotomyClipProfiler::GetLastDuration(int stage)
+{
+  if (stage < 0 || stage >= NumberOfStages)
+    {
+    return 0.0;
+    }
+  this->Lock->Lock();
+  const std::vector<double>& durations = this->Durations[stage];
+  double last = durations.empty() ? 0.0 :
+    durations[(this->NextDuration[stage] + this->HistorySize - 1) % this->HistorySize];
+  this->Lock->Unlock();
+  return last;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::SortedDurations(int stage, std::vector<double>& durations)
+{
+  durations.clear();
+  if (stage < 0 || stage >= NumberOfStages)
+    {
+    return;
+    }
+  this->Lock->Lock();
+  durations = this->Durations[stage];
+  this->Lock->Unlock();
+  std::sort(durations.begin(), durations.end());
+}
+
+//----------------------------------------------------------------------------
+double vtkOsteotomyClipProfiler::GetMeanDuration(int stage)
+{
+  std::vector<double> durations;
+  this->SortedDurations(stage, durations);
+  if (durations.empty())
+    {
+    return 0.0;
+    }
+  double sum = 0.0;
+  for (size_t i = 0; i < durations.size(); i++)
+    {
+    sum += durations[i];
+    }
+  return sum / durations.size();
+}
+
+//----------------------------------------------------------------------------
+double vtkOsteotomyClipProfiler::GetMinimumDuration(int stage)
+{
+  return this->GetPercentileDuration(stage, 0.0);
+}
+
+//----------------------------------------------------------------------------
+double vtkOsteotomyClipProfiler::GetMaximumDuration(int stage)
+{
+  return this->GetPercentileDuration(stage, 1.0);
+}
+
+//----------------------------------------------------------------------------
+double vtkOsteotomyClipProfiler::GetPercentileDuration(int stage, double fraction)
+{
+  std::vector<double> durations;
+  this->SortedDurations(stage, durations);
+  if (durations.empty())
+    {
+    return 0.0;
+    }
+  fraction = std::min(1.0, std::max(0.0, fraction));
+  size_t index = static_cast<size_t>(fraction * (durations.size() - 1) + 0.5);
+  return durations[index];
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::GetHistogram(int stage, int counts[NumberOfHistogramBins])
+{
+  std::fill(counts, counts + NumberOfHistogramBins, 0);
+  std::vector<double> durations;
+  this->SortedDurations(stage, durations);
+  for (size_t i = 0; i < durations.size(); i++)
+    {
+    double microseconds = 1.0e6 * durations[i];
+    int bin = 0;
+    if (microseconds >= 1.0)
+      {
+      int exponent;
+      frexp(microseconds, &exponent); // microseconds < 2^exponent
+      bin = std::min(static_cast<int>(NumberOfHistogramBins) - 1, exponent);
+      }
+    counts[bin]++;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::WriteJSON(ostream& os)
+{
+  os << "{\n";
+  os << "  \"cores\": " << vtkMultiThreader::GetGlobalDefaultNumberOfThreads() << ",\n";
+  os << "  \"unit\": \"ms\",\n";
+  os << "  \"stages\": {\n";
+  for (int stage = 0; stage < NumberOfStages; stage++)
+    {
+    int counts[NumberOfHistogramBins];
+    this->GetHistogram(stage, counts);
+    os << "    \"" << GetStageName(stage) << "\": {"
+       << "\"samples\": " << this->GetNumberOfSamples(stage)
+       << ", \"last\": " << 1000.0 * this->GetLastDuration(stage)
+       << ", \"mean\": " << 1000.0 * this->GetMeanDuration(stage)
+       << ", \"min\": " << 1000.0 * this->GetMinimumDuration(stage)
+       << ", \"p50\": " << 1000.0 * this->GetPercentileDuration(stage, 0.5)
+       << ", \"p90\": " << 1000.0 * this->GetPercentileDuration(stage, 0.9)
+       << ", \"p99\": " << 1000.0 * this->GetPercentileDuration(stage, 0.99)
+       << ", \"max\": " << 1000.0 * this->GetMaximumDuration(stage)
+       << ", \"histogramLog2Microseconds\": [";
+    for (int bin = 0; bin < NumberOfHistogramBins; bin++)
+      {
+      os << (bin ? ", " : "") << counts[bin];
+      }
+    os << "]}" << (stage < NumberOfStages - 1 ? "," : "") << "\n";
+    }
+  os << "  }\n";
+  os << "}\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::WriteCSV(ostream& os)
+{
+  os << "stage,samples,last_ms,mean_ms,min_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+  for (int stage = 0; stage < NumberOfStages; stage++)
+    {
+    os << GetStageName(stage) << ","
+       << this->GetNumberOfSamples(stage) << ","
+       << 1000.0 * this->GetLastDuration(stage) << ","
+       << 1000.0 * this->GetMeanDuration(stage) << ","
+       << 1000.0 * this->GetMinimumDuration(stage) << ","
+       << 1000.0 * this->GetPercentileDuration(stage, 0.5) << ","
+       << 1000.0 * this->GetPercentileDuration(stage, 0.9) << ","
+       << 1000.0 * this->GetPercentileDuration(stage, 0.99) << ","
+       << 1000.0 * this->GetMaximumDuration(stage) << "\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyClipProfiler::WriteTrace(ostream& os)
+{
+  this->Lock->Lock();
+  std::vector<TraceEvent> events;
+  // Oldest first once the ring has wrapped
+  if (static_cast<int>(this->TraceEvents.size()) == this->MaximumNumberOfTraceEvents)
+    {
+    events.assign(this->TraceEvents.begin() + this->NextTraceEvent, this->TraceEvents.end());
+    events.insert(events.end(), this->TraceEvents.begin(), this->TraceEvents.begin() + this->NextTraceEvent);
+    }
+  else
+    {
+    events = this->TraceEvents;
+    }
+  this->Lock->Unlock();
+
+  std::streamsize precision = os.precision(15);
+  os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  for (size_t i = 0; i < events.size(); i++)
+    {
+    const TraceEvent& event = events[i];
+    os << "  {\"name\": \"" << GetStageName(event.Stage) << "\", \"cat\": \"SmartModelClip\""
+       << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.Thread
+       << ", \"ts\": " << 1.0e6 * event.Begin
+       << ", \"dur\": " << 1.0e6 * event.Duration << "}"
+       << (i + 1 < events.size() ? "," : "") << "\n";
+    }
+  os << "]}\n";
+  os.precision(precision);
+}
+
+//----------------------------------------------------------------------------
+namespace
+{
+bool WriteFile(vtkOsteotomyClipProfiler* self, void (vtkOsteotomyClipProfiler::*write)(ostream&),
+               const char* fileName)
+{
+  if (!fileName)
+    {
+    return false;
+    }
+  ofstream os(fileName);
+  if (!os)
+    {
+    return false;
+    }
+  (self->*write)(os);
+  return static_cast<bool>(os);
+}
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyClipProfiler::WriteJSON(const char* fileName)
+{
+  return WriteFile(this, &vtkOsteotomyClipProfiler::WriteJSON, fileName);
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyClipProfiler::WriteCSV(const char* fileName)
+{
+  return WriteFile(this, &vtkOsteotomyClipProfiler::WriteCSV, fileName);
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyClipProfiler::WriteTrace(const char* fileName)
+{
+  return WriteFile(this, &vtkOsteotomyClipProfiler::WriteTrace, fileName);
+}
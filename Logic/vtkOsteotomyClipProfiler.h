@@ -0,0 +1,179 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyClipProfiler - durations of the stages of the clips
+// .SECTION Description
+// vtkOsteotomyClipProfiler records how long each stage of a clip takes:
+// building the clipping body, evaluating it, cutting the cells, copying the
+// results, creating their MRML nodes and displaying them. The stages are
+// timed by ScopedTimer objects, which cost two clock reads when the profiler
+// is enabled and nothing else otherwise.
+// The last HistorySize durations of every stage are kept, from which the
+// statistics and a histogram with power-of-two bins in microseconds are
+// computed. The last MaximumNumberOfTraceEvents timings are also kept as
+// trace events. The statistics can be written as JSON or CSV and the events
+// in the Chrome trace event format (chrome://tracing).
+// Samples may be added from several threads at once.
+
+#ifndef __vtkOsteotomyClipProfiler_h
+#define __vtkOsteotomyClipProfiler_h
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+#include "vtkSlicerSmartModelClipModuleLogicExport.h"
+
+class vtkSimpleMutexLock;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkOsteotomyClipProfiler :
+  public vtkObject
+{
+public:
+  static vtkOsteotomyClipProfiler *New();
+  vtkTypeMacro(vtkOsteotomyClipProfiler, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Stages of a clip
+  enum
+  {
+    TreeBuild = 0,
+    Evaluate,
+    Clip,
+    Copy,
+    NodeCreation,
+    Display,
+    NumberOfStages
+  };
+  static const char* GetStageName(int stage);
+
+  /// Bins of the histograms: bin b counts the durations d, in microseconds,
+  /// with 2^(b-1) <= d < 2^b; bin 0 counts those under a microsecond.
+  enum { NumberOfHistogramBins = 32 };
+
+  /// Record nothing while off. On by default.
+  vtkSetMacro(Enabled, int);
+  vtkGetMacro(Enabled, int);
+  vtkBooleanMacro(Enabled, int);
+
+  /// Number of most recent durations kept per stage. 256 by default.
+  virtual void SetHistorySize(int size);
+  vtkGetMacro(HistorySize, int);
+
+  /// Number of most recent trace events kept. 10000 by default.
+  virtual void SetMaximumNumberOfTraceEvents(int number);
+  vtkGetMacro(MaximumNumberOfTraceEvents, int);
+
+  /// Time in seconds from a monotonic clock with sub-microsecond resolution
+  /// where available.
+  static double GetTime();
+
+  /// Record a stage that started and ended at the given GetTime() values.
+  void AddSample(int stage, double begin, double end);
+
+  /// Forget every sample and restart the trace clock.
+  void Reset();
+
+  /// Statistics of the kept durations of a stage, in seconds.
+  int GetNumberOfSamples(int stage);
+  double GetLastDuration(int stage);
+  double GetMeanDuration(int stage);
+  double GetMinimumDuration(int stage);
+  double GetMaximumDuration(int stage);
+  /// Duration below which the given fraction (0 to 1) of the kept samples lie.
+  double GetPercentileDuration(int stage, double fraction);
+  void GetHistogram(int stage, int counts[NumberOfHistogramBins]);
+
+  /// Per stage statistics and histograms as a JSON object.
+  void WriteJSON(ostream& os);
+  bool WriteJSON(const char* fileName);
+
+  /// Per stage statistics as comma separated values, in milliseconds.
+  void WriteCSV(ostream& os);
+  bool WriteCSV(const char* fileName);
+
+  /// Trace events in the Chrome trace event format, one complete event per sample.
+  void WriteTrace(ostream& os);
+  bool WriteTrace(const char* fileName);
+
+//BTX
+  /// Time the enclosing scope, or until Stop(), as one sample of a stage.
+  /// Does nothing if the profiler is NULL or disabled.
+  class ScopedTimer
+  {
+  public:
+    ScopedTimer(vtkOsteotomyClipProfiler* profiler, int stage)
+      : Profiler((profiler && profiler->GetEnabled()) ? profiler : 0),
+        Stage(stage),
+        Begin(this->Profiler ? vtkOsteotomyClipProfiler::GetTime() : 0.0)
+      {}
+    ~ScopedTimer() { this->Stop(); }
+    void Stop()
+      {
+      if (this->Profiler)
+        {
+        this->Profiler->AddSample(this->Stage, this->Begin, vtkOsteotomyClipProfiler::GetTime());
+        this->Profiler = 0;
+        }
+      }
+  private:
+    vtkOsteotomyClipProfiler* Profiler;
+    int Stage;
+    double Begin;
+  };
+//ETX
+
+protected:
+  vtkOsteotomyClipProfiler();
+  virtual ~vtkOsteotomyClipProfiler();
+
+  int ThreadIndex();
+  void SortedDurations(int stage, std::vector<double>& durations);
+
+  int Enabled;
+  int HistorySize;
+  int MaximumNumberOfTraceEvents;
+  double StartTime;
+  vtkSimpleMutexLock* Lock;
+
+//BTX
+  struct TraceEvent
+  {
+    int Stage;
+    int Thread;
+    double Begin;
+    double Duration;
+  };
+
+  // Ring buffers: the oldest entry is overwritten once they are full
+  std::vector<double> Durations[NumberOfStages];
+  int NextDuration[NumberOfStages];
+  std::vector<TraceEvent> TraceEvents;
+  int NextTraceEvent;
+  class vtkInternal;
+  vtkInternal* Internal;
+//ETX
+
+private:
+  vtkOsteotomyClipProfiler(const vtkOsteotomyClipProfiler&); // Not implemented
+  void operator=(const vtkOsteotomyClipProfiler&);            // Not implemented
+};
+
+#endif
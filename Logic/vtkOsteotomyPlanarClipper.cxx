@@ -0,0 +1,621 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyPlanarClipper.h"
+#include "vtkOsteotomyCellBlocks.h"
+#include "vtkOsteotomyCSGProgram.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace
+{
+//----------------------------------------------------------------------------
+inline int Sign(double value)
+{
+  return value > 0 ? 1 : (value < 0 ? -1 : 0);
+}
+
+//----------------------------------------------------------------------------
+// Same arithmetic order as vtkOsteotomyCSGKernel
+inline double PlaneValue(const double* p, const double x[3])
+{
+  double v = p[0]*x[0] + p[1]*x[1];
+  v = v + p[2]*x[2];
+  return v + p[3];
+}
+
+//----------------------------------------------------------------------------
+// Vertex of a piece of a triangle
+struct PieceVertex
+{
+  vtkIdType Id;   // output point id
+  double X[3];
+  int Corner;     // triangle corner 0..2, -1 otherwise
+  int Edge;       // triangle edge 0..2 the vertex lies inside, -1 otherwise
+  double T;       // parameter along Edge, from its lower to its higher point id
+  int Planes[2];  // plane slots the vertex was created on, -1 if unused
+};
+
+//----------------------------------------------------------------------------
+// Convex piece. Support[i] is the line of the edge from V[i] to V[i+1]:
+// triangle edge 0..2, or 3+k for the cut made by plane slot k.
+struct Piece
+{
+  std::vector<PieceVertex> V;
+  std::vector<int> Support;
+
+  void Clear()
+    {
+    this->V.clear();
+    this->Support.clear();
+    }
+  void Push(const PieceVertex& v, int support)
+    {
+    this->V.push_back(v);
+    this->Support.push_back(support);
+    }
+};
+
+//----------------------------------------------------------------------------
+struct EdgeKey
+{
+  vtkIdType A, B;
+  int Plane;
+  bool operator<(const EdgeKey& other) const
+    {
+    if (this->A != other.A)
+      {
+      return this->A < other.A;
+      }
+    if (this->B != other.B)
+      {
+      return this->B < other.B;
+      }
+    return this->Plane < other.Plane;
+    }
+};
+
+//----------------------------------------------------------------------------
+class PlanarClipState
+{
+public:
+  PlanarClipState(vtkPolyData* input, vtkOsteotomyCSGProgram* program,
+                  vtkPoints* points, vtkPointData* outPD)
+    {
+    this->Input = input;
+    this->InPD = input->GetPointData();
+    this->Program = program;
+    this->Planes = program->GetPlaneCoefficients();
+    this->NumberOfPlanes = program->GetNumberOfPlanes();
+    this->Points = points;
+    this->OutPD = outPD;
+    this->PointMap.assign(input->GetNumberOfPoints(), -1);
+    this->D.resize(3 * this->NumberOfPlanes);
+    this->TriangleIds = vtkSmartPointer<vtkIdList>::New();
+    this->TriangleIds->SetNumberOfIds(3);
+    }
+
+  /// Load triangle (a,b,c) of cell cellId.
+  void SetTriangle(vtkIdType cellId, vtkIdType a, vtkIdType b, vtkIdType c);
+
+  /// Return the plane slots that split the current triangle.
+  void FindActivePlanes(std::vector<int>& activePlanes);
+
+  /// Split the triangle by the active planes; the pieces are appended to pieces.
+  void SplitTriangle(const std::vector<int>& activePlanes, std::vector<Piece>& pieces);
+
+  vtkIdType MapCorner(int c);
+
+  vtkIdType CellId;
+  vtkIdType PtIds[3];
+  double X[3][3];
+
+protected:
+  double Value(int k, int c) const
+    {
+    return this->D[3*k + c];
+    }
+  void EdgeCorners(int e, int& lo, int& hi) const
+    {
+    lo = e;
+    hi = (e + 1) % 3;
+    if (this->PtIds[hi] < this->PtIds[lo])
+      {
+      std::swap(lo, hi);
+      }
+    }
+
+  int Side(const PieceVertex& v, int k, double& value) const;
+  void Split(const Piece& piece, int k, Piece& pos, Piece& neg, bool& hasPos, bool& hasNeg);
+  PieceVertex EdgeVertex(int e, int k);
+  PieceVertex FaceVertex(const PieceVertex& u, const PieceVertex& w, int j, int k,
+                         double du, double dw);
+
+  vtkPolyData* Input;
+  vtkPointData* InPD;
+  vtkOsteotomyCSGProgram* Program;
+  const double* Planes;
+  int NumberOfPlanes;
+  vtkPoints* Points;
+  vtkPointData* OutPD;
+
+  std::vector<vtkIdType> PointMap;
+  std::map<EdgeKey, vtkIdType> EdgePoints;
+
+  // Per triangle: plane values at the corners and points inside the triangle
+  std::vector<double> D;
+  std::vector<PieceVertex> FacePoints;
+  vtkSmartPointer<vtkIdList> TriangleIds;
+};
+
+//----------------------------------------------------------------------------
+void PlanarClipState::SetTriangle(vtkIdType cellId, vtkIdType a, vtkIdType b, vtkIdType c)
+{
+  this->CellId = cellId;
+  this->PtIds[0] = a;
+  this->PtIds[1] = b;
+  this->PtIds[2] = c;
+  for (int i = 0; i < 3; i++)
+    {
+    this->Input->GetPoint(this->PtIds[i], this->X[i]);
+    this->TriangleIds->SetId(i, this->PtIds[i]);
+    }
+  this->FacePoints.clear();
+}
+
+//----------------------------------------------------------------------------
+void PlanarClipState::FindActivePlanes(std::vector<int>& activePlanes)
+{
+  activePlanes.clear();
+  for (int k = 0; k < this->NumberOfPlanes; k++)
+    {
+    const double* p = this->Planes + 4*k;
+    bool positive = false, negative = false;
+    for (int i = 0; i < 3; i++)
+      {
+      double value = PlaneValue(p, this->X[i]);
+      this->D[3*k + i] = value;
+      positive = positive || value > 0;
+      negative = negative || value < 0;
+      }
+    if (positive && negative)
+      {
+      activePlanes.push_back(k);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkIdType PlanarClipState::MapCorner(int c)
+{
+  vtkIdType ptId = this->PtIds[c];
+  vtkIdType& id = this->PointMap[ptId];
+  if (id < 0)
+    {
+    id = this->Points->InsertNextPoint(this->X[c]);
+    this->OutPD->CopyData(this->InPD, ptId, id);
+    }
+  return id;
+}
+
+//----------------------------------------------------------------------------
+int PlanarClipState::Side(const PieceVertex& v, int k, double& value) const
+{
+  if (v.Planes[0] == k || v.Planes[1] == k)
+    {
+    value = 0.0;
+    return 0;
+    }
+  if (v.Corner >= 0)
+    {
+    value = this->Value(k, v.Corner);
+    return Sign(value);
+    }
+  value = PlaneValue(this->Planes + 4*k, v.X);
+  if (v.Edge >= 0)
+    {
+    // Decided by the parameter along the mesh edge, as the neighbouring
+    // triangle does, so both sides of the edge cut it at the same point
+    int lo, hi;
+    this->EdgeCorners(v.Edge, lo, hi);
+    double dLo = this->Value(k, lo);
+    double dHi = this->Value(k, hi);
+    if (Sign(dLo) * Sign(dHi) < 0)
+      {
+      double t = dLo / (dLo - dHi);
+      return v.T < t ? Sign(dLo) : (v.T > t ? Sign(dHi) : 0);
+      }
+    return Sign(dLo) != 0 ? Sign(dLo) : Sign(dHi);
+    }
+  return Sign(value);
+}
+
+//----------------------------------------------------------------------------
+PieceVertex PlanarClipState::EdgeVertex(int e, int k)
+{
+  int lo, hi;
+  this->EdgeCorners(e, lo, hi);
+  double dLo = this->Value(k, lo);
+  double dHi = this->Value(k, hi);
+  double t = dLo / (dLo - dHi);
+
+  PieceVertex v;
+  v.Corner = -1;
+  v.Edge = e;
+  v.T = t;
+  v.Planes[0] = k;
+  v.Planes[1] = -1;
+  for (int i = 0; i < 3; i++)
+    {
+    v.X[i] = this->X[lo][i] + t * (this->X[hi][i] - this->X[lo][i]);
+    }
+
+  EdgeKey key;
+  key.A = this->PtIds[lo];
+  key.B = this->PtIds[hi];
+  key.Plane = k;
+  std::map<EdgeKey, vtkIdType>::iterator it = this->EdgePoints.find(key);
+  if (it != this->EdgePoints.end())
+    {
+    v.Id = it->second;
+    return v;
+    }
+  v.Id = this->Points->InsertNextPoint(v.X);
+  this->OutPD->InterpolateEdge(this->InPD, v.Id, key.A, key.B, t);
+  this->EdgePoints[key] = v.Id;
+  return v;
+}
+
+//----------------------------------------------------------------------------
+PieceVertex PlanarClipState::FaceVertex(const PieceVertex& u, const PieceVertex& w,
+                                        int j, int k, double du, double dw)
+{
+  int p0 = j < k ? j : k;
+  int p1 = j < k ? k : j;
+  for (size_t i = 0; i < this->FacePoints.size(); i++)
+    {
+    if (this->FacePoints[i].Planes[0] == p0 && this->FacePoints[i].Planes[1] == p1)
+      {
+      return this->FacePoints[i];
+      }
+    }
+
+  double t = du / (du - dw);
+  t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+  PieceVertex v;
+  v.Corner = -1;
+  v.Edge = -1;
+  v.T = 0.0;
+  v.Planes[0] = p0;
+  v.Planes[1] = p1;
+  for (int i = 0; i < 3; i++)
+    {
+    v.X[i] = u.X[i] + t * (w.X[i] - u.X[i]);
+    }
+
+  // Barycentric weights of the point in the triangle for the point data
+  double weights[3];
+  double e1[3], e2[3], ep[3], n[3], c[3];
+  vtkMath::Subtract(this->X[1], this->X[0], e1);
+  vtkMath::Subtract(this->X[2], this->X[0], e2);
+  vtkMath::Cross(e1, e2, n);
+  double area = vtkMath::Dot(n, n);
+  if (area > 0.0)
+    {
+    vtkMath::Subtract(v.X, this->X[0], ep);
+    vtkMath::Cross(ep, e2, c);
+    weights[1] = vtkMath::Dot(c, n) / area;
+    vtkMath::Cross(e1, ep, c);
+    weights[2] = vtkMath::Dot(c, n) / area;
+    weights[0] = 1.0 - weights[1] - weights[2];
+    }
+  else
+    {
+    weights[0] = weights[1] = weights[2] = 1.0 / 3.0;
+    }
+
+  v.Id = this->Points->InsertNextPoint(v.X);
+  this->OutPD->InterpolatePoint(this->InPD, v.Id, this->TriangleIds, weights);
+  this->FacePoints.push_back(v);
+  return v;
+}
+
+//----------------------------------------------------------------------------
+void PlanarClipState::Split(const Piece& piece, int k, Piece& pos, Piece& neg,
+                            bool& hasPos, bool& hasNeg)
+{
+  size_t n = piece.V.size();
+  std::vector<int> sides(n);
+  std::vector<double> values(n);
+  hasPos = false;
+  hasNeg = false;
+  for (size_t i = 0; i < n; i++)
+    {
+    sides[i] = this->Side(piece.V[i], k, values[i]);
+    hasPos = hasPos || sides[i] > 0;
+    hasNeg = hasNeg || sides[i] < 0;
+    }
+  if (!hasPos || !hasNeg)
+    {
+    return;
+    }
+
+  pos.Clear();
+  neg.Clear();
+  const int cut = 3 + k;
+  for (size_t i = 0; i < n; i++)
+    {
+    size_t j = (i + 1) % n;
+    int si = sides[i];
+    int sj = sides[j];
+    int support = piece.Support[i];
+
+    PieceVertex x = piece.V[i];
+    if (si * sj < 0)
+      {
+      x = (support < 3) ?
+        this->EdgeVertex(support, k) :
+        this->FaceVertex(piece.V[i], piece.V[j], support - 3, k, values[i], values[j]);
+      }
+
+    // Positive side
+    if (si >= 0)
+      {
+      if (sj >= 0)
+        {
+        pos.Push(piece.V[i], support);
+        }
+      else if (si > 0)
+        {
+        pos.Push(piece.V[i], support);
+        pos.Push(x, cut);
+        }
+      else
+        {
+        pos.Push(piece.V[i], cut);
+        }
+      }
+    else if (sj > 0)
+      {
+      pos.Push(x, support);
+      }
+
+    // Negative side
+    if (si <= 0)
+      {
+      if (sj <= 0)
+        {
+        neg.Push(piece.V[i], support);
+        }
+      else if (si < 0)
+        {
+        neg.Push(piece.V[i], support);
+        neg.Push(x, cut);
+        }
+      else
+        {
+        neg.Push(piece.V[i], cut);
+        }
+      }
+    else if (sj < 0)
+      {
+      neg.Push(x, support);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void PlanarClipState::SplitTriangle(const std::vector<int>& activePlanes,
+                                    std::vector<Piece>& pieces)
+{
+  std::vector<Piece> current(1);
+  for (int c = 0; c < 3; c++)
+    {
+    PieceVertex v;
+    v.Id = this->MapCorner(c);
+    v.X[0] = this->X[c][0];
+    v.X[1] = this->X[c][1];
+    v.X[2] = this->X[c][2];
+    v.Corner = c;
+    v.Edge = -1;
+    v.T = 0.0;
+    v.Planes[0] = v.Planes[1] = -1;
+    current[0].Push(v, c);
+    }
+
+  std::vector<Piece> next;
+  Piece pos, neg;
+  for (size_t a = 0; a < activePlanes.size(); a++)
+    {
+    next.clear();
+    for (size_t p = 0; p < current.size(); p++)
+      {
+      bool hasPos, hasNeg;
+      this->Split(current[p], activePlanes[a], pos, neg, hasPos, hasNeg);
+      if (!hasPos || !hasNeg)
+        {
+        next.push_back(current[p]);
+        continue;
+        }
+      if (pos.V.size() >= 3)
+        {
+        next.push_back(pos);
+        }
+      if (neg.V.size() >= 3)
+        {
+        next.push_back(neg);
+        }
+      }
+    current.swap(next);
+    }
+  pieces.insert(pieces.end(), current.begin(), current.end());
+}
+}
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkOsteotomyPlanarClipper);
+
+//----------------------------------------------------------------------------
+vtkOsteotomyPlanarClipper::vtkOsteotomyPlanarClipper()
+{
+  this->NumberOfSplitTriangles = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyPlanarClipper::~vtkOsteotomyPlanarClipper()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlanarClipper::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number Of Split Triangles: " << this->NumberOfSplitTriangles << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyPlanarClipper::Clip(vtkPolyData* input, vtkOsteotomyCSGProgram* program,
+                                     int insideOut, vtkPolyData* reserved, vtkPolyData* clipped,
+                                     const signed char* blockClasses)
+{
+  this->NumberOfSplitTriangles = 0;
+  if (!input || !program || !reserved || !clipped ||
+      program->GetNumberOfInstructions() == 0 || !input->GetPolys())
+    {
+    return false;
+    }
+
+  vtkIdType numPts = input->GetNumberOfPoints();
+  vtkIdType numPolys = input->GetNumberOfPolys();
+
+  vtkSmartPointer<vtkPoints> newPoints = vtkSmartPointer<vtkPoints>::New();
+  newPoints->Allocate(numPts, numPts/2);
+  vtkPointData* outPD = reserved->GetPointData();
+  outPD->InterpolateAllocate(input->GetPointData(), numPts, numPts/2);
+
+  vtkSmartPointer<vtkCellArray> newPolys[2];
+  vtkCellData* outCD[2] = { reserved->GetCellData(), clipped->GetCellData() };
+  for (int k = 0; k < 2; k++)
+    {
+    newPolys[k] = vtkSmartPointer<vtkCellArray>::New();
+    newPolys[k]->Allocate(numPolys, numPolys/2);
+    outCD[k]->CopyAllocate(input->GetCellData(), numPolys, numPolys/2);
+    }
+
+  PlanarClipState state(input, program, newPoints, outPD);
+  std::vector<int> activePlanes;
+  std::vector<Piece> pieces;
+
+  // Polys come after the verts and lines in the cell ids of vtkPolyData
+  vtkIdType cellId = input->GetNumberOfVerts() + input->GetNumberOfLines();
+  vtkIdType npts;
+  vtkIdType* pts;
+  vtkCellArray* polys = input->GetPolys();
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts); cellId++)
+    {
+    for (vtkIdType f = 1; f + 1 < npts; f++)
+      {
+      state.SetTriangle(cellId, pts[0], pts[f], pts[f+1]);
+
+      signed char blockClass = blockClasses ?
+        blockClasses[cellId / vtkOsteotomyCellBlocks::BlockSize] : vtkOsteotomyCellBlocks::Straddling;
+      if (blockClass != vtkOsteotomyCellBlocks::Straddling)
+        {
+        int out = ((blockClass == vtkOsteotomyCellBlocks::Positive) != (insideOut != 0)) ? 0 : 1;
+        vtkIdType ids[3] = { state.MapCorner(0), state.MapCorner(1), state.MapCorner(2) };
+        vtkIdType newCellId = newPolys[out]->InsertNextCell(3, ids);
+        outCD[out]->CopyData(input->GetCellData(), cellId, newCellId);
+        continue;
+        }
+
+      state.FindActivePlanes(activePlanes);
+      if (activePlanes.empty())
+        {
+        // Every plane keeps one side over the whole triangle
+        double centroid[3];
+        for (int i = 0; i < 3; i++)
+          {
+          centroid[i] = (state.X[0][i] + state.X[1][i] + state.X[2][i]) / 3.0;
+          }
+        double value = program->EvaluateFunction(centroid);
+        int out = (insideOut ? value < 0 : value > 0) ? 0 : 1;
+        vtkIdType ids[3] = { state.MapCorner(0), state.MapCorner(1), state.MapCorner(2) };
+        vtkIdType newCellId = newPolys[out]->InsertNextCell(3, ids);
+        outCD[out]->CopyData(input->GetCellData(), cellId, newCellId);
+        continue;
+        }
+
+      this->NumberOfSplitTriangles++;
+      pieces.clear();
+      state.SplitTriangle(activePlanes, pieces);
+      for (size_t p = 0; p < pieces.size(); p++)
+        {
+        const std::vector<PieceVertex>& v = pieces[p].V;
+        double centroid[3] = { 0.0, 0.0, 0.0 };
+        for (size_t i = 0; i < v.size(); i++)
+          {
+          centroid[0] += v[i].X[0];
+          centroid[1] += v[i].X[1];
+          centroid[2] += v[i].X[2];
+          }
+        for (int i = 0; i < 3; i++)
+          {
+          centroid[i] /= v.size();
+          }
+        double value = program->EvaluateFunction(centroid);
+        int out = (insideOut ? value < 0 : value > 0) ? 0 : 1;
+        for (size_t i = 1; i + 1 < v.size(); i++)
+          {
+          vtkIdType ids[3] = { v[0].Id, v[i].Id, v[i+1].Id };
+          if (ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2])
+            {
+            continue;
+            }
+          vtkIdType newCellId = newPolys[out]->InsertNextCell(3, ids);
+          outCD[out]->CopyData(input->GetCellData(), cellId, newCellId);
+          }
+        }
+      }
+    }
+
+  reserved->SetPoints(newPoints);
+  reserved->SetPolys(newPolys[0]);
+  reserved->Squeeze();
+
+  clipped->SetPoints(newPoints);
+  clipped->GetPointData()->ShallowCopy(outPD);
+  clipped->SetPolys(newPolys[1]);
+  clipped->Squeeze();
+
+  return true;
+}
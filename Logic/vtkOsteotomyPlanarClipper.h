@@ -0,0 +1,74 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyPlanarClipper - exact clip of polygons by a piecewise-planar body
+// .SECTION Description
+// vtkOsteotomyPlanarClipper cuts every triangle of a model with the planes of
+// a compiled vtkOsteotomyCSGProgram. Only the planes that separate the corners
+// of a triangle split it; each resulting convex piece lies on one side of every
+// plane, so the union/intersection program evaluated at its centroid tells
+// which output it belongs to. The cut edges therefore follow the planes and
+// their intersections exactly, including the corners where two planes meet,
+// which clipping by interpolated min/max scalars rounds off.
+// Intersection points are shared through keys (mesh edge and plane, or cell
+// and plane pair), so neighbouring triangles stay connected.
+// Polygons with more than three points are split into a fan of triangles.
+
+#ifndef __vtkOsteotomyPlanarClipper_h
+#define __vtkOsteotomyPlanarClipper_h
+
+// VTK includes
+#include <vtkObject.h>
+
+#include "vtkSlicerSmartModelClipModuleLogicExport.h"
+
+class vtkOsteotomyCSGProgram;
+class vtkPolyData;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkOsteotomyPlanarClipper :
+  public vtkObject
+{
+public:
+  static vtkOsteotomyPlanarClipper *New();
+  vtkTypeMacro(vtkOsteotomyPlanarClipper, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Clip the polygons of input with a compiled program. Pieces where the
+  /// program is positive go to reserved (negative with insideOut). Both
+  /// outputs share the same points. Returns false if nothing could be clipped.
+  /// blockClasses, if given, holds the vtkOsteotomyCellBlocks class of every
+  /// block of cells; the triangles of decided blocks are copied without tests.
+  bool Clip(vtkPolyData* input, vtkOsteotomyCSGProgram* program, int insideOut,
+            vtkPolyData* reserved, vtkPolyData* clipped,
+            const signed char* blockClasses = 0);
+
+  /// Number of triangles split by at least one plane during the last clip.
+  vtkGetMacro(NumberOfSplitTriangles, vtkIdType);
+
+protected:
+  vtkOsteotomyPlanarClipper();
+  virtual ~vtkOsteotomyPlanarClipper();
+
+  vtkIdType NumberOfSplitTriangles;
+
+private:
+  vtkOsteotomyPlanarClipper(const vtkOsteotomyPlanarClipper&); // Not implemented
+  void operator=(const vtkOsteotomyPlanarClipper&);             // Not implemented
+};
+
+#endif
@@ -0,0 +1,978 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyPlaneChain.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+//----------------------------------------------------------------------------
+vtkStandardNewMacro(vtkOsteotomyPlaneChain);
+
+//----------------------------------------------------------------------------
+vtkOsteotomyPlaneChain::vtkOsteotomyPlaneChain()
+{
+  this->Corners = vtkDoubleArray::New();
+  this->Corners->SetNumberOfComponents(12);
+  this->HasDepthPlane = 0;
+  memset(this->DepthPlaneCorners, 0, sizeof(this->DepthPlaneCorners));
+  this->ReverseClipping = 0;
+  this->ReverseDepthPlane = 0;
+  this->DepthPlaneMTime = 0;
+  this->FirstPlaneOfClipping = 0;
+  this->LastPlaneCrossingLastMTime = 0;
+  this->LastPlaneCrossingFirstMTime = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkOsteotomyPlaneChain::~vtkOsteotomyPlaneChain()
+{
+  this->Corners->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number Of Planes: " << this->GetNumberOfPlanes() << "\n";
+  os << indent << "Has Depth Plane: " << (this->HasDepthPlane ? "On" : "Off") << "\n";
+  os << indent << "Reverse Clipping: " << (this->ReverseClipping ? "On" : "Off") << "\n";
+  os << indent << "Reverse Depth Plane: " << (this->ReverseDepthPlane ? "On" : "Off") << "\n";
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyPlaneChain::GetNumberOfPlanes()
+{
+  return static_cast<int>(this->Corners->GetNumberOfTuples());
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyPlaneChain::AddPlane(double origin[3], double point1[3],
+                                     double point2[3], double point3[3])
+{
+  double corners[12];
+  for (int k = 0; k < 3; k++)
+    {
+    corners[k] = origin[k];
+    corners[3 + k] = point1[k];
+    corners[6 + k] = point2[k];
+    corners[9 + k] = point3[k];
+    }
+  vtkIdType id = this->Corners->InsertNextTuple(corners);
+  this->Modified();
+  this->PlaneMTimes.push_back(this->GetMTime());
+  return static_cast<int>(id);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::SetPlane(int i, double origin[3], double point1[3],
+                                      double point2[3], double point3[3])
+{
+  double* corners = this->Corners->GetPointer(12 * i);
+  double newCorners[12];
+  for (int k = 0; k < 3; k++)
+    {
+    newCorners[k] = origin[k];
+    newCorners[3 + k] = point1[k];
+    newCorners[6 + k] = point2[k];
+    newCorners[9 + k] = point3[k];
+    }
+  if (memcmp(corners, newCorners, sizeof(newCorners)) == 0)
+    {
+    return; //no change
+    }
+  memcpy(corners, newCorners, sizeof(newCorners));
+  this->Modified();
+  this->PlaneMTimes[i] = this->GetMTime();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::RemoveLastPlane()
+{
+  int numOfPlanes = this->GetNumberOfPlanes();
+  if (numOfPlanes == 0)
+    {
+    return;
+    }
+  this->Corners->SetNumberOfTuples(numOfPlanes - 1);
+  this->PlaneMTimes.pop_back();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::RemoveAllPlanes()
+{
+  this->Corners->SetNumberOfTuples(0);
+  this->PlaneMTimes.clear();
+  this->HasDepthPlane = 0;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetOrigin(int i)
+{
+  return this->Corners->GetPointer(12 * i);
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetPoint1(int i)
+{
+  return this->Corners->GetPointer(12 * i + 3);
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetPoint2(int i)
+{
+  return this->Corners->GetPointer(12 * i + 6);
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetPoint3(int i)
+{
+  return this->Corners->GetPointer(12 * i + 9);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::SetPoint2(int i, double point2[3])
+{
+  this->SetPlane(i, this->GetOrigin(i), this->GetPoint1(i), point2, this->GetPoint3(i));
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::GetNormal(int i, double normal[3])
+{
+  double v1[3], v2[3];
+  vtkMath::Subtract(this->GetPoint1(i), this->GetOrigin(i), v1);
+  vtkMath::Subtract(this->GetPoint2(i), this->GetOrigin(i), v2);
+  vtkMath::Cross(v1, v2, normal);
+  vtkMath::Normalize(normal);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::GetCenter(int i, double center[3])
+{
+  double* o = this->GetOrigin(i);
+  double* pt1 = this->GetPoint1(i);
+  double* pt2 = this->GetPoint2(i);
+  double* pt3 = this->GetPoint3(i);
+  for (int k = 0; k < 3; k++)
+    {
+    center[k] = 1/4.0*(o[k] + pt1[k] + pt2[k] + pt3[k]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::GetPlaneCoefficients(int i, double abcd[4])
+{
+  double center[3];
+  this->GetNormal(i, abcd);
+  this->GetCenter(i, center);
+  abcd[3] = -vtkMath::Dot(abcd, center);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::SetDepthPlane(double origin[3], double point1[3],
+                                           double point2[3], double point3[3])
+{
+  double newCorners[12];
+  for (int k = 0; k < 3; k++)
+    {
+    newCorners[k] = origin[k];
+    newCorners[3 + k] = point1[k];
+    newCorners[6 + k] = point2[k];
+    newCorners[9 + k] = point3[k];
+    }
+  if (this->HasDepthPlane &&
+      memcmp(this->DepthPlaneCorners, newCorners, sizeof(newCorners)) == 0)
+    {
+    return; //no change
+    }
+  memcpy(this->DepthPlaneCorners, newCorners, sizeof(newCorners));
+  this->HasDepthPlane = 1;
+  this->Modified();
+  this->DepthPlaneMTime = this->GetMTime();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::SetReverseDepthPlane(int reverse)
+{
+  if (this->ReverseDepthPlane == reverse)
+    {
+    return;
+    }
+  this->ReverseDepthPlane = reverse;
+  this->Modified();
+  this->DepthPlaneMTime = this->GetMTime();
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkOsteotomyPlaneChain::GetPlaneMTime(int i)
+{
+  return this->PlaneMTimes[i];
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::RemoveDepthPlane()
+{
+  if (!this->HasDepthPlane)
+    {
+    return;
+    }
+  this->HasDepthPlane = 0;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetDepthPlaneOrigin()
+{
+  return this->DepthPlaneCorners;
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetDepthPlanePoint1()
+{
+  return this->DepthPlaneCorners + 3;
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetDepthPlanePoint2()
+{
+  return this->DepthPlaneCorners + 6;
+}
+
+//----------------------------------------------------------------------------
+double* vtkOsteotomyPlaneChain::GetDepthPlanePoint3()
+{
+  return this->DepthPlaneCorners + 9;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::GetDepthPlaneCoefficients(double abcd[4])
+{
+  double* o = this->GetDepthPlaneOrigin();
+  double* pt1 = this->GetDepthPlanePoint1();
+  double* pt2 = this->GetDepthPlanePoint2();
+  double* pt3 = this->GetDepthPlanePoint3();
+
+  // Reversing the depth plane swaps Point1 and Point2, i.e. flips the normal
+  double v1[3], v2[3], center[3];
+  vtkMath::Subtract(pt1, o, v1);
+  vtkMath::Subtract(pt2, o, v2);
+  if (this->ReverseDepthPlane)
+    {
+    vtkMath::Cross(v2, v1, abcd);
+    }
+  else
+    {
+    vtkMath::Cross(v1, v2, abcd);
+    }
+  vtkMath::Normalize(abcd);
+  for (int k = 0; k < 3; k++)
+    {
+    center[k] = 1/4.0*(o[k] + pt1[k] + pt2[k] + pt3[k]);
+    }
+  abcd[3] = -vtkMath::Dot(abcd, center);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::DeepCopy(vtkOsteotomyPlaneChain* source)
+{
+  if (source == NULL || source == this)
+    {
+    return;
+    }
+  this->Corners->DeepCopy(source->Corners);
+  // A modification time belongs to a single change of a single plane, so the
+  // copied planes keep the times of the source
+  this->PlaneMTimes = source->PlaneMTimes;
+  this->DepthPlaneMTime = source->DepthPlaneMTime;
+  this->HasDepthPlane = source->HasDepthPlane;
+  memcpy(this->DepthPlaneCorners, source->DepthPlaneCorners, sizeof(this->DepthPlaneCorners));
+  this->ReverseClipping = source->ReverseClipping;
+  this->ReverseDepthPlane = source->ReverseDepthPlane;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::WriteSpecification(ostream& os)
+{
+  os.precision(17);
+  os << "# osteotomy plane chain: Origin Point1 Point2 Point3 per plane\n";
+  for (int i = 0; i < this->GetNumberOfPlanes(); i++)
+    {
+    double* corners = this->Corners->GetTuple(i);
+    os << "plane";
+    for (int j = 0; j < 12; j++)
+      {
+      os << " " << corners[j];
+      }
+    os << "\n";
+    }
+  if (this->HasDepthPlane)
+    {
+    os << "depth";
+    for (int j = 0; j < 12; j++)
+      {
+      os << " " << this->DepthPlaneCorners[j];
+      }
+    os << "\n";
+    }
+  os << "reverseClipping " << this->ReverseClipping << "\n";
+  os << "reverseDepthPlane " << this->ReverseDepthPlane << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyPlaneChain::WriteSpecification(const char* fileName)
+{
+  if (!fileName)
+    {
+    return false;
+    }
+  ofstream os(fileName);
+  if (!os)
+    {
+    vtkErrorMacro(<< "WriteSpecification: cannot open " << fileName);
+    return false;
+    }
+  this->WriteSpecification(os);
+  return static_cast<bool>(os);
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyPlaneChain::ReadSpecification(istream& is)
+{
+  // Read into a scratch chain, so that a malformed file changes nothing
+  vtkSmartPointer<vtkOsteotomyPlaneChain> chain = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(is, line))
+    {
+    lineNumber++;
+    std::istringstream fields(line);
+    std::string keyword;
+    if (!(fields >> keyword) || keyword[0] == '#')
+      {
+      continue;
+      }
+
+    bool valid = true;
+    if (keyword == "plane" || keyword == "depth")
+      {
+      double corners[12];
+      for (int j = 0; j < 12 && valid; j++)
+        {
+        valid = static_cast<bool>(fields >> corners[j]);
+        }
+      if (valid && keyword == "plane")
+        {
+        chain->AddPlane(corners, corners + 3, corners + 6, corners + 9);
+        }
+      else if (valid)
+        {
+        chain->SetDepthPlane(corners, corners + 3, corners + 6, corners + 9);
+        }
+      }
+    else if (keyword == "reverseClipping" || keyword == "reverseDepthPlane")
+      {
+      int flag = 0;
+      valid = static_cast<bool>(fields >> flag);
+      if (valid && keyword == "reverseClipping")
+        {
+        chain->SetReverseClipping(flag != 0);
+        }
+      else if (valid)
+        {
+        chain->SetReverseDepthPlane(flag != 0);
+        }
+      }
+    else
+      {
+      valid = false;
+      }
+
+    if (!valid)
+      {
+      vtkErrorMacro(<< "ReadSpecification: malformed line " << lineNumber << ": " << line);
+      return false;
+      }
+    }
+
+  this->DeepCopy(chain);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsteotomyPlaneChain::ReadSpecification(const char* fileName)
+{
+  if (!fileName)
+    {
+    return false;
+    }
+  ifstream is(fileName);
+  if (!is)
+    {
+    vtkErrorMacro(<< "ReadSpecification: cannot open " << fileName);
+    return false;
+    }
+  return this->ReadSpecification(is);
+}
+
+//---------------------------TOOLS USED TO CREATE A PLANE----------------------------------
+
+// Point2 coordinates of first two planes satisfy such requirements that the line segment of Point2 and Point3 is
+// perpendicular with the line segment of Origin and Point1.
+void vtkOsteotomyPlaneChain::CalculatePoint2CoordinatesOfFirstTwoPlanes(
+  double origin[3], double point1[3], double point2[3], double newPoint2[3])
+{
+  double vectorFromPointOriginTOPoint1[3];
+  double vectorFromPointOriginTOPoint2[3];
+  vtkMath::Subtract(point1, origin, vectorFromPointOriginTOPoint1);
+  vtkMath::Subtract(point2, origin, vectorFromPointOriginTOPoint2);
+
+  double tempt = vtkMath::Dot(vectorFromPointOriginTOPoint1, vectorFromPointOriginTOPoint2)
+    /vtkMath::Norm(vectorFromPointOriginTOPoint1)/vtkMath::Norm(vectorFromPointOriginTOPoint1);
+  vtkMath::MultiplyScalar(vectorFromPointOriginTOPoint1, tempt);
+  vtkMath::Subtract(vectorFromPointOriginTOPoint2, vectorFromPointOriginTOPoint1, vectorFromPointOriginTOPoint2);
+  vtkMath::Add(vectorFromPointOriginTOPoint2, origin, newPoint2);
+}
+
+// calculate the intersection point of the plane(which pass through Origin of plane m-2,
+// Point2 of plane m-2 and Point2 of plane m-1)and the line (which pass through Point3 and Point2
+// of plane m).We define this intersection point as the plane m 's new coordinates of point2's.
+void vtkOsteotomyPlaneChain::CalIntersectionPointOfPlaneAndLine(
+  double secondLastOrigin[3], double secondLastPoint2[3],
+  double lastOrigin[3], double lastPoint2[3],
+  double point2[3], double point3[3], double intersection[3])
+{
+  double SLPO2[3];
+  vtkMath::Subtract(secondLastPoint2, secondLastOrigin, SLPO2);
+  double PPO2[3];
+  vtkMath::Subtract(lastPoint2, lastOrigin, PPO2);
+
+  double norm[3];
+  vtkMath::Cross(SLPO2, PPO2, norm);
+
+  double lineVector[3];
+  vtkMath::Subtract(point2, point3, lineVector);
+
+  double temp[3];
+  vtkMath::Subtract(secondLastOrigin, point3, temp);
+
+  double t = vtkMath::Dot(norm, temp) / vtkMath::Dot(norm, lineVector);
+
+  intersection[0] = point3[0] + lineVector[0]*t;
+  intersection[1] = point3[1] + lineVector[1]*t;
+  intersection[2] = point3[2] + lineVector[2]*t;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsteotomyPlaneChain::CalIntersectionPointOfPlaneAndLine(int m, double intersection[3])
+{
+  vtkOsteotomyPlaneChain::CalIntersectionPointOfPlaneAndLine(
+    this->GetOrigin(m-2), this->GetPoint2(m-2),
+    this->GetOrigin(m-1), this->GetPoint2(m-1),
+    this->GetPoint2(m), this->GetPoint3(m), intersection);
+}
+
+//---------------------------TOOLS USED TO CLIP THE MODEL-----------------------------------
+
+// A range m..n of planes is split from its planes alone (the projection of
+// the path also depends on the walls of plane 0), so its split plane stays
+// valid until one of its planes changes
+void vtkOsteotomyPlaneChain::UpdateRanges()
+{
+  if (this->RangesTime.GetMTime() > this->GetMTime())
+    {
+    return;
+    }
+
+  int numOfPlanes = static_cast<int>(this->PlaneMTimes.size());
+  int numOfChecked = static_cast<int>(this->RangePlaneMTimes.size());
+  if (numOfPlanes == 0 || numOfChecked == 0 || this->PlaneMTimes[0] != this->RangePlaneMTimes[0])
+    {
+    this->Ranges.clear();
+    }
+  else
+    {
+    // changed[k] is the number of changed planes before plane k
+    std::vector<int> changed(numOfPlanes + 1, 0);
+    for (int k = 0; k < numOfPlanes; k++)
+      {
+      bool planeChanged = k >= numOfChecked || this->PlaneMTimes[k] != this->RangePlaneMTimes[k];
+      changed[k + 1] = changed[k] + (planeChanged ? 1 : 0);
+      }
+    std::map<std::pair<int, int>, int>::iterator it = this->Ranges.begin();
+    while (it != this->Ranges.end())
+      {
+      int m = it->first.first;
+      int n = it->first.second;
+      if (n >= numOfPlanes || changed[n + 1] != changed[m])
+        {
+        this->Ranges.erase(it++);
+        }
+      else
+        {
+        ++it;
+        }
+      }
+    }
+
+  this->RangePlaneMTimes = this->PlaneMTimes;
+  this->RangesTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkOsteotomyPlaneChain::GetSplitPlane(int m, int n)
+{
+  this->UpdateRanges();
+  std::map<std::pair<int, int>, int>::iterator it = this->Ranges.find(std::make_pair(m, n));
+  if (it != this->Ranges.end())
+    {
+    return it->second;
+    }
+
+  int i = n;
+  while (this->IsIntersect1(m, i) || this->IsIntersect2(i-1, n))
+    {
+    i--;
+    if ((i-m) == 1)
+      {
+      break;
+      }
+    }
+  this->Ranges[std::make_pair(m, n)] = i;
+  return i;
+}
+
+// If the last plane's line segment is intersected with its previous planes' line segments twice,we define the
+// first plane Of clipping model is the larger sequence number.Or we define the first plane Of clipping model
+// is the plane 0
+int vtkOsteotomyPlaneChain::DetermineFirstPlaneOfClipping()
+{
+  int numOfPlanes = this->GetNumberOfPlanes();
+  if (numOfPlanes < 4)
+    {
+    return 0;
+    }
+  if (this->FirstPlaneOfClippingTime.GetMTime() > this->GetMTime())
+    {
+    return this->FirstPlaneOfClipping;
+    }
+
+  // Every crossing depends on the last plane, whose extension is tested, and
+  // on plane 0, which gives the projection of the path. When either changes,
+  // as when a plane is appended or removed, the crossings are forgotten; they
+  // are then tested on demand by the scan below, which stops at the second
+  // one, so such a change costs no more than a scan without memory.
+  int last = numOfPlanes-1;
+  if (static_cast<int>(this->LastPlaneCrossings.size()) != numOfPlanes-2 ||
+      this->LastPlaneCrossingLastMTime != this->PlaneMTimes[last] ||
+      this->LastPlaneCrossingFirstMTime != this->PlaneMTimes[0])
+    {
+    this->LastPlaneCrossings.assign(numOfPlanes-2, -1);
+    this->LastPlaneCrossingMTimes.assign(numOfPlanes-2, 0);
+    this->LastPlaneCrossingLastMTime = this->PlaneMTimes[last];
+    this->LastPlaneCrossingFirstMTime = this->PlaneMTimes[0];
+    }
+
+  int i = numOfPlanes-3;//numOfPlanes>=4;i>=1
+  int firstPlaneNum = 0;
+  int intersectPlaneNum;
+  this->FirstPlaneOfClipping = 0;
+  this->FirstPlaneOfClippingTime.Modified();
+  while (i >= 0)
+    {
+    // The segment of plane i depends on plane i, or on plane 1 for i = 0
+    // (from the reverse extension of plane 0 to origin 1)
+    unsigned long segmentMTime = this->PlaneMTimes[i == 0 ? 1 : i];
+    if (this->LastPlaneCrossings[i] < 0 || this->LastPlaneCrossingMTimes[i] != segmentMTime)
+      {
+      this->LastPlaneCrossings[i] = this->IsIntersectWithTheSingleLineSegment(i) ? 1 : 0;
+      this->LastPlaneCrossingMTimes[i] = segmentMTime;
+      }
+    if (this->LastPlaneCrossings[i])
+      {
+      intersectPlaneNum = i;
+      if (firstPlaneNum == 0)
+        {
+        firstPlaneNum = i;
+        }
+      if (intersectPlaneNum != firstPlaneNum)
+        {
+        this->FirstPlaneOfClipping = firstPlaneNum;
+        return firstPlaneNum;
+        }
+      }
+    i--;
+    }
+  return 0;  //return the  0th plane
+}
+
+// judge whether the plane i is inside plane i-1(i>=1)
+int vtkOsteotomyPlaneChain::IsPlaneInside(int i)
+{
+  double oP2[3];
+  vtkMath::Subtract(this->GetPoint2(i), this->GetOrigin(i), oP2);
+  double normal[3];
+  this->GetNormal(i-1, normal);
+  double dot = vtkMath::Dot(normal, oP2);
+  return (dot < 0) ? 1 : 0;
+}
+
+//---------------------------INTERSECTIONS OF THE PATH------------------------------------
+namespace
+{
+// Segments closer than this are taken as intersecting
+const double PathTolerance = 0.001;
+
+// The segments of the path are extended to 100 times their length
+const double PathExtension = 100.0;
+
+//----------------------------------------------------------------------------
+inline double Cross2D(const double a[2], const double b[2], const double c[2])
+{
+  return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+//----------------------------------------------------------------------------
+inline double Distance2ToSegment2D(const double p[2], const double a[2], const double b[2])
+{
+  double ab[2] = { b[0] - a[0], b[1] - a[1] };
+  double ap[2] = { p[0] - a[0], p[1] - a[1] };
+  double length2 = ab[0] * ab[0] + ab[1] * ab[1];
+  double t = (length2 > 0.0) ? (ap[0] * ab[0] + ap[1] * ab[1]) / length2 : 0.0;
+  t = std::min(1.0, std::max(0.0, t));
+  double dx = ap[0] - t * ab[0];
+  double dy = ap[1] - t * ab[1];
+  return dx * dx + dy * dy;
+}
+
+//----------------------------------------------------------------------------
+// Whether the segments a1a2 and b1b2 cross or come within PathTolerance
+bool SegmentsIntersect2D(const double a1[2], const double a2[2],
+                         const double b1[2], const double b2[2])
+{
+  double d1 = Cross2D(b1, b2, a1);
+  double d2 = Cross2D(b1, b2, a2);
+  double d3 = Cross2D(a1, a2, b1);
+  double d4 = Cross2D(a1, a2, b2);
+  if (((d1 > 0.0 && d2 < 0.0) || (d1 < 0.0 && d2 > 0.0)) &&
+      ((d3 > 0.0 && d4 < 0.0) || (d3 < 0.0 && d4 > 0.0)))
+    {
+    return true;
+    }
+  // Segments that do not cross are closest at one of their end points
+  const double tolerance2 = PathTolerance * PathTolerance;
+  return Distance2ToSegment2D(a1, b1, b2) <= tolerance2 ||
+         Distance2ToSegment2D(a2, b1, b2) <= tolerance2 ||
+         Distance2ToSegment2D(b1, a1, a2) <= tolerance2 ||
+         Distance2ToSegment2D(b2, a1, a2) <= tolerance2;
+}
+
+//----------------------------------------------------------------------------
+// The segment of a plane (Origin, Point2 in the path plane) extended from
+// the Origin through Point2, or reversely from Point2 through the Origin
+inline void ExtendSegment2D(const double* segment, double output[2])
+{
+  output[0] = segment[0] + PathExtension * (segment[2] - segment[0]);
+  output[1] = segment[1] + PathExtension * (segment[3] - segment[1]);
+}
+
+inline void ReverseExtendSegment2D(const double* segment, double output[2])
+{
+  output[0] = segment[2] + PathExtension * (segment[0] - segment[2]);
+  output[1] = segment[3] + PathExtension * (segment[1] - segment[3]);
+}
+
+//----------------------------------------------------------------------------
+// Whether the segment of plane i, extended both ways, crosses the segment
+// from origin s to origin s+1
+inline bool LineCrosses(const double* path, int i, int s)
+{
+  const double* segment = path + 4 * i;
+  double forward[2];
+  double backward[2];
+  ExtendSegment2D(segment, forward);
+  ReverseExtendSegment2D(segment, backward);
+  return SegmentsIntersect2D(segment, forward, path + 4 * s, path + 4 * (s + 1)) ||
+         SegmentsIntersect2D(segment, backward, path + 4 * s, path + 4 * (s + 1));
+}
+
+//----------------------------------------------------------------------------
+// Whether the segment of plane i, extended from its Origin, crosses the
+// segment from origin s to origin s+1
+inline bool RayCrosses(const double* path, int i, int s)
+{
+  const double* segment = path + 4 * i;
+  double forward[2];
+  ExtendSegment2D(segment, forward);
+  return SegmentsIntersect2D(segment, forward, path + 4 * s, path + 4 * (s + 1));
+}
+
+//----------------------------------------------------------------------------
+// Largest s in [1, from] crossed by the line of plane i, or -1
+int FindLastLineCrossing(const double* path, int i, int from)
+{
+  for (int s = from; s >= 1; s--)
+    {
+    if (LineCrosses(path, i, s))
+      {
+      return s;
+      }
+    }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+// Smallest s in [from, numOfPlanes-2] crossed by the ray of plane i, or numOfPlanes
+int FindFirstRayCrossing(const double* path, int i, int from, int numOfPlanes)
+{
+  for (int s = from; s <= numOfPlanes - 2; s++)
+    {
+    if (RayCrosses(path, i, s))
+      {
+      return s;
+      }
+    }
+  return numOfPlanes;
+}
+}
+
+//----------------------------------------------------------------------------
+// The walls of the planes all rise along Point1 - Origin, so two walls meet
+// where their segments meet once projected along that direction. The
+// projection and the crossings of the extended segments with the path are
+// updated once per change of the chain, for the planes that changed only,
+// with no allocation per test.
+void vtkOsteotomyPlaneChain::UpdatePathProjection()
+{
+  if (this->PathProjectionTime.GetMTime() > this->GetMTime())
+    {
+    return;
+    }
+
+  // Plane 0 gives the direction of projection and the base point, so when it
+  // changes the whole path moves; otherwise only the planes that changed do
+  int numOfPlanes = this->GetNumberOfPlanes();
+  int numOfProjected = static_cast<int>(this->PathPlaneMTimes.size());
+  bool all = numOfPlanes == 0 || numOfProjected == 0 ||
+    this->PathPlaneMTimes[0] != this->PlaneMTimes[0];
+  std::vector<char> moved(numOfPlanes, 1);
+  if (!all)
+    {
+    for (int i = 0; i < numOfPlanes && i < numOfProjected; i++)
+      {
+      moved[i] = (this->PathPlaneMTimes[i] != this->PlaneMTimes[i]) ? 1 : 0;
+      }
+    }
+
+  this->PathPoints.resize(4 * numOfPlanes);
+  if (numOfPlanes > 0)
+    {
+    double up[3];
+    vtkMath::Subtract(this->GetPoint1(0), this->GetOrigin(0), up);
+    if (vtkMath::Normalize(up) == 0.0)
+      {
+      up[0] = 0.0;
+      up[1] = 0.0;
+      up[2] = 1.0;
+      }
+    double axis1[3];
+    double axis2[3];
+    vtkMath::Perpendiculars(up, axis1, axis2, 0.0);
+    double* base = this->GetOrigin(0);
+    for (int i = 0; i < numOfPlanes; i++)
+      {
+      if (!moved[i])
+        {
+        continue;
+        }
+      double* points[2] = { this->GetOrigin(i), this->GetPoint2(i) };
+      for (int k = 0; k < 2; k++)
+        {
+        double relative[3];
+        vtkMath::Subtract(points[k], base, relative);
+        this->PathPoints[4 * i + 2 * k] = vtkMath::Dot(relative, axis1);
+        this->PathPoints[4 * i + 2 * k + 1] = vtkMath::Dot(relative, axis2);
+        }
+      }
+    }
+
+  // Segments from origin s to origin s+1 with an end that moved, in order
+  std::vector<int> movedSegments;
+  for (int s = 0; s + 1 < numOfPlanes; s++)
+    {
+    if (moved[s] || moved[s + 1])
+      {
+      movedSegments.push_back(s);
+      }
+    }
+
+  // Crossings with the segments between consecutive origins, the part of
+  // the polylines of IsIntersect1() and IsIntersect2() that does not depend
+  // on the range of planes. The row of a plane that did not move changes
+  // only through the moved segments, unless its crossing was one of them.
+  const double* path = numOfPlanes > 0 ? &this->PathPoints[0] : NULL;
+  this->LastLineCrossings.resize(numOfPlanes, -1);
+  this->FirstRayCrossings.resize(numOfPlanes, numOfPlanes);
+  for (int i = 0; i < numOfPlanes; i++)
+    {
+    int& last = this->LastLineCrossings[i];
+    if (moved[i] || (last >= 1 && (moved[last] || moved[last + 1])))
+      {
+      last = FindLastLineCrossing(path, i, i - 2);
+      }
+    else
+      {
+      for (std::vector<int>::reverse_iterator it = movedSegments.rbegin();
+           it != movedSegments.rend() && *it > last; ++it)
+        {
+        if (*it >= 1 && *it <= i - 2 && LineCrosses(path, i, *it))
+          {
+          last = *it;
+          break;
+          }
+        }
+      }
+
+    // No crossing was numOfProjected, and a crossing kept from a longer path
+    // may be past the end of this one
+    int& first = this->FirstRayCrossings[i];
+    if ((i < numOfProjected && first > numOfProjected - 2) || first > numOfPlanes - 2)
+      {
+      first = numOfPlanes;
+      }
+    if (moved[i] || (first < numOfPlanes && (moved[first] || moved[first + 1])))
+      {
+      first = FindFirstRayCrossing(path, i, i + 2, numOfPlanes);
+      }
+    else
+      {
+      for (std::vector<int>::iterator it = movedSegments.begin();
+           it != movedSegments.end() && *it < first; ++it)
+        {
+        if (*it >= i + 2 && RayCrosses(path, i, *it))
+          {
+          first = *it;
+          break;
+          }
+        }
+      }
+    }
+
+  this->PathPlaneMTimes = this->PlaneMTimes;
+  this->PathProjectionTime.Modified();
+}
+
+// judge whether the plane i will intersect with the previous plane from plane m to plane i-2
+// the line segment of plane i is extended on both of the line segment directions.
+// The polyline runs from the reverse extension of plane m through the origins m+1 to i-1.
+bool vtkOsteotomyPlaneChain::IsIntersect1(int m, int i)
+{
+  if ((i-m) <= 1)
+    {
+    return false;
+    }
+  this->UpdatePathProjection();
+
+  // Segments between the origins m+1 to i-1
+  if (this->LastLineCrossings[i] >= m+1)
+    {
+    return true;
+    }
+
+  // First segment, from the reverse extension of plane m to origin m+1
+  const double* segment = &this->PathPoints[4 * i];
+  double forward[2];
+  double backward[2];
+  ExtendSegment2D(segment, forward);
+  ReverseExtendSegment2D(segment, backward);
+  double first[2];
+  ReverseExtendSegment2D(&this->PathPoints[4 * m], first);
+  const double* next = &this->PathPoints[4 * (m+1)];
+  return SegmentsIntersect2D(segment, forward, first, next) ||
+         SegmentsIntersect2D(segment, backward, first, next);
+}
+
+// judge whether the extended line segment of plane a intersects the polyline
+// through the origins a+2 to n and the extension of plane n
+bool vtkOsteotomyPlaneChain::IsIntersect2(int a, int n)
+{
+  if ((n-a) <= 1)
+    {
+    return false;
+    }
+  this->UpdatePathProjection();
+
+  // Segments between the origins a+2 to n
+  if (this->FirstRayCrossings[a] <= n-1)
+    {
+    return true;
+    }
+
+  // Last segment, from origin n to the extension of plane n
+  const double* segment = &this->PathPoints[4 * a];
+  double forward[2];
+  ExtendSegment2D(segment, forward);
+  const double* last = &this->PathPoints[4 * n];
+  double lastExtend[2];
+  ExtendSegment2D(last, lastExtend);
+  return SegmentsIntersect2D(segment, forward, last, lastExtend);
+}
+
+// If the last plane's line segment is intersected with its previous planes' line segments twice,we define the
+// first plane Of clipping model is the larger sequence number.This function checks whteher the final plane's extended
+// line segment will intersected with the line segment of plane m.
+bool vtkOsteotomyPlaneChain::IsIntersectWithTheSingleLineSegment(int m)
+{
+  int last = this->GetNumberOfPlanes()-1;
+  if (m < 0 || m >= last)
+    {
+    return false;
+    }
+  this->UpdatePathProjection();
+
+  double s1[2];
+  const double* s2;
+  if (m == 0)
+    {
+    ReverseExtendSegment2D(&this->PathPoints[0], s1);
+    s2 = &this->PathPoints[4];
+    }
+  else
+    {
+    s1[0] = this->PathPoints[4 * m];
+    s1[1] = this->PathPoints[4 * m + 1];
+    s2 = &this->PathPoints[4 * m + 2];
+    }
+
+  const double* segment = &this->PathPoints[4 * last];
+  double forward[2];
+  ExtendSegment2D(segment, forward);
+  return SegmentsIntersect2D(segment, forward, s1, s2);
+}
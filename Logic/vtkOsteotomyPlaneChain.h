@@ -0,0 +1,241 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkOsteotomyPlaneChain - GUI-free description of an osteotomy trajectory
+// .SECTION Description
+// vtkOsteotomyPlaneChain stores the quadrilateral planes of a clipping path
+// (Origin, Point1, Point2 and Point3 of every plane, in the same layout as
+// vtkQuadPlaneSource), the optional depth plane and the two reverse flags.
+// It also owns the rules that turn the chain into a clipping body: which
+// plane the body starts from, whether two planes are joined by union or
+// intersection, and where the recursion splits the chain. The intersection
+// tests run in 2D on the path projected along the walls of the planes.
+// The split planes of the ranges of planes are kept between builds, so
+// rebuilding after a plane moved only revisits the ranges that contain it.
+// vtkOsteotomyCSGProgram compiles the body from these rules.
+
+#ifndef __vtkOsteotomyPlaneChain_h
+#define __vtkOsteotomyPlaneChain_h
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkTimeStamp.h>
+
+// STD includes
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "vtkSlicerSmartModelClipModuleLogicExport.h"
+
+class vtkDoubleArray;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkOsteotomyPlaneChain :
+  public vtkObject
+{
+public:
+  static vtkOsteotomyPlaneChain *New();
+  vtkTypeMacro(vtkOsteotomyPlaneChain, vtkObject);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  /// Number of planes of the clipping path (the depth plane is not counted).
+  int GetNumberOfPlanes();
+
+  /// Append a plane to the end of the path and return its index.
+  int AddPlane(double origin[3], double point1[3], double point2[3], double point3[3]);
+
+  /// Replace the corners of plane i. Nothing is modified if the corners are unchanged.
+  void SetPlane(int i, double origin[3], double point1[3], double point2[3], double point3[3]);
+
+  /// Remove the last plane of the path.
+  void RemoveLastPlane();
+
+  /// Remove every plane and the depth plane.
+  void RemoveAllPlanes();
+
+  /// Corners of plane i. The returned pointers stay valid until planes are added or removed.
+  double* GetOrigin(int i);
+  double* GetPoint1(int i);
+  double* GetPoint2(int i);
+  double* GetPoint3(int i);
+  void SetPoint2(int i, double point2[3]);
+
+  /// Unit normal of plane i, the normalized cross product of
+  /// (Point1 - Origin) and (Point2 - Origin) as in vtkQuadPlaneSource.
+  void GetNormal(int i, double normal[3]);
+
+  /// Center of plane i, the mean of its four corners.
+  void GetCenter(int i, double center[3]);
+
+  /// Modification time of plane i: the time of the last change of its corners.
+  /// Caches keyed by plane index and this time stay valid while other planes move.
+  unsigned long GetPlaneMTime(int i);
+
+  /// Implicit plane of plane i as (a,b,c,d) with a*x+b*y+c*z+d = 0,
+  /// identical to vtkQuadPlaneWidget::GetPlane().
+  void GetPlaneCoefficients(int i, double abcd[4]);
+
+  /// Depth plane of the clipping path.
+  void SetDepthPlane(double origin[3], double point1[3], double point2[3], double point3[3]);
+  void RemoveDepthPlane();
+  vtkGetMacro(HasDepthPlane, int);
+  double* GetDepthPlaneOrigin();
+  double* GetDepthPlanePoint1();
+  double* GetDepthPlanePoint2();
+  double* GetDepthPlanePoint3();
+
+  /// Implicit plane of the depth plane. The normal is flipped when ReverseDepthPlane is on.
+  void GetDepthPlaneCoefficients(double abcd[4]);
+
+  /// Time of the last change of the depth plane coefficients.
+  vtkGetMacro(DepthPlaneMTime, unsigned long);
+
+  /// Keep the other side of the clipping path.
+  vtkSetMacro(ReverseClipping, int);
+  vtkGetMacro(ReverseClipping, int);
+  vtkBooleanMacro(ReverseClipping, int);
+
+  /// Keep the other side of the depth plane.
+  virtual void SetReverseDepthPlane(int reverse);
+  vtkGetMacro(ReverseDepthPlane, int);
+  vtkBooleanMacro(ReverseDepthPlane, int);
+
+  /// All corners packed as 12 doubles per plane: Origin, Point1, Point2, Point3.
+  vtkGetObjectMacro(Corners, vtkDoubleArray);
+
+  void DeepCopy(vtkOsteotomyPlaneChain* source);
+
+  /// Write the chain as text, one keyword per line:
+  ///   plane ox oy oz p1x p1y p1z p2x p2y p2z p3x p3y p3z   (once per plane, in order)
+  ///   depth ox oy oz p1x p1y p1z p2x p2y p2z p3x p3y p3z   (optional)
+  ///   reverseClipping 0|1
+  ///   reverseDepthPlane 0|1
+  /// Lines starting with '#' are comments. The corners are those of the clip,
+  /// after the Point2 adjustments made while the planes were placed; the
+  /// Export Plan button of the module writes them with the adjustment of the
+  /// last plane made when clipping.
+  void WriteSpecification(ostream& os);
+  bool WriteSpecification(const char* fileName);
+
+  /// Replace the chain by the one read from a specification.
+  /// Returns false, and leaves the chain unchanged, on a malformed line.
+  bool ReadSpecification(istream& is);
+  bool ReadSpecification(const char* fileName);
+
+  /// If the last plane's line segment is intersected with its previous planes' line segments
+  /// twice, the first plane of clipping is the larger sequence number. Otherwise it is plane 0.
+  /// The segments crossed by the last plane are kept: when the last plane or plane 0
+  /// changes they are tested again as the scan reaches them, otherwise only those
+  /// of the planes that moved.
+  int DetermineFirstPlaneOfClipping();
+
+  /// Judge whether the plane i is inside plane i-1 (i>=1).
+  /// Inside planes are joined by intersection, the others by union.
+  int IsPlaneInside(int i);
+
+  /// Judge whether the plane i will intersect with the previous planes from plane m to plane i-2.
+  /// The line segment of plane i is extended infinitely on both of the line segment directions.
+  bool IsIntersect1(int m, int i);
+
+  /// Judge whether the extended line segment of plane a intersects the planes from a+2 to n.
+  bool IsIntersect2(int a, int n);
+
+  /// Check whether the final plane's extended line segment intersects the line segment of plane m.
+  bool IsIntersectWithTheSingleLineSegment(int m);
+
+  /// Index i where the body of planes m..n is split into m..i-1 and i..n (n-m >= 2).
+  /// Kept until a plane of m..n changes.
+  int GetSplitPlane(int m, int n);
+
+  /// Point2 coordinates of first two planes satisfy such requirements that the line segment of
+  /// Point2 and Point3 is perpendicular with the line segment of Origin and Point1.
+  static void CalculatePoint2CoordinatesOfFirstTwoPlanes(
+    double origin[3], double point1[3], double point2[3], double newPoint2[3]);
+
+  /// Intersection point of the plane through secondLastOrigin, secondLastPoint2 and lastPoint2
+  /// (lastOrigin gives its second direction) with the line through point3 and point2.
+  static void CalIntersectionPointOfPlaneAndLine(
+    double secondLastOrigin[3], double secondLastPoint2[3],
+    double lastOrigin[3], double lastPoint2[3],
+    double point2[3], double point3[3], double intersection[3]);
+
+  /// Calculate the new Point2 of plane m (m>=2) from planes m-2 and m-1.
+  void CalIntersectionPointOfPlaneAndLine(int m, double intersection[3]);
+
+protected:
+  vtkOsteotomyPlaneChain();
+  virtual ~vtkOsteotomyPlaneChain();
+
+  /// Project the line segments (Origin to Point2) of the planes along their
+  /// walls (Point1 - Origin) into the plane of the path, and tabulate which
+  /// extended segments cross the path. Only the planes that changed since the
+  /// last update are projected and tested again: O(n) tests when one plane
+  /// moved, O(n^2) when plane 0 moved or on the first update.
+  void UpdatePathProjection();
+
+  /// Forget the split planes of the ranges holding a plane that changed
+  /// since they were decided.
+  void UpdateRanges();
+
+  vtkDoubleArray* Corners;
+
+  int HasDepthPlane;
+  double DepthPlaneCorners[12];
+
+  int ReverseClipping;
+  int ReverseDepthPlane;
+
+//BTX
+  std::vector<unsigned long> PlaneMTimes;
+
+  // Origin and Point2 of every plane in the plane of the path, 4 doubles per plane
+  std::vector<double> PathPoints;
+  // PlaneMTimes when the path was last projected
+  std::vector<unsigned long> PathPlaneMTimes;
+  // Largest s <= i-2 such that the segment of plane i, extended both ways,
+  // crosses the segment from origin s to origin s+1, or -1
+  std::vector<int> LastLineCrossings;
+  // Smallest s >= a+2 such that the segment of plane a, extended from its
+  // Origin, crosses the segment from origin s to origin s+1, or the number of planes
+  std::vector<int> FirstRayCrossings;
+
+  // Split plane of a range m..n of planes
+  std::map<std::pair<int, int>, int> Ranges;
+  // PlaneMTimes when the ranges were last checked
+  std::vector<unsigned long> RangePlaneMTimes;
+
+  // Whether the segments of planes 0..N-3 are crossed by the extension of
+  // the last plane (-1 not tested yet), the PlaneMTimes of the segments they
+  // were tested with, and the PlaneMTimes of the last plane and plane 0
+  std::vector<signed char> LastPlaneCrossings;
+  std::vector<unsigned long> LastPlaneCrossingMTimes;
+  unsigned long LastPlaneCrossingLastMTime;
+  unsigned long LastPlaneCrossingFirstMTime;
+//ETX
+  int FirstPlaneOfClipping;
+  vtkTimeStamp FirstPlaneOfClippingTime;
+  vtkTimeStamp PathProjectionTime;
+  vtkTimeStamp RangesTime;
+  unsigned long DepthPlaneMTime;
+
+private:
+  vtkOsteotomyPlaneChain(const vtkOsteotomyPlaneChain&); // Not implemented
+  void operator=(const vtkOsteotomyPlaneChain&);          // Not implemented
+};
+
+#endif
@@ -17,14 +17,38 @@
 
 // SmartModelClip Logic includes
 #include "vtkSlicerSmartModelClipLogic.h"
+#include "vtkOsteotomyClipHistory.h"
+#include "vtkOsteotomyClipProfiler.h"
+#include "vtkOsteotomyCSGProgram.h"
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyPlaneChain.h"
+
+// SmartModelClip MRML includes
+#include "vtkMRMLOsteotomyPlaneChainNode.h"
+
+// Annotations MRML includes
+#include <vtkMRMLAnnotationFiducialNode.h>
 
 // MRML includes
+#include <vtkMRMLScene.h>
 
 // VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkCollection.h>
+#include <vtkDoubleArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
 #include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkSmartPointer.h>
+#include <vtkTriangleFilter.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <vector>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkSlicerSmartModelClipLogic);
@@ -32,17 +56,455 @@ vtkStandardNewMacro(vtkSlicerSmartModelClipLogic);
 //----------------------------------------------------------------------------
 vtkSlicerSmartModelClipLogic::vtkSlicerSmartModelClipLogic()
 {
+  this->ClipHistory = vtkOsteotomyClipHistory::New();
+  this->Profiler = vtkOsteotomyClipProfiler::New();
+  this->ClipAborted = 0;
+  this->ClipProgress = 0.0;
+  // The coarse level is small enough for a preview update to stay well within
+  // an interactive frame
+  this->PreviewNumberOfCells[PreviewCoarse] = 50000;
+  this->PreviewNumberOfCells[PreviewMedium] = 250000;
+  this->PreviewAborted = 0;
+  this->PreviewModel = NULL;
+  this->PreviewModelMTime = 0;
+  this->PreviewCallback = vtkCallbackCommand::New();
+  this->PreviewCallback->SetCallback(vtkSlicerSmartModelClipLogic::PreviewProgressCallback);
+  this->PreviewCallback->SetClientData(this);
+  for (int level = 0; level < NumberOfPreviewLevels; level++)
+    {
+    this->PreviewLevels[level] = vtkPolyData::New();
+    this->PreviewClippers[level] = NULL;
+    }
+  this->CreatePreviewClippers();
+  this->PreviewLock = vtkSimpleMutexLock::New();
 }
 
 //----------------------------------------------------------------------------
 vtkSlicerSmartModelClipLogic::~vtkSlicerSmartModelClipLogic()
 {
+  for (int level = 0; level < NumberOfPreviewLevels; level++)
+    {
+    this->PreviewClippers[level]->Delete();
+    this->PreviewLevels[level]->Delete();
+    }
+  this->PreviewCallback->Delete();
+  this->PreviewLock->Delete();
+  this->ClipHistory->Delete();
+  this->Profiler->Delete();
 }
 
 //----------------------------------------------------------------------------
 void vtkSlicerSmartModelClipLogic::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Clip History:\n";
+  this->ClipHistory->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "Profiler:\n";
+  this->Profiler->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "Preview Number Of Cells: " << this->PreviewNumberOfCells[0] << " "
+     << this->PreviewNumberOfCells[1] << "\n";
+  os << indent << "Number Of Fiducials: " << this->GetNumberOfFiducials() << "\n";
+}
+
+//---------------------------------------------------------------------------
+namespace
+{
+struct ClipBatch;
+
+struct ClipBatchItem
+{
+  ClipBatch* Batch;
+  vtkSmartPointer<vtkOsteotomyClipPolyData> Clipper;
+  volatile double Progress;
+};
+
+struct ClipBatch
+{
+  vtkSlicerSmartModelClipLogic* Logic;
+  std::vector<ClipBatchItem> Items;
+  int NextItem;
+  vtkSmartPointer<vtkSimpleMutexLock> Lock;
+};
+
+//---------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE ClipBatchThreadedExecute(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ClipBatch* batch = static_cast<ClipBatch*>(info->UserData);
+  for (;;)
+    {
+    batch->Lock->Lock();
+    int item = batch->NextItem++;
+    batch->Lock->Unlock();
+    if (item >= static_cast<int>(batch->Items.size()))
+      {
+      break;
+      }
+    batch->Items[item].Clipper->Update();
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerSmartModelClipLogic::ClipModel(vtkPolyData* model, vtkOsteotomyPlaneChain* chain,
+                                             vtkPolyData* reserved, vtkPolyData* clipped)
+{
+  if (!model || !chain || chain->GetNumberOfPlanes() == 0)
+    {
+    vtkErrorMacro(<< "ClipModel: a model and a plane chain with at least one plane are required");
+    return false;
+    }
+
+  vtkNew<vtkCollection> models;
+  models->AddItem(model);
+  vtkNew<vtkCollection> reservedParts;
+  reservedParts->AddItem(reserved ? reserved : vtkSmartPointer<vtkPolyData>::New().GetPointer());
+  vtkNew<vtkCollection> clippedParts;
+  clippedParts->AddItem(clipped ? clipped : vtkSmartPointer<vtkPolyData>::New().GetPointer());
+  return this->ClipModels(models.GetPointer(), chain,
+                          reservedParts.GetPointer(), clippedParts.GetPointer());
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerSmartModelClipLogic::ClipModels(vtkCollection* models, vtkOsteotomyPlaneChain* chain,
+                                              vtkCollection* reservedParts,
+                                              vtkCollection* clippedParts)
+{
+  int numModels = models ? models->GetNumberOfItems() : 0;
+  if (numModels == 0 || !chain || chain->GetNumberOfPlanes() == 0)
+    {
+    vtkErrorMacro(<< "ClipModels: models and a plane chain with at least one plane are required");
+    return false;
+    }
+  if ((reservedParts && reservedParts->GetNumberOfItems() != numModels) ||
+      (clippedParts && clippedParts->GetNumberOfItems() != numModels))
+    {
+    vtkErrorMacro(<< "ClipModels: a reserved and a clipped part are required per model");
+    return false;
+    }
+
+  // ClipAborted is only reset by ResetAbortClip(), on the thread that starts the clip
+  this->ClipProgress = 0.0;
+
+  // Every clipper reads the same program, compiled before the threads start
+  vtkNew<vtkOsteotomyCSGProgram> program;
+  vtkOsteotomyClipProfiler::ScopedTimer compileTimer(this->Profiler, vtkOsteotomyClipProfiler::TreeBuild);
+  program->Compile(chain);
+  compileTimer.Stop();
+
+  int numCores = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  int numWorkers = std::max(1, std::min(numModels, numCores));
+
+  ClipBatch batch;
+  batch.Logic = this;
+  batch.NextItem = 0;
+  batch.Lock = vtkSmartPointer<vtkSimpleMutexLock>::New();
+  // The callbacks keep pointers to the items, so they are never reallocated
+  batch.Items.resize(numModels);
+  std::vector<vtkSmartPointer<vtkCallbackCommand> > callbacks(numModels);
+  for (int i = 0; i < numModels; i++)
+    {
+    vtkPolyData* model = vtkPolyData::SafeDownCast(models->GetItemAsObject(i));
+    if (!model)
+      {
+      vtkErrorMacro(<< "ClipModels: item " << i << " is not a poly data");
+      return false;
+      }
+    ClipBatchItem& item = batch.Items[i];
+    item.Batch = &batch;
+    item.Progress = 0.0;
+    item.Clipper = vtkSmartPointer<vtkOsteotomyClipPolyData>::New();
+    item.Clipper->SetInput(model);
+    item.Clipper->SetPlaneChain(chain);
+    item.Clipper->SetProgram(program.GetPointer());
+    item.Clipper->SetProfiler(this->Profiler);
+    item.Clipper->SetNumberOfThreads(std::max(1, numCores / numWorkers));
+
+    callbacks[i] = vtkSmartPointer<vtkCallbackCommand>::New();
+    callbacks[i]->SetCallback(vtkSlicerSmartModelClipLogic::ClipProgressCallback);
+    callbacks[i]->SetClientData(&item);
+    item.Clipper->AddObserver(vtkCommand::ProgressEvent, callbacks[i]);
+    }
+
+  if (numWorkers == 1)
+    {
+    for (int i = 0; i < numModels && !this->ClipAborted; i++)
+      {
+      batch.Items[i].Clipper->Update();
+      }
+    }
+  else
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(numWorkers);
+    threader->SetSingleMethod(ClipBatchThreadedExecute, &batch);
+    threader->SingleMethodExecute();
+    }
+
+  if (this->ClipAborted)
+    {
+    return false;
+    }
+  for (int i = 0; i < numModels; i++)
+    {
+    if (batch.Items[i].Clipper->GetAbortExecute())
+      {
+      return false;
+      }
+    }
+
+  vtkOsteotomyClipProfiler::ScopedTimer copyTimer(this->Profiler, vtkOsteotomyClipProfiler::Copy);
+  for (int i = 0; i < numModels; i++)
+    {
+    vtkOsteotomyClipPolyData* clipper = batch.Items[i].Clipper;
+    vtkPolyData* reserved =
+      reservedParts ? vtkPolyData::SafeDownCast(reservedParts->GetItemAsObject(i)) : NULL;
+    vtkPolyData* clipped =
+      clippedParts ? vtkPolyData::SafeDownCast(clippedParts->GetItemAsObject(i)) : NULL;
+    if (reserved)
+      {
+      reserved->ShallowCopy(clipper->GetReservedOutput());
+      }
+    if (clipped)
+      {
+      clipped->ShallowCopy(clipper->GetClippedOutput());
+      }
+    }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::ClipProgressCallback(vtkObject* caller,
+                                                        unsigned long vtkNotUsed(eid),
+                                                        void* clientData,
+                                                        void* vtkNotUsed(callData))
+{
+  ClipBatchItem* item = static_cast<ClipBatchItem*>(clientData);
+  vtkSlicerSmartModelClipLogic* self = item->Batch->Logic;
+  vtkAlgorithm* clipper = vtkAlgorithm::SafeDownCast(caller);
+  item->Progress = clipper->GetProgress();
+
+  // The progress of the batch is the mean of the progress of its models
+  double progress = 0.0;
+  for (size_t i = 0; i < item->Batch->Items.size(); i++)
+    {
+    progress += item->Batch->Items[i].Progress;
+    }
+  self->ClipProgress = progress / item->Batch->Items.size();
+  if (self->ClipAborted)
+    {
+    clipper->SetAbortExecute(1);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::UpdateNodeFromPlaneChain(vtkOsteotomyPlaneChain* chain,
+                                                            vtkMRMLOsteotomyPlaneChainNode* node)
+{
+  if (!chain || !node)
+    {
+    return;
+    }
+
+  int disabledModify = node->StartModify();
+  int numberOfPlanes = chain->GetNumberOfPlanes();
+  node->SetNumberOfPlanes(numberOfPlanes);
+  for (int i = 0; i < numberOfPlanes; i++)
+    {
+    node->SetPlane(i, chain->GetCorners()->GetTuple(i));
+    }
+  if (chain->GetHasDepthPlane())
+    {
+    double corners[12];
+    memcpy(corners, chain->GetDepthPlaneOrigin(), 3 * sizeof(double));
+    memcpy(corners + 3, chain->GetDepthPlanePoint1(), 3 * sizeof(double));
+    memcpy(corners + 6, chain->GetDepthPlanePoint2(), 3 * sizeof(double));
+    memcpy(corners + 9, chain->GetDepthPlanePoint3(), 3 * sizeof(double));
+    node->SetDepthPlane(corners);
+    }
+  else
+    {
+    node->RemoveDepthPlane();
+    }
+  node->SetReverseClipping(chain->GetReverseClipping());
+  node->SetReverseDepthPlane(chain->GetReverseDepthPlane());
+  node->EndModify(disabledModify);
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::UpdatePlaneChainFromNode(vtkMRMLOsteotomyPlaneChainNode* node,
+                                                            vtkOsteotomyPlaneChain* chain)
+{
+  if (!chain || !node)
+    {
+    return;
+    }
+
+  int numberOfPlanes = node->GetNumberOfPlanes();
+  while (chain->GetNumberOfPlanes() > numberOfPlanes)
+    {
+    chain->RemoveLastPlane();
+    }
+  for (int i = 0; i < numberOfPlanes; i++)
+    {
+    double* corners = node->GetPlane(i);
+    if (i < chain->GetNumberOfPlanes())
+      {
+      chain->SetPlane(i, corners, corners + 3, corners + 6, corners + 9);
+      }
+    else
+      {
+      chain->AddPlane(corners, corners + 3, corners + 6, corners + 9);
+      }
+    }
+  if (node->GetHasDepthPlane())
+    {
+    double* corners = node->GetDepthPlane();
+    chain->SetDepthPlane(corners, corners + 3, corners + 6, corners + 9);
+    }
+  else
+    {
+    chain->RemoveDepthPlane();
+    }
+  chain->SetReverseClipping(node->GetReverseClipping());
+  chain->SetReverseDepthPlane(node->GetReverseDepthPlane());
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::BuildPreviewPyramid(vtkPolyData* model)
+{
+  if (!model)
+    {
+    return;
+    }
+  this->PreviewLock->Lock();
+  this->UpdatePreviewPyramid(model);
+  this->PreviewLock->Unlock();
+}
+
+//---------------------------------------------------------------------------
+bool vtkSlicerSmartModelClipLogic::ClipPreview(vtkPolyData* model, vtkOsteotomyPlaneChain* chain,
+                                               vtkPolyData* reserved, int level)
+{
+  if (!model || !chain || chain->GetNumberOfPlanes() == 0 ||
+      level < 0 || level >= NumberOfPreviewLevels)
+    {
+    return false;
+    }
+
+  this->PreviewLock->Lock();
+  if (this->PreviewAborted)
+    {
+    this->PreviewLock->Unlock();
+    return false;
+    }
+  this->UpdatePreviewPyramid(model);
+  vtkOsteotomyClipPolyData* clipper = this->PreviewClippers[level];
+  clipper->SetPlaneChain(chain);
+  clipper->Update();
+  if (clipper->GetAbortExecute())
+    {
+    // The outputs are empty but up to date for the pipeline
+    clipper->Modified();
+    this->PreviewLock->Unlock();
+    return false;
+    }
+  if (reserved)
+    {
+    reserved->DeepCopy(clipper->GetReservedOutput());
+    }
+  this->PreviewLock->Unlock();
+  return true;
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::ReleasePreview()
+{
+  this->PreviewLock->Lock();
+  for (int level = 0; level < NumberOfPreviewLevels; level++)
+    {
+    this->PreviewLevels[level]->Initialize();
+    }
+  this->CreatePreviewClippers();
+  this->PreviewModel = NULL;
+  this->PreviewModelMTime = 0;
+  this->PreviewLock->Unlock();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::CreatePreviewClippers()
+{
+  for (int level = 0; level < NumberOfPreviewLevels; level++)
+    {
+    if (this->PreviewClippers[level])
+      {
+      this->PreviewClippers[level]->Delete();
+      }
+    this->PreviewClippers[level] = vtkOsteotomyClipPolyData::New();
+    this->PreviewClippers[level]->SetInput(this->PreviewLevels[level]);
+    this->PreviewClippers[level]->SetProfiler(this->Profiler);
+    this->PreviewClippers[level]->AddObserver(vtkCommand::ProgressEvent, this->PreviewCallback);
+    }
+  // The decimated levels are re-clipped at every move of a plane. The full
+  // level is clipped once per released position, so a cache would only keep
+  // a value per point and plane of the model alive.
+  this->PreviewClippers[PreviewCoarse]->IncrementalOn();
+  this->PreviewClippers[PreviewMedium]->IncrementalOn();
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::PreviewProgressCallback(vtkObject* caller,
+                                                           unsigned long vtkNotUsed(eid),
+                                                           void* clientData,
+                                                           void* vtkNotUsed(callData))
+{
+  vtkSlicerSmartModelClipLogic* self = static_cast<vtkSlicerSmartModelClipLogic*>(clientData);
+  if (self->PreviewAborted)
+    {
+    vtkAlgorithm::SafeDownCast(caller)->SetAbortExecute(1);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::UpdatePreviewPyramid(vtkPolyData* model)
+{
+  if (model == this->PreviewModel && model->GetMTime() == this->PreviewModelMTime)
+    {
+    return;
+    }
+
+  // The full level shares the arrays of the model; every coarser level is
+  // decimated from the next finer one, which is much cheaper than from the model.
+  // The filters read the copy, so the model itself never gets a consumer here.
+  this->PreviewLevels[PreviewFull]->ShallowCopy(model);
+  vtkPolyData* finer = this->PreviewLevels[PreviewFull];
+  for (int level = PreviewMedium; level >= PreviewCoarse; level--)
+    {
+    vtkIdType target = this->PreviewNumberOfCells[level];
+    if (finer->GetNumberOfCells() <= target)
+      {
+      this->PreviewLevels[level]->ShallowCopy(finer);
+      }
+    else
+      {
+      vtkNew<vtkTriangleFilter> triangles;
+      triangles->SetInput(finer);
+      triangles->Update();
+      vtkIdType numCells = triangles->GetOutput()->GetNumberOfCells();
+
+      vtkNew<vtkQuadricDecimation> decimation;
+      decimation->SetInputConnection(triangles->GetOutputPort());
+      decimation->SetTargetReduction(1.0 - static_cast<double>(target) / numCells);
+      decimation->Update();
+      this->PreviewLevels[level]->DeepCopy(decimation->GetOutput());
+      }
+    finer = this->PreviewLevels[level];
+    }
+
+  this->PreviewModel = model;
+  this->PreviewModelMTime = model->GetMTime();
 }
 
 //---------------------------------------------------------------------------
@@ -59,23 +521,91 @@ void vtkSlicerSmartModelClipLogic::SetMRMLSceneInternal(vtkMRMLScene * newScene)
 void vtkSlicerSmartModelClipLogic::RegisterNodes()
 {
   assert(this->GetMRMLScene() != 0);
+
+  vtkNew<vtkMRMLOsteotomyPlaneChainNode> planeChainNode;
+  this->GetMRMLScene()->RegisterNodeClass(planeChainNode.GetPointer());
 }
 
 //---------------------------------------------------------------------------
 void vtkSlicerSmartModelClipLogic::UpdateFromMRMLScene()
 {
   assert(this->GetMRMLScene() != 0);
+
+  // After a batch (import, close, restore) rebuild the list from the scene,
+  // which keeps its nodes in the order they were added
+  this->Fiducials.clear();
+  std::vector<vtkMRMLNode*> nodes;
+  this->GetMRMLScene()->GetNodesByClass("vtkMRMLAnnotationFiducialNode", nodes);
+  for (size_t i = 0; i < nodes.size(); i++)
+    {
+    this->Fiducials.push_back(vtkMRMLAnnotationFiducialNode::SafeDownCast(nodes[i]));
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::OnMRMLSceneNodeAdded(vtkMRMLNode* node)
+{
+  vtkMRMLAnnotationFiducialNode* fiducial = vtkMRMLAnnotationFiducialNode::SafeDownCast(node);
+  if (fiducial)
+    {
+    this->Fiducials.push_back(fiducial);
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::OnMRMLSceneNodeRemoved(vtkMRMLNode* node)
+{
+  vtkMRMLAnnotationFiducialNode* fiducial = vtkMRMLAnnotationFiducialNode::SafeDownCast(node);
+  if (!fiducial)
+    {
+    return;
+    }
+  // Fiducials are mostly removed from the end
+  for (size_t i = this->Fiducials.size(); i-- > 0;)
+    {
+    if (this->Fiducials[i].GetPointer() == fiducial)
+      {
+      this->Fiducials.erase(this->Fiducials.begin() + i);
+      break;
+      }
+    }
+}
+
+//---------------------------------------------------------------------------
+void vtkSlicerSmartModelClipLogic::PruneFiducials()
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < this->Fiducials.size(); i++)
+    {
+    if (this->Fiducials[i].GetPointer())
+      {
+      this->Fiducials[kept++] = this->Fiducials[i];
+      }
+    }
+  this->Fiducials.resize(kept);
+}
+
+//---------------------------------------------------------------------------
+int vtkSlicerSmartModelClipLogic::GetNumberOfFiducials()
+{
+  this->PruneFiducials();
+  return static_cast<int>(this->Fiducials.size());
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerSmartModelClipLogic
-::OnMRMLSceneNodeAdded(vtkMRMLNode* vtkNotUsed(node))
+vtkMRMLAnnotationFiducialNode* vtkSlicerSmartModelClipLogic::GetNthFiducial(int index)
 {
+  if (index < 0 || index >= this->GetNumberOfFiducials())
+    {
+    return NULL;
+    }
+  return this->Fiducials[index].GetPointer();
 }
 
 //---------------------------------------------------------------------------
-void vtkSlicerSmartModelClipLogic
-::OnMRMLSceneNodeRemoved(vtkMRMLNode* vtkNotUsed(node))
+double* vtkSlicerSmartModelClipLogic::GetFiducialPosition(int index)
 {
+  vtkMRMLAnnotationFiducialNode* fiducial = this->GetNthFiducial(index);
+  return fiducial ? fiducial->GetFiducialCoordinates() : NULL;
 }
 
@@ -29,11 +29,25 @@
 
 // MRML includes
 
+// VTK includes
+#include <vtkWeakPointer.h>
+
 // STD includes
 #include <cstdlib>
+#include <vector>
 
 #include "vtkSlicerSmartModelClipModuleLogicExport.h"
 
+class vtkCallbackCommand;
+class vtkCollection;
+class vtkMRMLAnnotationFiducialNode;
+class vtkMRMLOsteotomyPlaneChainNode;
+class vtkOsteotomyClipHistory;
+class vtkOsteotomyClipProfiler;
+class vtkOsteotomyClipPolyData;
+class vtkOsteotomyPlaneChain;
+class vtkPolyData;
+class vtkSimpleMutexLock;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
 class VTK_SLICER_SMARTMODELCLIP_MODULE_LOGIC_EXPORT vtkSlicerSmartModelClipLogic :
@@ -45,6 +59,108 @@ public:
   vtkTypeMacro(vtkSlicerSmartModelClipLogic, vtkSlicerModuleLogic);
   void PrintSelf(ostream& os, vtkIndent indent);
 
+  /// Clip the model with the clipping body of the plane chain.
+  /// The reserved and clipped parts are shallow copied into the two output
+  /// poly data, and the model is not copied, so the peak memory is the model
+  /// and the two parts.
+  /// Returns false if the chain has no plane or the model cannot be clipped,
+  /// or if the clip was aborted.
+  bool ClipModel(vtkPolyData* model, vtkOsteotomyPlaneChain* chain,
+                 vtkPolyData* reserved, vtkPolyData* clipped);
+
+  /// Clip every vtkPolyData of the models collection with the same plane chain.
+  /// The chain is compiled once, and the models are clipped concurrently, each
+  /// by its own clipper sharing the compiled program, on a pool of threads.
+  /// The threads of each clipper are scaled down so that the pool does not
+  /// use more threads than there are cores.
+  /// The parts of model i are shallow copied into item i of reservedParts and
+  /// clippedParts, which must hold a vtkPolyData per model or be NULL.
+  /// Returns false, and leaves the parts unchanged, if a model cannot be
+  /// clipped or if the clip was aborted.
+  bool ClipModels(vtkCollection* models, vtkOsteotomyPlaneChain* chain,
+                  vtkCollection* reservedParts, vtkCollection* clippedParts);
+
+  /// Stop the running ClipModel() or ClipModels() at the next chunk of cells,
+  /// and every later one until ResetAbortClip() is called. May be called from
+  /// any thread while the clip runs on another one.
+  void AbortClip() { this->ClipAborted = 1; }
+
+  /// Allow clips again and clear the progress. Called by the thread that
+  /// starts the clip, before it starts, so that an abort sent between the
+  /// start and the first chunk is not lost.
+  void ResetAbortClip() { this->ClipAborted = 0; this->ClipProgress = 0.0; }
+
+  /// Fraction of the running or last clip done, readable from any thread.
+  double GetClipProgress() { return this->ClipProgress; }
+
+  /// Store the chain in an osteotomy plan node, in a single modification of the node.
+  void UpdateNodeFromPlaneChain(vtkOsteotomyPlaneChain* chain, vtkMRMLOsteotomyPlaneChainNode* node);
+
+  /// Replace the chain by the plan of the node. Planes whose corners did not
+  /// change keep their modification time.
+  void UpdatePlaneChainFromNode(vtkMRMLOsteotomyPlaneChainNode* node, vtkOsteotomyPlaneChain* chain);
+
+  /// Results of the clips of the session, kept within a memory budget.
+  /// GetInMemorySize() and GetCompressedSize() of the history give the
+  /// memory used by the results.
+  vtkGetObjectMacro(ClipHistory, vtkOsteotomyClipHistory);
+
+  /// Durations of the stages of the clips and previews of the session. The
+  /// module widget adds the creation and display of the result nodes.
+  vtkGetObjectMacro(Profiler, vtkOsteotomyClipProfiler);
+
+  /// Levels of detail of the preview pyramid, from the coarsest
+  enum
+  {
+    PreviewCoarse = 0,
+    PreviewMedium,
+    PreviewFull,
+    NumberOfPreviewLevels
+  };
+
+  /// Build the levels of detail of the model used by ClipPreview(): quadric
+  /// decimations to PreviewNumberOfCells and the model itself. Nothing is done
+  /// if the pyramid was built from the same model and the model did not change.
+  /// May run on a worker thread; calls of the preview methods are serialized.
+  void BuildPreviewPyramid(vtkPolyData* model);
+
+  /// Clip one level of the preview pyramid of the model, building the pyramid
+  /// first if needed. The decimated levels keep their own clipper between
+  /// calls, so a moved plane is re-clipped incrementally. May run on a worker
+  /// thread as long as the model and the chain are not modified meanwhile.
+  /// Returns false if the preview was aborted.
+  bool ClipPreview(vtkPolyData* model, vtkOsteotomyPlaneChain* chain, vtkPolyData* reserved,
+                   int level = PreviewCoarse);
+
+  /// Stop the running ClipPreview() at the next chunk of cells, and every
+  /// later one until ResetAbortPreview() is called. May be called from any
+  /// thread while the preview runs on another one.
+  void AbortPreview() { this->PreviewAborted = 1; }
+
+  /// Allow previews again. Called by the thread that starts the preview,
+  /// before it starts, so that an abort sent meanwhile is not lost.
+  void ResetAbortPreview() { this->PreviewAborted = 0; }
+
+  /// Free the levels of the pyramid and the caches of their clippers once the
+  /// running preview ends; call AbortPreview() first so that it ends soon.
+  /// The abort flag is left as it is, so a preview started meanwhile is not
+  /// aborted. The next preview builds the pyramid again.
+  void ReleasePreview();
+
+  /// Target number of cells of the coarse and medium levels.
+  vtkSetVector2Macro(PreviewNumberOfCells, vtkIdType);
+  vtkGetVector2Macro(PreviewNumberOfCells, vtkIdType);
+
+  /// Annotation fiducials of the scene in the order they were added. The list
+  /// is kept up to date from the node added and removed events of the scene,
+  /// so getting a fiducial by index does not search the scene. Nodes deleted
+  /// without a removed event are dropped from the list before it is read.
+  int GetNumberOfFiducials();
+  vtkMRMLAnnotationFiducialNode* GetNthFiducial(int index);
+  /// Coordinates of the fiducial at index, NULL if there is none. The returned
+  /// pointer belongs to the fiducial node.
+  double* GetFiducialPosition(int index);
+
 protected:
   vtkSlicerSmartModelClipLogic();
   virtual ~vtkSlicerSmartModelClipLogic();
@@ -55,6 +171,40 @@ protected:
   virtual void UpdateFromMRMLScene();
   virtual void OnMRMLSceneNodeAdded(vtkMRMLNode* node);
   virtual void OnMRMLSceneNodeRemoved(vtkMRMLNode* node);
+
+  void UpdatePreviewPyramid(vtkPolyData* model);
+  /// Drop the fiducials deleted without a node removed event
+  void PruneFiducials();
+
+  static void ClipProgressCallback(vtkObject* caller, unsigned long eid,
+                                   void* clientData, void* callData);
+  static void PreviewProgressCallback(vtkObject* caller, unsigned long eid,
+                                      void* clientData, void* callData);
+
+  /// Replace the clippers of the preview levels by new ones with empty caches
+  void CreatePreviewClippers();
+
+  vtkOsteotomyClipHistory* ClipHistory;
+  vtkOsteotomyClipProfiler* Profiler;
+
+  volatile int ClipAborted;
+  volatile double ClipProgress;
+
+  volatile int PreviewAborted;
+  vtkIdType PreviewNumberOfCells[2];
+  vtkPolyData* PreviewModel; // not referenced, only compared
+  unsigned long PreviewModelMTime;
+  vtkPolyData* PreviewLevels[NumberOfPreviewLevels];
+  vtkOsteotomyClipPolyData* PreviewClippers[NumberOfPreviewLevels];
+  vtkCallbackCommand* PreviewCallback;
+  vtkSimpleMutexLock* PreviewLock;
+
+//BTX
+  // Weak so a node deleted without a removed event (scene closed) becomes
+  // NULL instead of dangling; PruneFiducials() drops it
+  std::vector<vtkWeakPointer<vtkMRMLAnnotationFiducialNode> > Fiducials;
+//ETX
+
 private:
 
   vtkSlicerSmartModelClipLogic(const vtkSlicerSmartModelClipLogic&); // Not implemented
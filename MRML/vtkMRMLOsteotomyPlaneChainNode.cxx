@@ -0,0 +1,251 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip MRML includes
+#include "vtkMRMLOsteotomyPlaneChainNode.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cstdlib>
+#include <cstring>
+#include <locale>
+#include <sstream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+vtkMRMLNodeNewMacro(vtkMRMLOsteotomyPlaneChainNode);
+
+//----------------------------------------------------------------------------
+vtkMRMLOsteotomyPlaneChainNode::vtkMRMLOsteotomyPlaneChainNode()
+{
+  this->Corners = vtkDoubleArray::New();
+  this->Corners->SetNumberOfComponents(12);
+  this->HasDepthPlane = 0;
+  memset(this->DepthPlane, 0, sizeof(this->DepthPlane));
+  this->ReverseClipping = 0;
+  this->ReverseDepthPlane = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkMRMLOsteotomyPlaneChainNode::~vtkMRMLOsteotomyPlaneChainNode()
+{
+  this->Corners->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number Of Planes: " << this->GetNumberOfPlanes() << "\n";
+  os << indent << "Has Depth Plane: " << this->HasDepthPlane << "\n";
+  os << indent << "Reverse Clipping: " << this->ReverseClipping << "\n";
+  os << indent << "Reverse Depth Plane: " << this->ReverseDepthPlane << "\n";
+}
+
+//----------------------------------------------------------------------------
+namespace
+{
+void WriteValues(ostream& of, const double* values, vtkIdType n)
+{
+  for (vtkIdType i = 0; i < n; i++)
+    {
+    of << (i ? " " : "") << values[i];
+    }
+}
+
+// One stream over the whole attribute, far cheaper than a stream per value.
+// It reads in the classic locale: strtod would follow the C locale of the
+// application, where the decimal separator may be a comma.
+void ReadValues(const char* text, std::vector<double>& values)
+{
+  values.clear();
+  std::istringstream is(text);
+  is.imbue(std::locale::classic());
+  double value;
+  while (is >> value)
+    {
+    values.push_back(value);
+    }
+}
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::WriteXML(ostream& of, int nIndent)
+{
+  this->Superclass::WriteXML(of, nIndent);
+
+  vtkIndent indent(nIndent);
+  // Written in the classic locale, as read by ReadValues()
+  std::streamsize precision = of.precision(17);
+  std::locale locale = of.imbue(std::locale::classic());
+  of << indent << " planes=\"";
+  WriteValues(of, this->Corners->GetPointer(0), 12 * this->Corners->GetNumberOfTuples());
+  of << "\"";
+  of << indent << " hasDepthPlane=\"" << this->HasDepthPlane << "\"";
+  if (this->HasDepthPlane)
+    {
+    of << indent << " depthPlane=\"";
+    WriteValues(of, this->DepthPlane, 12);
+    of << "\"";
+    }
+  of << indent << " reverseClipping=\"" << this->ReverseClipping << "\"";
+  of << indent << " reverseDepthPlane=\"" << this->ReverseDepthPlane << "\"";
+  of.precision(precision);
+  of.imbue(locale);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::ReadXMLAttributes(const char** atts)
+{
+  int disabledModify = this->StartModify();
+  this->Superclass::ReadXMLAttributes(atts);
+
+  std::vector<double> values;
+  const char* attName;
+  const char* attValue;
+  while (*atts != NULL)
+    {
+    attName = *(atts++);
+    attValue = *(atts++);
+    if (!strcmp(attName, "planes"))
+      {
+      ReadValues(attValue, values);
+      vtkIdType numberOfPlanes = static_cast<vtkIdType>(values.size() / 12);
+      this->Corners->SetNumberOfTuples(numberOfPlanes);
+      if (numberOfPlanes > 0)
+        {
+        memcpy(this->Corners->GetPointer(0), &values[0], 12 * numberOfPlanes * sizeof(double));
+        }
+      }
+    else if (!strcmp(attName, "hasDepthPlane"))
+      {
+      this->HasDepthPlane = atoi(attValue) ? 1 : 0;
+      }
+    else if (!strcmp(attName, "depthPlane"))
+      {
+      ReadValues(attValue, values);
+      if (values.size() == 12)
+        {
+        memcpy(this->DepthPlane, &values[0], sizeof(this->DepthPlane));
+        }
+      }
+    else if (!strcmp(attName, "reverseClipping"))
+      {
+      this->ReverseClipping = atoi(attValue) ? 1 : 0;
+      }
+    else if (!strcmp(attName, "reverseDepthPlane"))
+      {
+      this->ReverseDepthPlane = atoi(attValue) ? 1 : 0;
+      }
+    }
+
+  this->Modified();
+  this->EndModify(disabledModify);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::Copy(vtkMRMLNode* anode)
+{
+  int disabledModify = this->StartModify();
+  this->Superclass::Copy(anode);
+
+  vtkMRMLOsteotomyPlaneChainNode* node = vtkMRMLOsteotomyPlaneChainNode::SafeDownCast(anode);
+  if (node)
+    {
+    this->Corners->DeepCopy(node->Corners);
+    this->HasDepthPlane = node->HasDepthPlane;
+    memcpy(this->DepthPlane, node->DepthPlane, sizeof(this->DepthPlane));
+    this->ReverseClipping = node->ReverseClipping;
+    this->ReverseDepthPlane = node->ReverseDepthPlane;
+    this->Modified();
+    }
+
+  this->EndModify(disabledModify);
+}
+
+//----------------------------------------------------------------------------
+int vtkMRMLOsteotomyPlaneChainNode::GetNumberOfPlanes()
+{
+  return static_cast<int>(this->Corners->GetNumberOfTuples());
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::SetNumberOfPlanes(int numberOfPlanes)
+{
+  vtkIdType previous = this->Corners->GetNumberOfTuples();
+  if (numberOfPlanes < 0 || numberOfPlanes == previous)
+    {
+    return;
+    }
+  this->Corners->SetNumberOfTuples(numberOfPlanes);
+  if (numberOfPlanes > previous)
+    {
+    memset(this->Corners->GetPointer(12 * previous), 0,
+           12 * (numberOfPlanes - previous) * sizeof(double));
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+double* vtkMRMLOsteotomyPlaneChainNode::GetPlane(int i)
+{
+  if (i < 0 || i >= this->GetNumberOfPlanes())
+    {
+    return NULL;
+    }
+  return this->Corners->GetPointer(12 * i);
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::SetPlane(int i, const double corners[12])
+{
+  double* plane = this->GetPlane(i);
+  if (!plane || !memcmp(plane, corners, 12 * sizeof(double)))
+    {
+    return;
+    }
+  memcpy(plane, corners, 12 * sizeof(double));
+  this->Corners->Modified();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::SetDepthPlane(const double corners[12])
+{
+  if (this->HasDepthPlane && !memcmp(this->DepthPlane, corners, sizeof(this->DepthPlane)))
+    {
+    return;
+    }
+  memcpy(this->DepthPlane, corners, sizeof(this->DepthPlane));
+  this->HasDepthPlane = 1;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMRMLOsteotomyPlaneChainNode::RemoveDepthPlane()
+{
+  if (!this->HasDepthPlane)
+    {
+    return;
+    }
+  this->HasDepthPlane = 0;
+  this->Modified();
+}
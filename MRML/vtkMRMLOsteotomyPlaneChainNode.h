@@ -0,0 +1,98 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// .NAME vtkMRMLOsteotomyPlaneChainNode - osteotomy plan saved with the scene
+// .SECTION Description
+// vtkMRMLOsteotomyPlaneChainNode stores a clipping path: the corners of its
+// planes (Origin, Point1, Point2 and Point3, 12 doubles per plane, in a single
+// contiguous array), the optional depth plane and the two reverse flags.
+// It is written to the scene file as plain attributes, so a plan is read back
+// without creating any widget. vtkSlicerSmartModelClipLogic converts it to and
+// from a vtkOsteotomyPlaneChain.
+
+#ifndef __vtkMRMLOsteotomyPlaneChainNode_h
+#define __vtkMRMLOsteotomyPlaneChainNode_h
+
+// MRML includes
+#include <vtkMRMLNode.h>
+
+#include "vtkSlicerSmartModelClipModuleMRMLExport.h"
+
+class vtkDoubleArray;
+
+/// \ingroup Slicer_QtModules_ExtensionTemplate
+class VTK_SLICER_SMARTMODELCLIP_MODULE_MRML_EXPORT vtkMRMLOsteotomyPlaneChainNode :
+  public vtkMRMLNode
+{
+public:
+  static vtkMRMLOsteotomyPlaneChainNode *New();
+  vtkTypeMacro(vtkMRMLOsteotomyPlaneChainNode, vtkMRMLNode);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  virtual vtkMRMLNode* CreateNodeInstance();
+  virtual void ReadXMLAttributes(const char** atts);
+  virtual void WriteXML(ostream& of, int indent);
+  virtual void Copy(vtkMRMLNode* node);
+  virtual const char* GetNodeTagName() { return "OsteotomyPlaneChain"; }
+
+  /// Number of planes of the clipping path (the depth plane is not counted).
+  /// Added planes are zero until set.
+  int GetNumberOfPlanes();
+  void SetNumberOfPlanes(int numberOfPlanes);
+
+  /// Corners of plane i as Origin, Point1, Point2 and Point3.
+  /// The returned pointer stays valid until the number of planes changes.
+  double* GetPlane(int i);
+  void SetPlane(int i, const double corners[12]);
+
+  /// All corners packed as 12 doubles per plane.
+  vtkGetObjectMacro(Corners, vtkDoubleArray);
+
+  /// Corners of the depth plane.
+  void SetDepthPlane(const double corners[12]);
+  void RemoveDepthPlane();
+  vtkGetMacro(HasDepthPlane, int);
+  vtkGetVectorMacro(DepthPlane, double, 12);
+
+  /// Keep the other side of the clipping path.
+  vtkSetMacro(ReverseClipping, int);
+  vtkGetMacro(ReverseClipping, int);
+  vtkBooleanMacro(ReverseClipping, int);
+
+  /// Keep the other side of the depth plane.
+  vtkSetMacro(ReverseDepthPlane, int);
+  vtkGetMacro(ReverseDepthPlane, int);
+  vtkBooleanMacro(ReverseDepthPlane, int);
+
+protected:
+  vtkMRMLOsteotomyPlaneChainNode();
+  virtual ~vtkMRMLOsteotomyPlaneChainNode();
+
+  vtkDoubleArray* Corners;
+
+  int HasDepthPlane;
+  double DepthPlane[12];
+
+  int ReverseClipping;
+  int ReverseDepthPlane;
+
+private:
+  vtkMRMLOsteotomyPlaneChainNode(const vtkMRMLOsteotomyPlaneChainNode&); // Not implemented
+  void operator=(const vtkMRMLOsteotomyPlaneChainNode&);                 // Not implemented
+};
+
+#endif
@@ -0,0 +1,325 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyPlaneChain.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkPLYReader.h>
+#include <vtkPLYWriter.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkPolyDataReader.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkSTLReader.h>
+#include <vtkSTLWriter.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLPolyDataReader.h>
+#include <vtkXMLPolyDataWriter.h>
+#include <vtksys/SystemTools.hxx>
+
+// STD includes
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SmartModelClipBatchCLP.h"
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct ClipCase
+{
+  std::string InputModel;
+  std::string PlaneChain;
+  std::string ReservedModel;
+  std::string ClippedModel;
+  std::string Error; // empty once clipped
+};
+
+//----------------------------------------------------------------------------
+struct ClipCaseQueue
+{
+  std::vector<ClipCase>* Cases;
+  int NextCase;
+  int NumberOfThreads; // threads of each clipper
+  int ClipMode;
+  vtkSmartPointer<vtkSimpleMutexLock> Lock;
+};
+
+//----------------------------------------------------------------------------
+std::string GetExtension(const std::string& fileName)
+{
+  return vtksys::SystemTools::LowerCase(
+    vtksys::SystemTools::GetFilenameLastExtension(fileName));
+}
+
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPolyData> ReadModel(const std::string& fileName)
+{
+  std::string extension = GetExtension(fileName);
+  vtkSmartPointer<vtkPolyDataAlgorithm> reader;
+  if (extension == ".stl")
+    {
+    vtkSmartPointer<vtkSTLReader> stlReader = vtkSmartPointer<vtkSTLReader>::New();
+    stlReader->SetFileName(fileName.c_str());
+    reader = stlReader;
+    }
+  else if (extension == ".ply")
+    {
+    vtkSmartPointer<vtkPLYReader> plyReader = vtkSmartPointer<vtkPLYReader>::New();
+    plyReader->SetFileName(fileName.c_str());
+    reader = plyReader;
+    }
+  else if (extension == ".vtp")
+    {
+    vtkSmartPointer<vtkXMLPolyDataReader> xmlReader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+    xmlReader->SetFileName(fileName.c_str());
+    reader = xmlReader;
+    }
+  else if (extension == ".vtk")
+    {
+    vtkSmartPointer<vtkPolyDataReader> vtkReader = vtkSmartPointer<vtkPolyDataReader>::New();
+    vtkReader->SetFileName(fileName.c_str());
+    reader = vtkReader;
+    }
+  else
+    {
+    return NULL;
+    }
+  reader->Update();
+
+  vtkSmartPointer<vtkPolyData> model = reader->GetOutput();
+  if (!model || model->GetNumberOfPoints() == 0)
+    {
+    return NULL;
+    }
+  return model;
+}
+
+//----------------------------------------------------------------------------
+bool WriteModel(vtkPolyData* model, const std::string& fileName)
+{
+  std::string extension = GetExtension(fileName);
+  if (extension == ".stl")
+    {
+    vtkSmartPointer<vtkSTLWriter> writer = vtkSmartPointer<vtkSTLWriter>::New();
+    writer->SetInput(model);
+    writer->SetFileName(fileName.c_str());
+    writer->SetFileTypeToBinary();
+    return writer->Write() != 0;
+    }
+  else if (extension == ".ply")
+    {
+    vtkSmartPointer<vtkPLYWriter> writer = vtkSmartPointer<vtkPLYWriter>::New();
+    writer->SetInput(model);
+    writer->SetFileName(fileName.c_str());
+    writer->SetFileTypeToBinary();
+    return writer->Write() != 0;
+    }
+  else if (extension == ".vtp")
+    {
+    vtkSmartPointer<vtkXMLPolyDataWriter> writer = vtkSmartPointer<vtkXMLPolyDataWriter>::New();
+    writer->SetInput(model);
+    writer->SetFileName(fileName.c_str());
+    return writer->Write() != 0;
+    }
+  else if (extension == ".vtk")
+    {
+    vtkSmartPointer<vtkPolyDataWriter> writer = vtkSmartPointer<vtkPolyDataWriter>::New();
+    writer->SetInput(model);
+    writer->SetFileName(fileName.c_str());
+    writer->SetFileTypeToBinary();
+    return writer->Write() != 0;
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+// Clip a case with the clipper of the module, so that the first plane of
+// clipping and the union or intersection of the planes are decided by the
+// plane chain exactly as in the module
+void RunClipCase(ClipCase& clipCase, int numberOfThreads, int clipMode)
+{
+  vtkSmartPointer<vtkPolyData> model = ReadModel(clipCase.InputModel);
+  if (!model)
+    {
+    clipCase.Error = "cannot read model " + clipCase.InputModel;
+    return;
+    }
+  vtkSmartPointer<vtkOsteotomyPlaneChain> chain = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+  if (!chain->ReadSpecification(clipCase.PlaneChain.c_str()) || chain->GetNumberOfPlanes() == 0)
+    {
+    clipCase.Error = "cannot read plane chain " + clipCase.PlaneChain;
+    return;
+    }
+
+  vtkSmartPointer<vtkOsteotomyClipPolyData> clipper = vtkSmartPointer<vtkOsteotomyClipPolyData>::New();
+  clipper->SetInput(model);
+  clipper->SetPlaneChain(chain);
+  clipper->SetNumberOfThreads(numberOfThreads);
+  clipper->SetClipMode(clipMode);
+  clipper->Update();
+
+  // Every cell of a model ends in one part or the other, so two empty parts
+  // of a model with cells mean that the clip failed
+  vtkIdType numberOfClippedCells = clipper->GetReservedOutput()->GetNumberOfCells() +
+    clipper->GetClippedOutput()->GetNumberOfCells();
+  if (clipper->GetErrorCode() != 0 ||
+      (model->GetNumberOfCells() > 0 && numberOfClippedCells == 0))
+    {
+    clipCase.Error = "cannot clip " + clipCase.InputModel + " by " + clipCase.PlaneChain;
+    return;
+    }
+
+  if (!clipCase.ReservedModel.empty() &&
+      !WriteModel(clipper->GetReservedOutput(), clipCase.ReservedModel))
+    {
+    clipCase.Error = "cannot write " + clipCase.ReservedModel;
+    return;
+    }
+  if (!clipCase.ClippedModel.empty() &&
+      !WriteModel(clipper->GetClippedOutput(), clipCase.ClippedModel))
+    {
+    clipCase.Error = "cannot write " + clipCase.ClippedModel;
+    return;
+    }
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE ClipCasesThreadedExecute(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* info = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  ClipCaseQueue* queue = static_cast<ClipCaseQueue*>(info->UserData);
+  for (;;)
+    {
+    queue->Lock->Lock();
+    int caseId = queue->NextCase++;
+    queue->Lock->Unlock();
+    if (caseId >= static_cast<int>(queue->Cases->size()))
+      {
+      break;
+      }
+    RunClipCase((*queue->Cases)[caseId], queue->NumberOfThreads, queue->ClipMode);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+bool ReadCaseList(const std::string& fileName, std::vector<ClipCase>& cases)
+{
+  std::ifstream is(fileName.c_str());
+  if (!is)
+    {
+    std::cerr << "Cannot open case list " << fileName << std::endl;
+    return false;
+    }
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(is, line))
+    {
+    lineNumber++;
+    std::istringstream fields(line);
+    ClipCase clipCase;
+    if (!(fields >> clipCase.InputModel) || clipCase.InputModel[0] == '#')
+      {
+      continue;
+      }
+    if (!(fields >> clipCase.PlaneChain >> clipCase.ReservedModel >> clipCase.ClippedModel))
+      {
+      std::cerr << "Case list line " << lineNumber
+                << ": expected input model, plane chain, reserved model and clipped model" << std::endl;
+      return false;
+      }
+    cases.push_back(clipCase);
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  PARSE_ARGS;
+
+  std::vector<ClipCase> cases;
+  if (!inputModel.empty())
+    {
+    ClipCase clipCase;
+    clipCase.InputModel = inputModel;
+    clipCase.PlaneChain = planeChain;
+    clipCase.ReservedModel = reservedModel;
+    clipCase.ClippedModel = clippedModel;
+    cases.push_back(clipCase);
+    }
+  if (!caseList.empty() && !ReadCaseList(caseList, cases))
+    {
+    return EXIT_FAILURE;
+    }
+  if (cases.empty())
+    {
+    std::cerr << "Nothing to clip: give an input model and a plane chain, or a case list" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Cases are taken one at a time by the jobs, and the cores are shared
+  // between the clippers of the cases running at the same time
+  int numberOfCores = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  int jobs = (numberOfJobs > 0) ? numberOfJobs : numberOfCores;
+  jobs = std::max(1, std::min(jobs, static_cast<int>(cases.size())));
+
+  ClipCaseQueue queue;
+  queue.Cases = &cases;
+  queue.NextCase = 0;
+  queue.NumberOfThreads = std::max(1, numberOfCores / jobs);
+  queue.ClipMode = (clipMode == "Exact") ?
+    vtkOsteotomyClipPolyData::ClipModeExact : vtkOsteotomyClipPolyData::ClipModeScalars;
+  queue.Lock = vtkSmartPointer<vtkSimpleMutexLock>::New();
+  if (jobs == 1)
+    {
+    vtkMultiThreader::ThreadInfo info;
+    info.UserData = &queue;
+    ClipCasesThreadedExecute(&info);
+    }
+  else
+    {
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    threader->SetNumberOfThreads(jobs);
+    threader->SetSingleMethod(ClipCasesThreadedExecute, &queue);
+    threader->SingleMethodExecute();
+    }
+
+  int numberOfFailures = 0;
+  for (size_t i = 0; i < cases.size(); i++)
+    {
+    if (!cases[i].Error.empty())
+      {
+      std::cerr << cases[i].InputModel << ": " << cases[i].Error << std::endl;
+      numberOfFailures++;
+      }
+    }
+  std::cout << cases.size() - numberOfFailures << " of " << cases.size() << " cases clipped" << std::endl;
+  return numberOfFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
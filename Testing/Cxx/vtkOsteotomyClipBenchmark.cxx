@@ -0,0 +1,273 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Benchmark of the clip pipeline on synthetic meshes and plane chains.
+// Every mesh is clipped by every chain and the build of the cell blocks, the
+// build of the clipping program, the evaluation of the clipping function at
+// the points and the clip are timed separately. Every run clips the mesh as
+// if it had just been loaded, cell blocks included. Only the timings are
+// measured: the clip outputs are checked by the tests. Needs no display.
+//
+//   vtkOsteotomyClipBenchmark [--min-triangles N] [--max-triangles N]
+//                             [--max-planes N] [--repeat N] [--threads N]
+//                             [--csv file] [--trace file]
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyCellBlocks.h"
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyClipProfiler.h"
+#include "vtkOsteotomyCSGProgram.h"
+#include "vtkOsteotomyPlaneChain.h"
+#include "vtkOsteotomyTestingUtilities.h"
+
+// VTK includes
+#include <vtkDoubleArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace vtkOsteotomyTestingUtilities;
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+struct BenchmarkOptions
+{
+  vtkIdType MinimumNumberOfTriangles;
+  vtkIdType MaximumNumberOfTriangles;
+  int MaximumNumberOfPlanes;
+  int Repeat;
+  int NumberOfThreads;
+  std::string CSVFileName;
+  std::string TraceFileName;
+};
+
+//----------------------------------------------------------------------------
+void PrintUsage(const char* program)
+{
+  std::cout << "Usage: " << program << " [options]\n"
+            << "  --min-triangles N  smallest mesh (default 10000)\n"
+            << "  --max-triangles N  largest mesh (default 10000000)\n"
+            << "  --max-planes N     longest plane chain (default 200)\n"
+            << "  --repeat N         runs per measure, the fastest is kept (default 3)\n"
+            << "  --threads N        threads of the clipper (default: all cores)\n"
+            << "  --csv file         also write the results as comma separated values\n"
+            << "  --trace file       write the stages of the clips as a Chrome trace\n";
+}
+
+//----------------------------------------------------------------------------
+bool ParseArguments(int argc, char* argv[], BenchmarkOptions& options)
+{
+  options.MinimumNumberOfTriangles = 10000;
+  options.MaximumNumberOfTriangles = 10000000;
+  options.MaximumNumberOfPlanes = 200;
+  options.Repeat = 3;
+  options.NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  for (int i = 1; i < argc; i++)
+    {
+    std::string argument = argv[i];
+    if (argument == "--help" || argument == "-h" || i + 1 >= argc)
+      {
+      return false;
+      }
+    const char* value = argv[++i];
+    if (argument == "--min-triangles")
+      {
+      options.MinimumNumberOfTriangles = atol(value);
+      }
+    else if (argument == "--max-triangles")
+      {
+      options.MaximumNumberOfTriangles = atol(value);
+      }
+    else if (argument == "--max-planes")
+      {
+      options.MaximumNumberOfPlanes = atoi(value);
+      }
+    else if (argument == "--repeat")
+      {
+      options.Repeat = std::max(1, atoi(value));
+      }
+    else if (argument == "--threads")
+      {
+      options.NumberOfThreads = std::max(1, atoi(value));
+      }
+    else if (argument == "--csv")
+      {
+      options.CSVFileName = value;
+      }
+    else if (argument == "--trace")
+      {
+      options.TraceFileName = value;
+      }
+    else
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  BenchmarkOptions options;
+  if (!ParseArguments(argc, argv, options))
+    {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+    }
+
+  const vtkIdType meshSizes[] = { 10000, 100000, 1000000, 10000000 };
+  const int chainSizes[] = { 1, 2, 5, 10, 20, 50, 100, 200 };
+  const int numberOfMeshSizes = sizeof(meshSizes) / sizeof(meshSizes[0]);
+  const int numberOfChainSizes = sizeof(chainSizes) / sizeof(chainSizes[0]);
+
+  std::ofstream csv;
+  if (!options.CSVFileName.empty())
+    {
+    csv.open(options.CSVFileName.c_str());
+    if (!csv)
+      {
+      std::cerr << "Cannot write " << options.CSVFileName << std::endl;
+      return EXIT_FAILURE;
+      }
+    csv << "triangles,shape,planes,first_plane,blocks_ms,build_ms,evaluate_ms,"
+           "evaluate_triangles_per_s,clip_ms,clip_triangles_per_s,reserved_cells,clipped_cells\n";
+    }
+
+  vtkNew<vtkOsteotomyClipProfiler> profiler;
+  profiler->SetMaximumNumberOfTraceEvents(100000);
+
+  std::cout << "threads " << options.NumberOfThreads << ", best of " << options.Repeat << " runs\n";
+  std::printf("%10s %-7s %6s %6s %10s %10s %12s %14s %12s %14s\n", "triangles", "shape",
+              "planes", "first", "blocks ms", "build ms", "evaluate ms", "evaluate tri/s",
+              "clip ms", "clip tri/s");
+
+  bool failed = false;
+  for (int m = 0; m < numberOfMeshSizes; m++)
+    {
+    if (meshSizes[m] < options.MinimumNumberOfTriangles ||
+        meshSizes[m] > options.MaximumNumberOfTriangles)
+      {
+      continue;
+      }
+    vtkSmartPointer<vtkPolyData> mesh = MakeMesh(meshSizes[m]);
+    double numberOfTriangles = static_cast<double>(mesh->GetNumberOfPolys());
+
+    // The cell blocks only depend on the mesh; they are built again when it
+    // is modified
+    double blocksTime = VTK_DOUBLE_MAX;
+    vtkNew<vtkOsteotomyCellBlocks> blocks;
+    for (int run = 0; run < options.Repeat; run++)
+      {
+      mesh->Modified();
+      double begin = vtkOsteotomyClipProfiler::GetTime();
+      blocks->Build(mesh);
+      double end = vtkOsteotomyClipProfiler::GetTime();
+      blocksTime = std::min(blocksTime, end - begin);
+      }
+
+    for (int shape = 0; shape < NumberOfChainShapes; shape++)
+      {
+      for (int c = 0; c < numberOfChainSizes && chainSizes[c] <= options.MaximumNumberOfPlanes; c++)
+        {
+        vtkSmartPointer<vtkOsteotomyPlaneChain> chain = MakeChain(shape, chainSizes[c]);
+        vtkNew<vtkOsteotomyCSGProgram> program;
+        vtkNew<vtkDoubleArray> values;
+        vtkNew<vtkOsteotomyClipPolyData> clipper;
+        clipper->SetInput(mesh);
+        clipper->SetPlaneChain(chain);
+        clipper->SetProgram(program.GetPointer());
+        clipper->SetNumberOfThreads(options.NumberOfThreads);
+        clipper->IncrementalOff();
+        clipper->SetProfiler(profiler.GetPointer());
+
+        double buildTime = VTK_DOUBLE_MAX;
+        double evaluateTime = VTK_DOUBLE_MAX;
+        double clipTime = VTK_DOUBLE_MAX;
+        for (int run = 0; run < options.Repeat; run++)
+          {
+          // The first plane of clipping and the splits of the chain are decided here
+          double begin = vtkOsteotomyClipProfiler::GetTime();
+          program->Compile(chain);
+          double end = vtkOsteotomyClipProfiler::GetTime();
+          buildTime = std::min(buildTime, end - begin);
+
+          // One thread evaluating every point, the kernel alone
+          begin = vtkOsteotomyClipProfiler::GetTime();
+          program->EvaluateFunction(mesh->GetPoints()->GetData(), values.GetPointer());
+          end = vtkOsteotomyClipProfiler::GetTime();
+          evaluateTime = std::min(evaluateTime, end - begin);
+
+          // The whole filter with the compiled program: culling, evaluation, cut and
+          // merge. The mesh is marked modified so that the cell blocks of the previous
+          // run are not reused and every run includes their build.
+          mesh->Modified();
+          clipper->Modified();
+          begin = vtkOsteotomyClipProfiler::GetTime();
+          clipper->Update();
+          end = vtkOsteotomyClipProfiler::GetTime();
+          clipTime = std::min(clipTime, end - begin);
+          }
+
+        vtkIdType reservedCells = clipper->GetReservedOutput()->GetNumberOfCells();
+        vtkIdType clippedCells = clipper->GetClippedOutput()->GetNumberOfCells();
+        if (reservedCells + clippedCells < mesh->GetNumberOfCells())
+          {
+          std::cerr << "Cells lost clipping " << mesh->GetNumberOfCells() << " triangles by the "
+                    << GetChainShapeName(shape) << " chain of " << chainSizes[c] << " planes" << std::endl;
+          failed = true;
+          }
+
+        int firstPlane = chain->DetermineFirstPlaneOfClipping();
+        std::printf("%10.0f %-7s %6d %6d %10.3f %10.3f %12.3f %14.4g %12.3f %14.4g\n",
+                    numberOfTriangles, GetChainShapeName(shape), chainSizes[c], firstPlane,
+                    1000.0 * blocksTime, 1000.0 * buildTime, 1000.0 * evaluateTime,
+                    numberOfTriangles / evaluateTime, 1000.0 * clipTime, numberOfTriangles / clipTime);
+        std::fflush(stdout);
+        if (csv.is_open())
+          {
+          csv << numberOfTriangles << "," << GetChainShapeName(shape) << "," << chainSizes[c] << ","
+              << firstPlane << "," << 1000.0 * blocksTime << "," << 1000.0 * buildTime << ","
+              << 1000.0 * evaluateTime << ","
+              << numberOfTriangles / evaluateTime << "," << 1000.0 * clipTime << ","
+              << numberOfTriangles / clipTime << "," << reservedCells << "," << clippedCells << "\n";
+          }
+        }
+      }
+    }
+
+  if (!options.TraceFileName.empty() && !profiler->WriteTrace(options.TraceFileName.c_str()))
+    {
+    std::cerr << "Cannot write " << options.TraceFileName << std::endl;
+    failed = true;
+    }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyCellBlocks.h"
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyCSGProgram.h"
+#include "vtkOsteotomyPlaneChain.h"
+#include "vtkOsteotomyTestingUtilities.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkClipPolyData.h>
+#include <vtkDoubleArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using namespace vtkOsteotomyTestingUtilities;
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// The sphere with, after every few triangles, the cells of an unclean scan:
+// a triangle using a copy of one of its points, which is degenerate once the
+// coincident points are merged, and a pentagon over the triangle with points
+// in the middle of two of its edges
+vtkSmartPointer<vtkPolyData> MakeUncleanMesh(vtkIdType numberOfTriangles)
+{
+  vtkSmartPointer<vtkPolyData> sphere = MakeMesh(numberOfTriangles);
+  vtkNew<vtkPoints> points;
+  points->DeepCopy(sphere->GetPoints());
+  vtkNew<vtkCellArray> polys;
+
+  vtkCellArray* triangles = sphere->GetPolys();
+  vtkIdType npts;
+  vtkIdType* pts;
+  vtkIdType triangleId = 0;
+  for (triangles->InitTraversal(); triangles->GetNextCell(npts, pts); triangleId++)
+    {
+    polys->InsertNextCell(npts, pts);
+    if (triangleId % 7 != 0)
+      {
+      continue;
+      }
+    double a[3];
+    double b[3];
+    double c[3];
+    points->GetPoint(pts[0], a);
+    points->GetPoint(pts[1], b);
+    points->GetPoint(pts[2], c);
+
+    vtkIdType degenerate[3] = { pts[0], points->InsertNextPoint(a), pts[1] };
+    polys->InsertNextCell(3, degenerate);
+
+    vtkIdType pentagon[5] = { pts[0],
+                              points->InsertNextPoint(0.5 * (a[0] + b[0]), 0.5 * (a[1] + b[1]),
+                                                      0.5 * (a[2] + b[2])),
+                              pts[1],
+                              pts[2],
+                              points->InsertNextPoint(0.5 * (c[0] + a[0]), 0.5 * (c[1] + a[1]),
+                                                      0.5 * (c[2] + a[2])) };
+    polys->InsertNextCell(5, pentagon);
+    }
+
+  vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+  mesh->SetPoints(points.GetPointer());
+  mesh->SetPolys(polys.GetPointer());
+  return mesh;
+}
+
+} // end of anonymous namespace
+
+// The cells of the blocks copied without evaluating the clipping function
+// must come out as vtkClipPolyData gives them, degenerate triangles dropped
+// and polygons of more than four points triangulated.
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipPolyDataCullingTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkPolyData> mesh = MakeUncleanMesh(50000);
+  int numberOfThreads = std::max(2, vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+
+  for (int shape = 0; shape < NumberOfChainShapes; shape++)
+    {
+    vtkSmartPointer<vtkOsteotomyPlaneChain> chain = MakeChain(shape, 10);
+
+    // Reference: vtkClipPolyData on the values of the compiled body
+    vtkNew<vtkOsteotomyCSGProgram> program;
+    program->Compile(chain);
+    vtkNew<vtkDoubleArray> values;
+    program->EvaluateFunction(mesh->GetPoints()->GetData(), values.GetPointer());
+    vtkNew<vtkPolyData> input;
+    input->ShallowCopy(mesh);
+    input->GetPointData()->SetScalars(values.GetPointer());
+    vtkNew<vtkClipPolyData> reference;
+    reference->SetInput(input.GetPointer());
+    reference->GenerateClippedOutputOn();
+    reference->SetValue(0.0);
+    reference->SetInsideOut(chain->GetReverseClipping());
+    reference->Update();
+
+    for (int threads = 1; threads <= numberOfThreads; threads += numberOfThreads - 1)
+      {
+      vtkNew<vtkOsteotomyClipPolyData> clipper;
+      clipper->SetInput(mesh);
+      clipper->SetPlaneChain(chain);
+      clipper->SetNumberOfThreads(threads);
+      clipper->BlockCullingOn();
+      clipper->IncrementalOff();
+      clipper->Update();
+
+      std::ostringstream what;
+      what << GetChainShapeName(shape) << " chain, " << threads << " threads";
+      vtkOsteotomyCellBlocks* blocks = clipper->GetCellBlocks();
+      if (blocks->GetNumberOfStraddlingBlocks() == blocks->GetNumberOfBlocks())
+        {
+        std::cerr << what.str() << ": no block of cells is culled" << std::endl;
+        return EXIT_FAILURE;
+        }
+      if (!ComparePolyData(clipper->GetReservedOutput(), reference->GetOutput(),
+                           (what.str() + ", reserved").c_str()) ||
+          !ComparePolyData(clipper->GetClippedOutput(), reference->GetClippedOutput(),
+                           (what.str() + ", clipped").c_str()))
+        {
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
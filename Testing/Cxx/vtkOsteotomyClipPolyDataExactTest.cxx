@@ -0,0 +1,134 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyPlaneChain.h"
+#include "vtkOsteotomyTestingUtilities.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+#include <map>
+#include <utility>
+
+using namespace vtkOsteotomyTestingUtilities;
+
+namespace
+{
+
+typedef std::map<std::pair<vtkIdType, vtkIdType>, int> EdgeCountMap;
+
+//----------------------------------------------------------------------------
+// Count the triangles using every edge; false if a polygon is not a triangle
+bool CountEdges(vtkPolyData* polyData, EdgeCountMap& edges)
+{
+  vtkCellArray* polys = polyData->GetPolys();
+  vtkIdType npts;
+  vtkIdType* pts;
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+    {
+    if (npts != 3)
+      {
+      std::cerr << "Polygon of " << npts << " points in the output" << std::endl;
+      return false;
+      }
+    for (int i = 0; i < 3; i++)
+      {
+      vtkIdType a = pts[i];
+      vtkIdType b = pts[(i + 1) % 3];
+      edges[a < b ? std::make_pair(a, b) : std::make_pair(b, a)]++;
+      }
+    }
+  return true;
+}
+
+} // end of anonymous namespace
+
+// The exact cut of a closed surface must leave no crack: the two parts share
+// the points of the cut, so together every edge is used by exactly two
+// triangles, one on each side.
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipPolyDataExactTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkPolyData> sphere = MakeMesh(20000);
+
+  EdgeCountMap sphereEdges;
+  if (!CountEdges(sphere, sphereEdges))
+    {
+    return EXIT_FAILURE;
+    }
+  for (EdgeCountMap::iterator it = sphereEdges.begin(); it != sphereEdges.end(); ++it)
+    {
+    if (it->second != 2)
+      {
+      std::cerr << "The input sphere is not closed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  const int numberOfPlanes[] = { 1, 5, 10 };
+  for (int shape = 0; shape < NumberOfChainShapes; shape++)
+    {
+    for (int c = 0; c < 3; c++)
+      {
+      for (int culling = 0; culling < 2; culling++)
+        {
+        vtkSmartPointer<vtkOsteotomyPlaneChain> chain = MakeChain(shape, numberOfPlanes[c]);
+        vtkNew<vtkOsteotomyClipPolyData> clipper;
+        clipper->SetInput(sphere);
+        clipper->SetPlaneChain(chain);
+        clipper->SetClipModeToExact();
+        clipper->SetBlockCulling(culling);
+        clipper->Update();
+
+        vtkPolyData* reserved = clipper->GetReservedOutput();
+        vtkPolyData* clipped = clipper->GetClippedOutput();
+        if (reserved->GetNumberOfPolys() == 0 || clipped->GetNumberOfPolys() == 0)
+          {
+          std::cerr << GetChainShapeName(shape) << " chain of " << numberOfPlanes[c]
+                    << " planes, culling " << culling << ": the sphere is not cut" << std::endl;
+          return EXIT_FAILURE;
+          }
+
+        EdgeCountMap edges;
+        if (!CountEdges(reserved, edges) || !CountEdges(clipped, edges))
+          {
+          return EXIT_FAILURE;
+          }
+        for (EdgeCountMap::iterator it = edges.begin(); it != edges.end(); ++it)
+          {
+          if (it->second != 2)
+            {
+            std::cerr << GetChainShapeName(shape) << " chain of " << numberOfPlanes[c]
+                      << " planes, culling " << culling << ": edge " << it->first.first << "-"
+                      << it->first.second << " is used by " << it->second << " triangles"
+                      << std::endl;
+            return EXIT_FAILURE;
+            }
+          }
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
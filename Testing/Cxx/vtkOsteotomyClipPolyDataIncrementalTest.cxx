@@ -0,0 +1,108 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyPlaneChain.h"
+#include "vtkOsteotomyTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <iostream>
+#include <sstream>
+
+using namespace vtkOsteotomyTestingUtilities;
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Translate plane i of the chain along y
+void MovePlane(vtkOsteotomyPlaneChain* chain, int i, double offset)
+{
+  double corners[4][3];
+  double* points[4] = { chain->GetOrigin(i), chain->GetPoint1(i),
+                        chain->GetPoint2(i), chain->GetPoint3(i) };
+  for (int c = 0; c < 4; c++)
+    {
+    corners[c][0] = points[c][0];
+    corners[c][1] = points[c][1] + offset;
+    corners[c][2] = points[c][2];
+    }
+  chain->SetPlane(i, corners[0], corners[1], corners[2], corners[3]);
+}
+
+} // end of anonymous namespace
+
+// Re-clipping after a plane moved reuses the values of the other planes and
+// the chunks of cells that did not change; the result must be the one of a
+// clipper that never saw the previous position.
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipPolyDataIncrementalTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkSmartPointer<vtkPolyData> mesh = MakeMesh(100000);
+
+  // Planes moved one after the other: an inner plane, the same one again,
+  // its neighbour, plane 0 and the last plane
+  const int numberOfPlanes = 10;
+  const int movedPlanes[] = { 4, 4, 5, 0, numberOfPlanes - 1 };
+  const int numberOfMoves = sizeof(movedPlanes) / sizeof(movedPlanes[0]);
+
+  for (int shape = 0; shape < NumberOfChainShapes; shape++)
+    {
+    for (int culling = 0; culling < 2; culling++)
+      {
+      vtkSmartPointer<vtkOsteotomyPlaneChain> chain = MakeChain(shape, numberOfPlanes);
+      vtkNew<vtkOsteotomyClipPolyData> clipper;
+      clipper->SetInput(mesh);
+      clipper->SetPlaneChain(chain);
+      clipper->SetBlockCulling(culling);
+      clipper->IncrementalOn();
+      clipper->Update();
+
+      for (int move = 0; move < numberOfMoves; move++)
+        {
+        MovePlane(chain, movedPlanes[move], 0.05 * MeshRadius);
+        clipper->Update();
+
+        vtkNew<vtkOsteotomyClipPolyData> fresh;
+        fresh->SetInput(mesh);
+        fresh->SetPlaneChain(chain);
+        fresh->SetBlockCulling(culling);
+        fresh->IncrementalOff();
+        fresh->Update();
+
+        std::ostringstream what;
+        what << GetChainShapeName(shape) << " chain, culling " << culling << ", plane "
+             << movedPlanes[move] << " moved (move " << move << ")";
+        if (!ComparePolyData(clipper->GetReservedOutput(), fresh->GetReservedOutput(),
+                             (what.str() + ", reserved").c_str()) ||
+            !ComparePolyData(clipper->GetClippedOutput(), fresh->GetClippedOutput(),
+                             (what.str() + ", clipped").c_str()))
+          {
+          return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipPolyData.h"
+#include "vtkOsteotomyCSGProgram.h"
+#include "vtkOsteotomyPlaneChain.h"
+#include "vtkOsteotomyTestingUtilities.h"
+
+// VTK includes
+#include <vtkClipPolyData.h>
+#include <vtkDoubleArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using namespace vtkOsteotomyTestingUtilities;
+
+// The chunked clipper must give the output of the serial vtkClipPolyData,
+// point for point and cell for cell, whatever the number of threads.
+//----------------------------------------------------------------------------
+int vtkOsteotomyClipPolyDataThreadsTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  // About 50 chunks of cells
+  vtkSmartPointer<vtkPolyData> mesh = MakeMesh(100000);
+  int numberOfThreads = std::max(2, vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+
+  for (int shape = 0; shape < NumberOfChainShapes; shape++)
+    {
+    vtkSmartPointer<vtkOsteotomyPlaneChain> chain = MakeChain(shape, 10);
+
+    // Reference: vtkClipPolyData on the values of the compiled body
+    vtkNew<vtkOsteotomyCSGProgram> program;
+    program->Compile(chain);
+    vtkNew<vtkDoubleArray> values;
+    program->EvaluateFunction(mesh->GetPoints()->GetData(), values.GetPointer());
+    vtkNew<vtkPolyData> input;
+    input->ShallowCopy(mesh);
+    input->GetPointData()->SetScalars(values.GetPointer());
+    vtkNew<vtkClipPolyData> reference;
+    reference->SetInput(input.GetPointer());
+    reference->GenerateClippedOutputOn();
+    reference->SetValue(0.0);
+    reference->SetInsideOut(chain->GetReverseClipping());
+    reference->Update();
+
+    // One thread and all of them, with and without block culling. Incremental
+    // clipping is off, so the chunked path is taken by the threads or the culling.
+    for (int threads = 1; threads <= numberOfThreads; threads += numberOfThreads - 1)
+      {
+      for (int culling = 0; culling < 2; culling++)
+        {
+        if (threads == 1 && !culling)
+          {
+          continue; // vtkClipPolyData itself
+          }
+        vtkNew<vtkOsteotomyClipPolyData> clipper;
+        clipper->SetInput(mesh);
+        clipper->SetPlaneChain(chain);
+        clipper->SetNumberOfThreads(threads);
+        clipper->SetBlockCulling(culling);
+        clipper->IncrementalOff();
+        clipper->Update();
+
+        std::ostringstream what;
+        what << GetChainShapeName(shape) << " chain, " << threads << " threads, culling "
+             << culling;
+        if (!ComparePolyData(clipper->GetReservedOutput(), reference->GetOutput(),
+                             (what.str() + ", reserved").c_str()) ||
+            !ComparePolyData(clipper->GetClippedOutput(), reference->GetClippedOutput(),
+                             (what.str() + ", clipped").c_str()))
+          {
+          return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,358 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyPlaneChain.h"
+#include "vtkOsteotomyTestingUtilities.h"
+
+// VTK includes
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+// STD includes
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace vtkOsteotomyTestingUtilities;
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Body of planes m..n split into m..i-1 and i..n
+struct Split
+{
+  int M;
+  int N;
+  int I;
+};
+
+const int MaximumNumberOfSplits = 18;
+
+struct ExpectedChain
+{
+  int Shape;
+  int NumberOfPlanes;
+  int FirstPlaneOfClipping;
+  int NumberOfSplits;
+  Split Splits[MaximumNumberOfSplits];
+};
+
+// Splits of the ranges of at least three planes, in the order the body is
+// built: a range, then its first part, then its second part
+const ExpectedChain ExpectedChains[] =
+{
+  { ZigZag, 10, 0, 8,
+    { {0,9,9}, {0,8,8}, {0,7,7}, {0,6,6}, {0,5,5}, {0,4,4}, {0,3,3}, {0,2,2} } },
+  { ZigZag, 20, 0, 18,
+    { {0,19,19}, {0,18,18}, {0,17,17}, {0,16,16}, {0,15,15}, {0,14,14}, {0,13,13},
+      {0,12,12}, {0,11,11}, {0,10,10}, {0,9,9}, {0,8,8}, {0,7,7}, {0,6,6}, {0,5,5},
+      {0,4,4}, {0,3,3}, {0,2,2} } },
+  { Loop, 10, 0, 6,
+    { {0,9,4}, {0,3,3}, {0,2,2}, {4,9,8}, {4,7,7}, {4,6,6} } },
+  { Loop, 20, 1, 16,
+    { {1,19,10}, {1,9,9}, {1,8,8}, {1,7,7}, {1,6,6}, {1,5,5}, {1,4,4}, {1,3,3},
+      {10,19,19}, {10,18,18}, {10,17,17}, {10,16,16}, {10,15,15}, {10,14,14},
+      {10,13,13}, {10,12,12} } },
+  { Spiral, 10, 0, 5,
+    { {0,9,2}, {2,9,5}, {2,4,4}, {5,9,8}, {5,7,7} } },
+  { Spiral, 20, 0, 16,
+    { {0,19,8}, {0,7,7}, {0,6,6}, {0,5,5}, {0,4,4}, {0,3,3}, {0,2,2}, {8,19,16},
+      {8,15,15}, {8,14,14}, {8,13,13}, {8,12,12}, {8,11,11}, {8,10,10}, {16,19,19},
+      {16,18,18} } }
+};
+
+//----------------------------------------------------------------------------
+// Splits of planes m..n as the body is built from them
+void CollectSplits(vtkOsteotomyPlaneChain* chain, int m, int n, std::vector<Split>& splits)
+{
+  if (m == n)
+    {
+    return;
+    }
+  int i = (n - m == 1) ? n : chain->GetSplitPlane(m, n);
+  if (n - m >= 2)
+    {
+    Split split = { m, n, i };
+    splits.push_back(split);
+    }
+  CollectSplits(chain, m, i - 1, splits);
+  CollectSplits(chain, i, n, splits);
+}
+
+//----------------------------------------------------------------------------
+bool CompareSplits(const std::vector<Split>& splits, const Split* expected,
+                   int numberOfExpected, const std::string& what)
+{
+  if (static_cast<int>(splits.size()) != numberOfExpected)
+    {
+    std::cerr << what << ": " << splits.size() << " splits instead of " << numberOfExpected
+              << std::endl;
+    return false;
+    }
+  for (int k = 0; k < numberOfExpected; k++)
+    {
+    if (splits[k].M != expected[k].M || splits[k].N != expected[k].N ||
+        splits[k].I != expected[k].I)
+      {
+      std::cerr << what << ": split " << k << " is planes " << splits[k].M << ".." << splits[k].N
+                << " at " << splits[k].I << " instead of planes " << expected[k].M << ".."
+                << expected[k].N << " at " << expected[k].I << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Reference intersections, without the projection and the tables of the
+// chain: the walls of the test chains are vertical, so their segments are
+// the x, y of Origin and Point2
+const double Tolerance = 0.001;
+const double Extension = 100.0;
+
+struct Point2D
+{
+  double X;
+  double Y;
+};
+
+Point2D GetOrigin2D(vtkOsteotomyPlaneChain* chain, int i)
+{
+  Point2D p = { chain->GetOrigin(i)[0], chain->GetOrigin(i)[1] };
+  return p;
+}
+
+Point2D GetPoint22D(vtkOsteotomyPlaneChain* chain, int i)
+{
+  Point2D p = { chain->GetPoint2(i)[0], chain->GetPoint2(i)[1] };
+  return p;
+}
+
+// Point a + Extension * (b - a)
+Point2D Extend(const Point2D& a, const Point2D& b)
+{
+  Point2D p = { a.X + Extension * (b.X - a.X), a.Y + Extension * (b.Y - a.Y) };
+  return p;
+}
+
+double Cross(const Point2D& a, const Point2D& b, const Point2D& c)
+{
+  return (b.X - a.X) * (c.Y - a.Y) - (b.Y - a.Y) * (c.X - a.X);
+}
+
+double Distance2ToSegment(const Point2D& p, const Point2D& a, const Point2D& b)
+{
+  double abX = b.X - a.X;
+  double abY = b.Y - a.Y;
+  double length2 = abX * abX + abY * abY;
+  double t = (length2 > 0.0) ? ((p.X - a.X) * abX + (p.Y - a.Y) * abY) / length2 : 0.0;
+  t = std::min(1.0, std::max(0.0, t));
+  double dx = p.X - a.X - t * abX;
+  double dy = p.Y - a.Y - t * abY;
+  return dx * dx + dy * dy;
+}
+
+bool SegmentsIntersect(const Point2D& a1, const Point2D& a2,
+                       const Point2D& b1, const Point2D& b2)
+{
+  double d1 = Cross(b1, b2, a1);
+  double d2 = Cross(b1, b2, a2);
+  double d3 = Cross(a1, a2, b1);
+  double d4 = Cross(a1, a2, b2);
+  if (d1 * d2 < 0.0 && d3 * d4 < 0.0)
+    {
+    return true;
+    }
+  double tolerance2 = Tolerance * Tolerance;
+  return Distance2ToSegment(a1, b1, b2) <= tolerance2 ||
+         Distance2ToSegment(a2, b1, b2) <= tolerance2 ||
+         Distance2ToSegment(b1, a1, a2) <= tolerance2 ||
+         Distance2ToSegment(b2, a1, a2) <= tolerance2;
+}
+
+bool PolylineIntersects(const Point2D& a1, const Point2D& a2, const std::vector<Point2D>& polyline)
+{
+  for (size_t k = 0; k + 1 < polyline.size(); k++)
+    {
+    if (SegmentsIntersect(a1, a2, polyline[k], polyline[k + 1]))
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+// Segment of plane i extended both ways against the polyline from the
+// reverse extension of plane m through the origins m+1 to i-1
+bool ReferenceIsIntersect1(vtkOsteotomyPlaneChain* chain, int m, int i)
+{
+  if (i - m <= 1)
+    {
+    return false;
+    }
+  std::vector<Point2D> polyline;
+  polyline.push_back(Extend(GetPoint22D(chain, m), GetOrigin2D(chain, m)));
+  for (int k = m + 1; k <= i - 1; k++)
+    {
+    polyline.push_back(GetOrigin2D(chain, k));
+    }
+  Point2D origin = GetOrigin2D(chain, i);
+  Point2D point2 = GetPoint22D(chain, i);
+  return PolylineIntersects(origin, Extend(origin, point2), polyline) ||
+         PolylineIntersects(point2, Extend(point2, origin), polyline);
+}
+
+// Segment of plane a extended from its Origin against the polyline through
+// the origins a+2 to n and the extension of plane n
+bool ReferenceIsIntersect2(vtkOsteotomyPlaneChain* chain, int a, int n)
+{
+  if (n - a <= 1)
+    {
+    return false;
+    }
+  std::vector<Point2D> polyline;
+  for (int k = a + 2; k <= n; k++)
+    {
+    polyline.push_back(GetOrigin2D(chain, k));
+    }
+  polyline.push_back(Extend(GetOrigin2D(chain, n), GetPoint22D(chain, n)));
+  Point2D origin = GetOrigin2D(chain, a);
+  return PolylineIntersects(origin, Extend(origin, GetPoint22D(chain, a)), polyline);
+}
+
+//----------------------------------------------------------------------------
+bool CheckIntersections(vtkOsteotomyPlaneChain* chain, const std::string& what)
+{
+  int numberOfPlanes = chain->GetNumberOfPlanes();
+  for (int m = 0; m < numberOfPlanes; m++)
+    {
+    for (int i = m + 1; i < numberOfPlanes; i++)
+      {
+      bool expected = ReferenceIsIntersect1(chain, m, i);
+      if (chain->IsIntersect1(m, i) != expected)
+        {
+        std::cerr << what << ": IsIntersect1(" << m << ", " << i << ") is not " << expected
+                  << std::endl;
+        return false;
+        }
+      expected = ReferenceIsIntersect2(chain, m, i);
+      if (chain->IsIntersect2(m, i) != expected)
+        {
+        std::cerr << what << ": IsIntersect2(" << m << ", " << i << ") is not " << expected
+                  << std::endl;
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Translate plane i of the chain along y
+void MovePlane(vtkOsteotomyPlaneChain* chain, int i, double offset)
+{
+  double corners[4][3];
+  double* points[4] = { chain->GetOrigin(i), chain->GetPoint1(i),
+                        chain->GetPoint2(i), chain->GetPoint3(i) };
+  for (int c = 0; c < 4; c++)
+    {
+    corners[c][0] = points[c][0];
+    corners[c][1] = points[c][1] + offset;
+    corners[c][2] = points[c][2];
+    }
+  chain->SetPlane(i, corners[0], corners[1], corners[2], corners[3]);
+}
+
+} // end of anonymous namespace
+
+// The path intersections of the chain shapes give known first planes and
+// split planes; after planes move, the tables kept by the chain must give
+// the intersections and splits of a chain that never saw the old positions.
+//----------------------------------------------------------------------------
+int vtkOsteotomyPlaneChainTest(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  const int numberOfChains = sizeof(ExpectedChains) / sizeof(ExpectedChains[0]);
+  for (int c = 0; c < numberOfChains; c++)
+    {
+    const ExpectedChain& expected = ExpectedChains[c];
+    vtkSmartPointer<vtkOsteotomyPlaneChain> chain =
+      MakeChain(expected.Shape, expected.NumberOfPlanes);
+    std::ostringstream what;
+    what << GetChainShapeName(expected.Shape) << " chain of " << expected.NumberOfPlanes
+         << " planes";
+
+    if (!CheckIntersections(chain, what.str()))
+      {
+      return EXIT_FAILURE;
+      }
+    int first = chain->DetermineFirstPlaneOfClipping();
+    if (first != expected.FirstPlaneOfClipping)
+      {
+      std::cerr << what.str() << ": first plane of clipping " << first << " instead of "
+                << expected.FirstPlaneOfClipping << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::vector<Split> splits;
+    CollectSplits(chain, first, expected.NumberOfPlanes - 1, splits);
+    if (!CompareSplits(splits, expected.Splits, expected.NumberOfSplits, what.str()))
+      {
+      return EXIT_FAILURE;
+      }
+
+    // Planes moved one after the other: an inner plane, the same one again,
+    // its neighbour, plane 0 and the last plane
+    int last = expected.NumberOfPlanes - 1;
+    const int movedPlanes[] = { last / 2, last / 2, last / 2 + 1, 0, last };
+    const int numberOfMoves = sizeof(movedPlanes) / sizeof(movedPlanes[0]);
+    for (int move = 0; move < numberOfMoves; move++)
+      {
+      MovePlane(chain, movedPlanes[move], 0.05 * MeshRadius);
+      std::ostringstream moved;
+      moved << what.str() << ", plane " << movedPlanes[move] << " moved (move " << move << ")";
+      if (!CheckIntersections(chain, moved.str()))
+        {
+        return EXIT_FAILURE;
+        }
+
+      vtkNew<vtkOsteotomyPlaneChain> fresh;
+      fresh->DeepCopy(chain);
+      int freshFirst = fresh->DetermineFirstPlaneOfClipping();
+      first = chain->DetermineFirstPlaneOfClipping();
+      if (first != freshFirst)
+        {
+        std::cerr << moved.str() << ": first plane of clipping " << first << " instead of "
+                  << freshFirst << std::endl;
+        return EXIT_FAILURE;
+        }
+      std::vector<Split> freshSplits;
+      CollectSplits(fresh.GetPointer(), freshFirst, last, freshSplits);
+      splits.clear();
+      CollectSplits(chain, first, last, splits);
+      if (!CompareSplits(splits, freshSplits.empty() ? NULL : &freshSplits[0],
+                         static_cast<int>(freshSplits.size()), moved.str()))
+        {
+        return EXIT_FAILURE;
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/*==============================================================================
+
+  Program: 3D Slicer
+
+  Portions (c) Copyright Brigham and Women's Hospital (BWH) All Rights Reserved.
+
+  See COPYRIGHT.txt
+  or http://www.slicer.org/copyright/copyright.txt for details.
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+==============================================================================*/
+
+// Synthetic meshes and plane chains shared by the tests and the benchmark of
+// the clip engine, and the comparison of clip outputs.
+
+#ifndef __vtkOsteotomyTestingUtilities_h
+#define __vtkOsteotomyTestingUtilities_h
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyPlaneChain.h"
+
+// VTK includes
+#include <vtkCellArray.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+// STD includes
+#include <cmath>
+#include <iostream>
+
+namespace vtkOsteotomyTestingUtilities
+{
+
+//----------------------------------------------------------------------------
+// Shapes of the clipping paths, all on a wall as high as the mesh
+enum ChainShape
+{
+  // Open path across the mesh, turning left and right at every plane, so
+  // that the planes are alternately joined by union and intersection
+  ZigZag = 0,
+  // Path around the mesh for 1.1 turns: its last plane crosses its first
+  // ones, so the first plane of clipping is not plane 0
+  Loop,
+  // Inward spiral of 1.25 turns: the extended segments cross the previous
+  // turn, so the chain is split at many planes by IsIntersect1/IsIntersect2
+  Spiral,
+  NumberOfChainShapes
+};
+
+inline const char* GetChainShapeName(int shape)
+{
+  const char* names[NumberOfChainShapes] = { "zigzag", "loop", "spiral" };
+  return names[shape];
+}
+
+const double MeshRadius = 50.0;
+
+//----------------------------------------------------------------------------
+// Sphere of about numberOfTriangles triangles (2*T*(P-1) for T x P divisions)
+inline vtkSmartPointer<vtkPolyData> MakeMesh(vtkIdType numberOfTriangles)
+{
+  int resolution = static_cast<int>(std::sqrt(numberOfTriangles / 2.0)) + 1;
+  vtkNew<vtkSphereSource> sphere;
+  sphere->SetRadius(MeshRadius);
+  sphere->SetThetaResolution(resolution);
+  sphere->SetPhiResolution(resolution);
+  sphere->Update();
+  vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+  mesh->ShallowCopy(sphere->GetOutput());
+  return mesh;
+}
+
+//----------------------------------------------------------------------------
+// Path vertex k of n, in the z = 0 plane
+inline void GetPathVertex(int shape, int k, int n, double vertex[3])
+{
+  double t = static_cast<double>(k) / n;
+  double angle;
+  double radius;
+  vertex[2] = 0.0;
+  switch (shape)
+    {
+    case ZigZag:
+      vertex[0] = -1.5 * MeshRadius + 3.0 * MeshRadius * t;
+      vertex[1] = (k % 2) ? 0.2 * MeshRadius : -0.2 * MeshRadius;
+      return;
+    case Loop:
+      angle = 2.0 * vtkMath::DoublePi() * 1.1 * t;
+      radius = 0.6 * MeshRadius;
+      break;
+    default:
+      angle = 2.0 * vtkMath::DoublePi() * 1.25 * t;
+      radius = (0.8 - 0.5 * t) * MeshRadius;
+      break;
+    }
+  vertex[0] = radius * std::cos(angle);
+  vertex[1] = radius * std::sin(angle);
+}
+
+//----------------------------------------------------------------------------
+// Plane i joins path vertices i and i+1 (Origin and Point2) and rises above
+// them (Point1 and Point3), as the planes placed in the module
+inline vtkSmartPointer<vtkOsteotomyPlaneChain> MakeChain(int shape, int numberOfPlanes)
+{
+  vtkSmartPointer<vtkOsteotomyPlaneChain> chain = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+  double height = 2.4 * MeshRadius;
+  for (int i = 0; i < numberOfPlanes; i++)
+    {
+    double origin[3], point1[3], point2[3], point3[3];
+    GetPathVertex(shape, i, numberOfPlanes, origin);
+    GetPathVertex(shape, i + 1, numberOfPlanes, point2);
+    origin[2] = point2[2] = -0.5 * height;
+    for (int k = 0; k < 3; k++)
+      {
+      point1[k] = origin[k];
+      point3[k] = point2[k];
+      }
+    point1[2] = point3[2] = 0.5 * height;
+    chain->AddPlane(origin, point1, point2, point3);
+    }
+  return chain;
+}
+
+//----------------------------------------------------------------------------
+// Whether two clip outputs have the same point coordinates, in the same
+// order, and the same polygons. The first difference is printed.
+inline bool ComparePolyData(vtkPolyData* output, vtkPolyData* expected, const char* what)
+{
+  vtkIdType numPts = output->GetNumberOfPoints();
+  if (numPts != expected->GetNumberOfPoints())
+    {
+    std::cerr << what << ": " << numPts << " points instead of "
+              << expected->GetNumberOfPoints() << std::endl;
+    return false;
+    }
+  for (vtkIdType i = 0; i < numPts; i++)
+    {
+    double x[3];
+    double y[3];
+    output->GetPoint(i, x);
+    expected->GetPoint(i, y);
+    if (x[0] != y[0] || x[1] != y[1] || x[2] != y[2])
+      {
+      std::cerr << what << ": point " << i << " is (" << x[0] << ", " << x[1] << ", " << x[2]
+                << ") instead of (" << y[0] << ", " << y[1] << ", " << y[2] << ")" << std::endl;
+      return false;
+      }
+    }
+
+  vtkCellArray* polys = output->GetPolys();
+  vtkCellArray* expectedPolys = expected->GetPolys();
+  if (polys->GetNumberOfCells() != expectedPolys->GetNumberOfCells())
+    {
+    std::cerr << what << ": " << polys->GetNumberOfCells() << " polygons instead of "
+              << expectedPolys->GetNumberOfCells() << std::endl;
+    return false;
+    }
+  vtkIdType npts;
+  vtkIdType* pts;
+  vtkIdType expectedNpts;
+  vtkIdType* expectedPts;
+  vtkIdType cellId = 0;
+  polys->InitTraversal();
+  expectedPolys->InitTraversal();
+  while (polys->GetNextCell(npts, pts) && expectedPolys->GetNextCell(expectedNpts, expectedPts))
+    {
+    bool same = (npts == expectedNpts);
+    for (vtkIdType i = 0; i < npts && same; i++)
+      {
+      same = (pts[i] == expectedPts[i]);
+      }
+    if (!same)
+      {
+      std::cerr << what << ": polygon " << cellId << " differs" << std::endl;
+      return false;
+      }
+    cellId++;
+    }
+  return true;
+}
+
+} // end of vtkOsteotomyTestingUtilities namespace
+
+#endif
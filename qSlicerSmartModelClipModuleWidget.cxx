@@ -27,7 +27,9 @@
 #include <QDebug>
 #include <Qt/qlist.h>
 #include <QString>
+#include <QFileDialog>
 #include <QMessageBox>
+#include <QtConcurrentRun>
 
 // SlicerQt includes
 #include <qMRMLThreeDView.h>
@@ -39,6 +41,14 @@
 #include "qSlicerSmartModelClipModuleWidget.h"
 #include "ui_qSlicerSmartModelClipModuleWidget.h"
 
+// SmartModelClip MRML includes
+#include "vtkMRMLOsteotomyPlaneChainNode.h"
+
+// SmartModelClip Logic includes
+#include "vtkOsteotomyClipHistory.h"
+#include "vtkOsteotomyClipProfiler.h"
+#include "vtkSlicerSmartModelClipLogic.h"
+
 
 //VTK includes
 #include<vtkRenderWindowInteractor.h>
@@ -56,6 +66,7 @@
 #include <vtkAppendPolyData.h>
 #include <vtkSmartPointer.h>
 #include <vtkSphereSource.h>
+#include <vtkCollection.h>
 #include <vtkCommand.h>
 #include <vtkMath.h>
 #include <vtkClipPolyData.h>
@@ -88,7 +99,6 @@
 #include <TCHAR.h>
 //#include "time.h"  
 #include <windows.h>
-#include <fstream>
 
 //-----------------------------------------------------------------------------
 /// \ingroup Slicer_QtModules_ExtensionTemplate
@@ -127,12 +137,34 @@ qSlicerSmartModelClipModuleWidget::qSlicerSmartModelClipModuleWidget(QWidget* _p
 	numOfFiducials=0;
 	isReversedClippingPlane=0;
     isReversedDepthPlane=0;
+	planeChain = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+
+	storingPlaneChain = false;
+
+	clipPending = false;
+	clipChain = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+	clipProgressTimer.setInterval(100);
+	QObject::connect(&clipProgressTimer, SIGNAL(timeout()), this, SLOT(updateClipProgress()));
+	QObject::connect(&clipWatcher, SIGNAL(finished()), this, SLOT(onClipFinished()));
+
+	previewPending = false;
+	previewInteracting = false;
+	previewLevel = vtkSlicerSmartModelClipLogic::PreviewCoarse;
+	previewChain = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+	previewResult = vtkSmartPointer<vtkPolyData>::New();
+	previewModel = 0;
+	QObject::connect(&previewWatcher, SIGNAL(finished()), this, SLOT(onPreviewFinished()));
 	
 }
 
 //-----------------------------------------------------------------------------
 qSlicerSmartModelClipModuleWidget::~qSlicerSmartModelClipModuleWidget()
 {
+	if(clipWatcher.isRunning())
+		vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->AbortClip();
+	clipWatcher.waitForFinished();
+	previewWatcher.waitForFinished();
+	pyramidFuture.waitForFinished();
 	clearPlanes();
 }
 
@@ -152,6 +184,18 @@ void qSlicerSmartModelClipModuleWidget::setup()
   QObject::connect(d->reverseDepthPlaneButton, SIGNAL(clicked()), this, SLOT(reverseDepthPlane()));
   QObject::connect(d->depthButton, SIGNAL(clicked()), this, SLOT(setDepthPlane()));
   QObject::connect(d->clipButton, SIGNAL(clicked()), this, SLOT(clip()));
+  QObject::connect(d->batchClipButton, SIGNAL(clicked()), this, SLOT(batchClip()));
+  QObject::connect(d->cancelClipButton, SIGNAL(clicked()), this, SLOT(cancelClip()));
+  QObject::connect(d->exportTimingsButton, SIGNAL(clicked()), this, SLOT(exportTimings()));
+  QObject::connect(d->exportPlaneChainButton, SIGNAL(clicked()), this, SLOT(exportPlaneChain()));
+  d->clipProgressBar->setVisible(0);
+  d->cancelClipButton->setVisible(0);
+  qvtkConnect(qSlicerApplication::application()->mrmlScene(), vtkMRMLScene::StartSaveEvent, this, SLOT(onSceneStartSave()));
+  qvtkConnect(qSlicerApplication::application()->mrmlScene(), vtkMRMLScene::EndSaveEvent, this, SLOT(onSceneEndSave()));
+  QObject::connect(d->previewBox, SIGNAL(toggled(bool)), this, SLOT(setPreviewEnabled(bool)));
+  QObject::connect(d->clipNodeComboBox, SIGNAL(currentNodeChanged(vtkMRMLNode*)), this, SLOT(buildPreviewPyramid()));
+  QObject::connect(d->clipNodeComboBox, SIGNAL(currentNodeChanged(vtkMRMLNode*)), this, SLOT(updatePreview()));
+  QObject::connect(d->planeChainNodeComboBox, SIGNAL(currentNodeChanged(vtkMRMLNode*)), this, SLOT(restorePlaneChain(vtkMRMLNode*)));
 
 }
 
@@ -264,9 +308,13 @@ void qSlicerSmartModelClipModuleWidget::createPlane()
 
 	renderWindowInteractor->Initialize();
 	planeWidget->SetInteractor(renderWindowInteractor);
+	planeWidget->MergedGlyphsOn();  //one actor for the handles, boundaries and normal of each plane
 	planeWidget->On();
+	observePlaneWidget(planeWidget);
 	renderWindow->Render();
 	/*renderWindowInteractor->Start();*/ //cause error if uncommeted
+	storePlaneChain();
+	updatePreview();
 }
 
 void qSlicerSmartModelClipModuleWidget::deletePlane()
@@ -292,6 +340,8 @@ void qSlicerSmartModelClipModuleWidget::deletePlane()
 
 	renderWindow->Render();
 	setButtonState();
+	storePlaneChain();
+	updatePreview();
 }
 
 void qSlicerSmartModelClipModuleWidget::clearPlanes()
@@ -312,9 +362,11 @@ void qSlicerSmartModelClipModuleWidget::clearPlanes()
 	{
 		DepthPlaneWidget->SetEnabled(0);
 		DepthPlaneWidget->Delete();
+		d->depthButton->setText(tr("Create Depth Plane"));
 	}
 
 	setButtonState();
+	updatePreview();
 
 	//another way to clear planes,but it is slower.
 	//for (int i = 0; i < numOfPlanes; i++) //this is wrong because numOfPlanes is not a constant
@@ -387,6 +439,7 @@ void qSlicerSmartModelClipModuleWidget::setDepthPlane()
 		renderWindowInteractor->Initialize();
 		DepthPlaneWidget->SetInteractor(renderWindowInteractor);
 		DepthPlaneWidget->On();
+		observePlaneWidget(DepthPlaneWidget);
 		renderWindow->Render();
 	} 
 	else //delete the depth plane
@@ -396,6 +449,8 @@ void qSlicerSmartModelClipModuleWidget::setDepthPlane()
 		d->depthButton->setText(tr("Create Depth Plane"));
 		renderWindow->Render();
 	}
+	storePlaneChain();
+	updatePreview();
 }
 
 void qSlicerSmartModelClipModuleWidget::setButtonState()
@@ -409,6 +464,8 @@ void qSlicerSmartModelClipModuleWidget::setButtonState()
 		d->clearButton->setEnabled(0);
 		d->depthButton->setEnabled(0);
 		d->clipButton->setEnabled(0);
+		d->batchClipButton->setEnabled(0);
+		d->previewBox->setEnabled(0);
 		d->reverseClippingPlaneButton->setEnabled(0);
         d->reverseDepthPlaneButton->setEnabled(0);
 	}
@@ -422,6 +479,8 @@ void qSlicerSmartModelClipModuleWidget::setButtonState()
 			d->hidePlaneBox->setEnabled(0);
 			d->depthButton->setEnabled(0);
 			d->clipButton->setEnabled(0);
+			d->batchClipButton->setEnabled(0);
+			d->previewBox->setEnabled(0);
 			d->reverseClippingPlaneButton->setEnabled(0);
 		    d->reverseDepthPlaneButton->setEnabled(0);
 		}
@@ -433,6 +492,8 @@ void qSlicerSmartModelClipModuleWidget::setButtonState()
 			d->hidePlaneBox->setEnabled(1);
 			d->depthButton->setEnabled(1);
 			d->clipButton->setEnabled(1);
+			d->batchClipButton->setEnabled(1);
+			d->previewBox->setEnabled(1);
 			d->reverseClippingPlaneButton->setEnabled(1);
 		    d->reverseDepthPlaneButton->setEnabled(1);
 		}
@@ -442,39 +503,132 @@ void qSlicerSmartModelClipModuleWidget::setButtonState()
 void qSlicerSmartModelClipModuleWidget::reverseClippingPlane()
 {
 	isReversedClippingPlane = !isReversedClippingPlane;
+	storePlaneChain();
+	updatePreview();
     MessageBox(NULL,"The direction of the clipping plane has been successfully reversed\n Press the \"Clip the Model\" button to clip the model.","Message", MB_OKCANCEL );
 }
 
 void qSlicerSmartModelClipModuleWidget::reverseDepthPlane()
 {
-	isReversedDepthPlane = !isReversedDepthPlane;
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	try{
-	double* point1=DepthPlaneWidget->GetPoint1();
-	double* point2=DepthPlaneWidget->GetPoint2();
-	double savePoint1[3];
-	savePoint1[0]=point1[0];
-	savePoint1[1]=point1[1];
-	savePoint1[2]=point1[2];
+	if(d->depthButton->text() != tr("Remove Depth Plane"))
+	{
+		MessageBox(NULL,"No depth plane found\n Press \"Create Depth plane\" button to create a depth plane.","Error Message", MB_ICONHAND );
+		return;
+	}
 
-	DepthPlaneWidget->SetPoint1(point2);
-	DepthPlaneWidget->SetPoint2(savePoint1);
+	//the plane chain flips the normal of the depth plane when it is reversed
+	isReversedDepthPlane = !isReversedDepthPlane;
+	storePlaneChain();
+	updatePreview();
 	MessageBox(NULL,"The direction of the Depth plane has been successfully reversed\n Press the \"Clip the Model\" button to clip the model.","Message", MB_OKCANCEL );
+}
+
+void qSlicerSmartModelClipModuleWidget::clip()
+{
+	Q_D(qSlicerSmartModelClipModuleWidget);
+
+	clipNodeIDs.clear();
+	clipNodeIDs.append(d->clipNodeComboBox->currentNodeId());
+	requestClip();
+}
+
+// clip every checked model with the same planes in one pass
+void qSlicerSmartModelClipModuleWidget::batchClip()
+{
+	Q_D(qSlicerSmartModelClipModuleWidget);
+
+	clipNodeIDs.clear();
+	foreach(vtkMRMLNode* node, d->batchNodeComboBox->checkedNodes())
+		clipNodeIDs.append(node->GetID());
+	requestClip();
+}
+
+void qSlicerSmartModelClipModuleWidget::requestClip()
+{
+	if(clipWatcher.isRunning())
+	{
+		//latest wins: the stale clip is stopped and this one starts as soon as it has stopped
+		vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->AbortClip();
+		clipPending = true;
+		return;
 	}
-	catch(...)
+	startClip();
+}
+
+void qSlicerSmartModelClipModuleWidget::cancelClip()
+{
+	clipPending = false;
+	vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->AbortClip();
+}
+
+// write the stage timings of the clips of the session, in the format chosen by the user
+void qSlicerSmartModelClipModuleWidget::exportTimings()
+{
+	QString jsonFilter = tr("Statistics (*.json)");
+	QString csvFilter = tr("Statistics table (*.csv)");
+	QString traceFilter = tr("Chrome trace (*.trace.json)");
+	QString selectedFilter;
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Export Timings"), QString(),
+		jsonFilter + ";;" + csvFilter + ";;" + traceFilter, &selectedFilter);
+	if(fileName.isEmpty())
+		return;
+
+	vtkOsteotomyClipProfiler* profiler = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->GetProfiler();
+	bool written;
+	if(selectedFilter == traceFilter)
+		written = profiler->WriteTrace(fileName.toLocal8Bit().data());
+	else if(selectedFilter == csvFilter)
+		written = profiler->WriteCSV(fileName.toLocal8Bit().data());
+	else
+		written = profiler->WriteJSON(fileName.toLocal8Bit().data());
+	if(!written)
+		QMessageBox::warning(this, tr("Export Timings"), tr("Cannot write %1").arg(fileName));
+}
+
+// write the planes as startClip() clips them, with the Point2 of the last plane moved onto
+// the previous path, so that the batch clipper gives the cut of the module
+void qSlicerSmartModelClipModuleWidget::exportPlaneChain()
+{
+	if(numOfPlanes==0)
 	{
-		MessageBox(NULL,"No depth plane found\n Press \"Create Depth plane\" button to create a depth plane.","Error Message", MB_ICONHAND );
+		QMessageBox::warning(this, tr("Export Plan"), tr("There are no planes to export"));
+		return;
+	}
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Export Plan"), QString(),
+		tr("Plane chain (*.txt)"));
+	if(fileName.isEmpty())
 		return;
+
+	//the widgets are left as they are, only the written chain is adjusted
+	updatePlaneChain();
+	vtkSmartPointer<vtkOsteotomyPlaneChain> chain = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+	chain->DeepCopy(planeChain);
+	if(numOfPlanes>2)
+	{
+		double *newPoint=CalIntersectionPointOfPlaneAndLine(numOfPlanes-1);
+		chain->SetPoint2(numOfPlanes-1,newPoint);
+		delete []newPoint;
 	}
+	if(!chain->WriteSpecification(fileName.toLocal8Bit().data()))
+		QMessageBox::warning(this, tr("Export Plan"), tr("Cannot write %1").arg(fileName));
 }
 
-void qSlicerSmartModelClipModuleWidget::clip()
+void qSlicerSmartModelClipModuleWidget::updateClipProgress()
 {
 	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	vtkSmartPointer<vtkClipPolyData> clipper=vtkSmartPointer<vtkClipPolyData>::New();
-	clipper->GenerateClippedOutputOn();
-	this->timesOfClip++;
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	d->clipProgressBar->setValue(static_cast<int>(100 * logic->GetClipProgress()));
+}
+
+// snapshot the model and the plane chain, then clip them on a worker thread
+void qSlicerSmartModelClipModuleWidget::startClip()
+{
+	Q_D(qSlicerSmartModelClipModuleWidget);
+
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
 	
 	if(numOfPlanes>2)
 	{
@@ -483,181 +637,144 @@ void qSlicerSmartModelClipModuleWidget::clip()
 		planeList.last()->SetPoint2(newPoint);
 		delete []newPoint;
 	}
-	//obtain the source model for clipping
+	//obtain the source models for clipping
 	qSlicerApplication *app = qSlicerApplication::application();
 	vtkMRMLScene *mrmlScene = app->mrmlScene();
-	QString nodeID;
-	char *charNodeID;
-	nodeID = d->clipNodeComboBox->currentNodeId();
-	charNodeID = nodeID.toLatin1().data();
-	vtkMRMLNode *sourceNode = mrmlScene->GetNodeByID(charNodeID);
-	vtkSmartPointer<vtkMRMLModelNode> sourceModel = vtkSmartPointer<vtkMRMLModelNode>::New();
-	sourceModel->Copy(sourceNode);    //Copy the node's attributes to this object.
-	vtkSmartPointer<vtkPolyData> sourcePolyData = vtkSmartPointer<vtkPolyData>::New();
-	sourcePolyData->DeepCopy(sourceModel->GetPolyData());   //Shallow and Deep copy.
-	clipper->SetInput(sourcePolyData);
-
-	long start = 0;  
-    long end = 0;  
-
-	//start = clock();  
-  LARGE_INTEGER m_liPerfFreq = {0};  
-  QueryPerformanceFrequency( &m_liPerfFreq );  
-  
-  LARGE_INTEGER m_liPerfStart = {0};  
-  QueryPerformanceCounter( &m_liPerfStart );    
-
-	if(!isReversedClippingPlane && !isReversedDepthPlane)
-	{
-		clipper->SetClipFunction(SetClipDepth(makeBody(determineFirstPlaneOfClipping(),numOfPlanes-1))); 
-	}
-	else if(isReversedClippingPlane && !isReversedDepthPlane)
+	vtkSmartPointer<vtkCollection> sources = vtkSmartPointer<vtkCollection>::New();
+	vtkSmartPointer<vtkCollection> reservedParts = vtkSmartPointer<vtkCollection>::New();
+	vtkSmartPointer<vtkCollection> clippedParts = vtkSmartPointer<vtkCollection>::New();
+	QStringList sourceNames;
+	foreach(QString nodeID, clipNodeIDs)
 	{
-		clipper->SetClipFunction(makeBody(determineFirstPlaneOfClipping(),numOfPlanes-1)); 
-		clipper->InsideOutOn();
-		vtkImplicitFunction* temptImplicitFunction=clipper->GetClipFunction();
-		clipper->SetClipFunction(SetClipDepth(temptImplicitFunction));
+		vtkMRMLModelNode *sourceModel = vtkMRMLModelNode::SafeDownCast(mrmlScene->GetNodeByID(nodeID.toLatin1().data()));
+		if(!sourceModel || !sourceModel->GetPolyData())
+			continue;
+		//the clipper only reads its input, so the worker shares the arrays of the source model
+		vtkSmartPointer<vtkPolyData> sourcePolyData = vtkSmartPointer<vtkPolyData>::New();
+		sourcePolyData->ShallowCopy(sourceModel->GetPolyData());
+		sources->AddItem(sourcePolyData);
+		reservedParts->AddItem(vtkSmartPointer<vtkPolyData>::New());
+		clippedParts->AddItem(vtkSmartPointer<vtkPolyData>::New());
+		sourceNames.append(sourceModel->GetName());
 	}
-	else if(!isReversedClippingPlane && isReversedDepthPlane)
-	{
-		clipper->SetClipFunction(SetClipDepth(makeBody(determineFirstPlaneOfClipping(),numOfPlanes-1))); 
-	}
-	else
-	{
-		clipper->SetClipFunction(makeBody(determineFirstPlaneOfClipping(),numOfPlanes-1)); 
-		clipper->InsideOutOn();
-		vtkImplicitFunction* temptImplicitFunction=clipper->GetClipFunction();
-		clipper->SetClipFunction(SetClipDepth(temptImplicitFunction));
-	}
-	//int time = start - end;  
-    //TCHAR   buffer[100];  
-    //wsprintf(buffer, L"Еrg   %d   millisecond   ",time);   
-    //MessageBox(NULL,buffer, L"Ӌrg ",MB_OK);  
-	//QueryPerformanceCounter(&EndTime);    
- //   double realTime=(double)( EndTime.QuadPart - BegainTime.QuadPart )/ Frequency.QuadPart;
-
-	//		char str[32];
-	//		TCHAR  buffer[200]; 
-	//		double realTime=double(end-start)/CLOCKS_PER_SEC;
-	//	sprintf( buffer, "%d", realTime );
-
-	//	::MessageBox(NULL,buffer,"Error Message",MB_OK);
-
-	  LARGE_INTEGER liPerfNow = {0};  
-  QueryPerformanceCounter( &liPerfNow );  
-  
-  int time1=( ((liPerfNow.QuadPart - m_liPerfStart.QuadPart) * 1000000)/m_liPerfFreq.QuadPart);   
-  /*TCHAR buffer[100];  
-  wsprintf(buffer, L"ִʱ %d millisecond   ",time);   
-  MessageBox(NULL,buffer, L"ʱ ",MB_OK);   */
-  //		char buffer1[100];
-  //		//sprintf( buffer1, "%d", time );
-		//wsprintf(buffer1, "ִʱ %d millisecond   ",time);   
-		//MessageBox(NULL,buffer1,"us",MB_OK);
-
-	clipper->Update();	
-
-	vtkSmartPointer<vtkPolyData> reservedPolyData = vtkSmartPointer<vtkPolyData>::New();
-	vtkSmartPointer<vtkPolyData> clippedPolyData = vtkSmartPointer<vtkPolyData>::New();
-	reservedPolyData->DeepCopy(clipper->GetOutput());
-	this->reservedList.append(reservedPolyData);
-	clippedPolyData->DeepCopy(clipper->GetClippedOutput());
-	this->clippedList.append(clippedPolyData);
-
-	QueryPerformanceCounter( &liPerfNow );  
-	int time2=( ((liPerfNow.QuadPart - m_liPerfStart.QuadPart) * 1000000)/m_liPerfFreq.QuadPart);   
-
-			//display and store the result model
-	vtkSmartPointer<vtkMRMLModelNode> resultModel = vtkSmartPointer<vtkMRMLModelNode>::New();
-	QString resultName = tr("Reserved Part_");
-	resultName.append(QString::number(this->timesOfClip));
-	resultModel->SetName(resultName.toLatin1().data());
-	resultModel->SetAndObservePolyData(this->reservedList.at(this->timesOfClip - 1));
-	//resultModel->SetAndObservePolyData(reservedPolyData);
-	//mrmlScene->SaveStateForUndo();
-	resultModel->SetScene(mrmlScene);
-
-	QueryPerformanceCounter( &liPerfNow );  
-	int time3=( ((liPerfNow.QuadPart - m_liPerfStart.QuadPart) * 1000000)/m_liPerfFreq.QuadPart);   
-
-	vtkSmartPointer<vtkMRMLModelDisplayNode> resultDisplay = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
-	vtkSmartPointer<vtkMRMLModelStorageNode> resultStorage = vtkSmartPointer<vtkMRMLModelStorageNode>::New();
-	resultDisplay->SetScene(mrmlScene);
-	resultStorage->SetScene(mrmlScene);
-	resultDisplay->SetInputPolyData(resultModel->GetPolyData());
-	resultDisplay->SetColor(1.0, 0.0, 0.0);
-	resultStorage->SetFileName(resultName.toLatin1().data());
-	mrmlScene->AddNode(resultDisplay);
-	mrmlScene->AddNode(resultStorage);
-	resultModel->SetAndObserveDisplayNodeID(resultDisplay->GetID());
-	resultModel->SetAndObserveStorageNodeID(resultStorage->GetID());
-
-	QueryPerformanceCounter( &liPerfNow );  
-	int time4=( ((liPerfNow.QuadPart - m_liPerfStart.QuadPart) * 1000000)/m_liPerfFreq.QuadPart);   
-
-	//	display and store the clipped model
-	vtkSmartPointer<vtkMRMLModelNode> clippedModel =
-		vtkSmartPointer<vtkMRMLModelNode>::New();
-	QString clippedName = tr("Clipped Part_");
-	clippedName.append(QString::number(this->timesOfClip));
-	clippedModel->SetName(clippedName.toLatin1().data());
-	clippedModel->SetAndObservePolyData(this->clippedList.at(this->timesOfClip - 1));
-	//clippedModel->SetAndObservePolyData(clippedPolyData);
-	//mrmlScene->SaveStateForUndo();
-	clippedModel->SetScene(mrmlScene);
-
-	QueryPerformanceCounter( &liPerfNow );  
-	int time5=( ((liPerfNow.QuadPart - m_liPerfStart.QuadPart) * 1000000)/m_liPerfFreq.QuadPart);   
-
-
-	vtkSmartPointer<vtkMRMLModelDisplayNode> clippedDisplay =
-		vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
-	vtkSmartPointer<vtkMRMLModelStorageNode> clippedStorage =
-		vtkSmartPointer<vtkMRMLModelStorageNode>::New();
-	clippedDisplay->SetScene(mrmlScene);
-	clippedStorage->SetScene(mrmlScene);
-	clippedDisplay->SetInputPolyData(clippedModel->GetPolyData());
-	clippedDisplay->SetColor(0.0, 1.0, 0.0);
-	clippedStorage->SetFileName(clippedName.toLatin1().data());
-	mrmlScene->AddNode(clippedDisplay);
-	mrmlScene->AddNode(clippedStorage);
-	clippedModel->SetAndObserveDisplayNodeID(clippedDisplay->GetID());
-	clippedModel->SetAndObserveStorageNodeID(clippedStorage->GetID());
-
-	mrmlScene->AddNode(resultModel);
-	mrmlScene->AddNode(clippedModel);
-
-    QueryPerformanceCounter( &liPerfNow );  
-  
-  int time6=( ((liPerfNow.QuadPart - m_liPerfStart.QuadPart) * 1000000)/m_liPerfFreq.QuadPart);   
-  //char buffer5[100];
-  //sprintf( buffer5, "%d", time );
-
-  //::MessageBox(NULL,buffer5,"Error Message",MB_OK);
-   //ofstream outfile("file.txt", ios::app);
-   ofstream outfile("file.txt",ios::app);
-   //FILE *fp= fopen("file.txt");
-  //FILE * outfile;
-  //outfile = fopen ( "file.txt" , "w" );
-
-  if(outfile.is_open())
-{
-   	outfile.seekp(0,ios::end);
-	if((size_t)outfile.tellp()==0)
-		outfile<<"numOfPlanes"<<"\t"<<"timeOfAlgorithm"<<"\t"<<"\t"<<"timeOfClip"<<endl;
-	
-  //outfile<<numOfPlanes<<"\t"<<"\t"<<time1<<"\t"<<"\t"<<"\t"<<time2<<endl;    //messageǳд
-  outfile<<numOfPlanes<<"\t"<<time1<<"\t"<<time2<<"\t"<<time3<<"\t"<<time4<<"\t"<<time5<<"\t"<<time6<<endl;    //messageǳд
-  outfile.close();
+	if(sources->GetNumberOfItems() == 0)
+		return;
+
+	storePlaneChain();
+
+	//the worker gets its own copy of the chain, so the widgets can keep moving
+	clipSources = sources;
+	clipSourceNames = sourceNames;
+	clipChain->DeepCopy(planeChain);
+	clipReservedParts = reservedParts;
+	clipClippedParts = clippedParts;
+
+	d->clipProgressBar->setValue(0);
+	d->clipProgressBar->setVisible(1);
+	d->cancelClipButton->setVisible(1);
+	clipProgressTimer.start();
+	logic->ResetAbortClip();
+	clipWatcher.setFuture(QtConcurrent::run(logic, &vtkSlicerSmartModelClipLogic::ClipModels,
+		clipSources.GetPointer(), clipChain.GetPointer(), clipReservedParts.GetPointer(), clipClippedParts.GetPointer()));
 }
-else
+
+// publish the results of the clip to the scene in one batch, on the main thread
+void qSlicerSmartModelClipModuleWidget::onClipFinished()
 {
-  cout<<"ܴļ!"<<endl;
-}
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
+	clipProgressTimer.stop();
+	d->clipProgressBar->setVisible(0);
+	d->cancelClipButton->setVisible(0);
+	clipSources = 0;
 
+	if(clipPending)
+	{
+		clipPending = false;
+		startClip();
+		return;
+	}
+	if(!clipWatcher.result())
+		return;  //cancelled or failed
 
-	
+	qSlicerApplication *app = qSlicerApplication::application();
+	vtkMRMLScene *mrmlScene = app->mrmlScene();
+	this->timesOfClip++;
+
+	//the parts of every model are added in one batch, so the views are updated once
+	int numOfModels = clipReservedParts->GetNumberOfItems();
+	vtkOsteotomyClipProfiler* profiler = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->GetProfiler();
+	vtkOsteotomyClipProfiler::ScopedTimer nodeTimer(profiler, vtkOsteotomyClipProfiler::NodeCreation);
+	mrmlScene->StartState(vtkMRMLScene::BatchProcessState);
+	for(int i=0;i<numOfModels;i++)
+	{
+		//display and store the result model
+		vtkSmartPointer<vtkMRMLModelNode> resultModel = vtkSmartPointer<vtkMRMLModelNode>::New();
+		QString resultName = tr("Reserved Part_");
+		resultName.append(QString::number(this->timesOfClip));
+		if(numOfModels > 1)
+			resultName.append("_").append(clipSourceNames.at(i));
+		resultModel->SetName(resultName.toLatin1().data());
+		resultModel->SetAndObservePolyData(vtkPolyData::SafeDownCast(clipReservedParts->GetItemAsObject(i)));
+		//resultModel->SetAndObservePolyData(reservedPolyData);
+		//mrmlScene->SaveStateForUndo();
+		resultModel->SetScene(mrmlScene);
+
+		vtkSmartPointer<vtkMRMLModelDisplayNode> resultDisplay = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
+		vtkSmartPointer<vtkMRMLModelStorageNode> resultStorage = vtkSmartPointer<vtkMRMLModelStorageNode>::New();
+		resultDisplay->SetScene(mrmlScene);
+		resultStorage->SetScene(mrmlScene);
+		resultDisplay->SetInputPolyData(resultModel->GetPolyData());
+		resultDisplay->SetColor(1.0, 0.0, 0.0);
+		resultStorage->SetFileName(resultName.toLatin1().data());
+		mrmlScene->AddNode(resultDisplay);
+		mrmlScene->AddNode(resultStorage);
+		resultModel->SetAndObserveDisplayNodeID(resultDisplay->GetID());
+		resultModel->SetAndObserveStorageNodeID(resultStorage->GetID());
+
+		//	display and store the clipped model
+		vtkSmartPointer<vtkMRMLModelNode> clippedModel =
+			vtkSmartPointer<vtkMRMLModelNode>::New();
+		QString clippedName = tr("Clipped Part_");
+		clippedName.append(QString::number(this->timesOfClip));
+		if(numOfModels > 1)
+			clippedName.append("_").append(clipSourceNames.at(i));
+		clippedModel->SetName(clippedName.toLatin1().data());
+		clippedModel->SetAndObservePolyData(vtkPolyData::SafeDownCast(clipClippedParts->GetItemAsObject(i)));
+		//clippedModel->SetAndObservePolyData(clippedPolyData);
+		//mrmlScene->SaveStateForUndo();
+		clippedModel->SetScene(mrmlScene);
+
+
+		vtkSmartPointer<vtkMRMLModelDisplayNode> clippedDisplay =
+			vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
+		vtkSmartPointer<vtkMRMLModelStorageNode> clippedStorage =
+			vtkSmartPointer<vtkMRMLModelStorageNode>::New();
+		clippedDisplay->SetScene(mrmlScene);
+		clippedStorage->SetScene(mrmlScene);
+		clippedDisplay->SetInputPolyData(clippedModel->GetPolyData());
+		clippedDisplay->SetColor(0.0, 1.0, 0.0);
+		clippedStorage->SetFileName(clippedName.toLatin1().data());
+		mrmlScene->AddNode(clippedDisplay);
+		mrmlScene->AddNode(clippedStorage);
+		clippedModel->SetAndObserveDisplayNodeID(clippedDisplay->GetID());
+		clippedModel->SetAndObserveStorageNodeID(clippedStorage->GetID());
+
+		mrmlScene->AddNode(resultModel);
+		mrmlScene->AddNode(clippedModel);
+
+		addToClipHistory(resultModel);
+		addToClipHistory(clippedModel);
+	}
+	mrmlScene->EndState(vtkMRMLScene::BatchProcessState);
+	nodeTimer.Stop();
+	updateClipHistoryVisibility();
+	clipReservedParts = 0;
+	clipClippedParts = 0;
+
+	//render the new parts now, so that their display is timed with the clip
+	vtkOsteotomyClipProfiler::ScopedTimer displayTimer(profiler, vtkOsteotomyClipProfiler::Display);
+	renderWindow->Render();
 }
 
 // ---------------------------TOOLS USED TO CREATE A PLANE----------------------------------
@@ -668,51 +785,20 @@ double* qSlicerSmartModelClipModuleWidget::
 	CalculatePoint2CoordinatesOfFirstTwoPlanes(double* newPlaneOrigin,double* newPlanePoint1,double* newPlanePoint2)
 {
 	double* newPoint2=new double[3];
-	double vectorFromPointOriginTOPoint1[3];
-	double vectorFromPointOriginTOPoint2[3];
-	vtkMath::Subtract(newPlanePoint1,newPlaneOrigin,vectorFromPointOriginTOPoint1);
-	vtkMath::Subtract(newPlanePoint2,newPlaneOrigin,vectorFromPointOriginTOPoint2);
-
-	double tempt = vtkMath::Dot(vectorFromPointOriginTOPoint1,vectorFromPointOriginTOPoint2)
-		/vtkMath::Norm(vectorFromPointOriginTOPoint1)/vtkMath::Norm(vectorFromPointOriginTOPoint1);
-	vtkMath::MultiplyScalar(vectorFromPointOriginTOPoint1,tempt);
-	vtkMath::Subtract(vectorFromPointOriginTOPoint2,vectorFromPointOriginTOPoint1,vectorFromPointOriginTOPoint2);
-	vtkMath::Add(vectorFromPointOriginTOPoint2,newPlaneOrigin,newPoint2); 
+	vtkOsteotomyPlaneChain::CalculatePoint2CoordinatesOfFirstTwoPlanes(
+		newPlaneOrigin,newPlanePoint1,newPlanePoint2,newPoint2);
 	return newPoint2;
 }
 
-// get the position of a fiducial and return its coordinates.The function returns 0 if no fiducial is on the scenery.
+// get the position of the next fiducial and return its coordinates.The function returns 0 if no more fiducial is on the scenery.
+// numOfFiducials is the number of fiducials already used by planes, the fiducials are taken in the order they were placed
 double* qSlicerSmartModelClipModuleWidget::getPositionOfFiducials()
 {
-	Q_D(qSlicerSmartModelClipModuleWidget);
-	int tempt=numOfFiducials; //use this variable to prevent the situation that numOfFiducials count but actually there's no more fiducials
-	tempt++;
-
-	qSlicerApplication *app = qSlicerApplication::application();
-	vtkMRMLScene *mrmlScene = app->mrmlScene();
-	QString fiducialsID = tr("vtkMRMLAnnotationFiducialNode");
-	fiducialsID.append(QString::number(tempt));
-
-	int loopTimes=0;
-	double *data;
-	
-	while(loopTimes<50)
-	{
-		try{
-			vtkMRMLAnnotationFiducialNode* m_fnode1=vtkMRMLAnnotationFiducialNode::SafeDownCast(mrmlScene->GetNodeByID(fiducialsID.toLatin1().data()));
-			data=m_fnode1->GetFiducialCoordinates();
-			numOfFiducials=tempt;    //if there's no more fiducials,this block goes to catch(...),so numOfFiducials changes only when there's indeed a fiducial
-			return data;
-		}
-		catch(...)
-		{
-			tempt++;
-			fiducialsID = tr("vtkMRMLAnnotationFiducialNode");
-			fiducialsID.append(QString::number(tempt));
-		}
-		loopTimes++;
-	}
-	return 0;  //hasn't found any subsequent fiducials,return null
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	double *data=logic->GetFiducialPosition(numOfFiducials);
+	if(data)
+		numOfFiducials++;    //numOfFiducials changes only when there's indeed a fiducial
+	return data;
 }
 
 // calculate the intersection point of the plane(which pass through Origin of plane m-2,
@@ -721,370 +807,385 @@ double* qSlicerSmartModelClipModuleWidget::getPositionOfFiducials()
 // We do this because it's convenient to judge whether the plane m is intersected with the previous plane
 double* qSlicerSmartModelClipModuleWidget::CalIntersectionPointOfPlaneAndLine(int m)
 {
-	//the second last plane previous the plane m
-	double* SLPO = planeList.at(m-2)->GetOrigin();
-	double* SLP2 = planeList.at(m-2)->GetPoint2();  
-	//previous plane of the plane m
-	double* PP2 = planeList.at(m-1)->GetPoint2();
-	//plane m
-	double *P2=planeList.at(m)->GetPoint2();
-	double *P3=planeList.at(m)->GetPoint3();
-
-   double *SLPO2 = new double[3];
-	vtkMath::Subtract(
-	this->planeList.at(m-2)->GetPoint2(),
-	this->planeList.at(m-2)->GetOrigin(),SLPO2);
-	double *PPO2 = new double[3];
-	vtkMath::Subtract(
-	this->planeList.at(m-1)->GetPoint2(),
-	this->planeList.at(m-1)->GetOrigin(),PPO2);
-
-	double *norm = new double[3];
-	vtkMath::Cross(SLPO2,PPO2,norm);
-
-	double *lineVector =new double[3];
-	vtkMath::Subtract(P2,P3,lineVector);
-
-	double *temp=new double[3];
-	vtkMath::Subtract(SLPO,P3,temp);
-
-	double t =vtkMath::Dot(norm,temp) /vtkMath::Dot(norm,lineVector);
-
 	double *Point = new double[3];
-	Point[0]=P3[0]+lineVector[0]*t;
-	Point[1]=P3[1]+lineVector[1]*t;
-	Point[2]=P3[2]+lineVector[2]*t;
-
-	delete []SLPO2;
-	delete []PPO2;
-	delete []norm;
-	delete []lineVector;
-	delete []temp;
-
+	vtkOsteotomyPlaneChain::CalIntersectionPointOfPlaneAndLine(
+		planeList.at(m-2)->GetOrigin(),planeList.at(m-2)->GetPoint2(),
+		planeList.at(m-1)->GetOrigin(),planeList.at(m-1)->GetPoint2(),
+		planeList.at(m)->GetPoint2(),planeList.at(m)->GetPoint3(),Point);
 	return Point;
 }
 
-
-//---------------------------TOOLS USED TO CLIP THE MODEL-----------------------------------
-
-//The algorithm of model clipping is based on recursion
-vtkSmartPointer<vtkImplicitBoolean> qSlicerSmartModelClipModuleWidget:: makeBody(int m,int n)
+// copy the corners of the plane widgets, the depth plane and the reverse flags into planeChain
+void qSlicerSmartModelClipModuleWidget::updatePlaneChain()
 {
-	vtkSmartPointer<vtkImplicitBoolean> temptBody = vtkSmartPointer<vtkImplicitBoolean>::New();
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	if(m==n)
-	{
-		temptBody->AddFunction(planeList.at(m)->GetPlane());
-		return temptBody;
-	}
-	else if((n-m)==1)
+	while(planeChain->GetNumberOfPlanes()>numOfPlanes)
+		planeChain->RemoveLastPlane();
+
+	for(int i=0;i<numOfPlanes;i++)
 	{
-		if(isPlaneInside(n))
-			temptBody->SetOperationTypeToIntersection();
+		vtkQuadPlaneWidget* plane=planeList.at(i);
+		if(i<planeChain->GetNumberOfPlanes())
+			planeChain->SetPlane(i,plane->GetOrigin(),plane->GetPoint1(),plane->GetPoint2(),plane->GetPoint3());
 		else
-			temptBody->SetOperationTypeToUnion();
-		temptBody->AddFunction(planeList.at(m)->GetPlane());
-		temptBody->AddFunction(planeList.at(n)->GetPlane());
-		return temptBody;
+			planeChain->AddPlane(plane->GetOrigin(),plane->GetPoint1(),plane->GetPoint2(),plane->GetPoint3());
 	}
+
+	if(d->depthButton->text() == tr("Remove Depth Plane"))
+		planeChain->SetDepthPlane(DepthPlaneWidget->GetOrigin(),DepthPlaneWidget->GetPoint1(),
+			DepthPlaneWidget->GetPoint2(),DepthPlaneWidget->GetPoint3());
 	else
-	{
-		int i=n;
-		while (isIntersect1(m,i) || isIntersect2(i-1,n))
-		{
-			i--;
-			if((i-m)==1)
-				break;
-		}
-		//char str[32];
-		//sprintf( str, "%d", i );
+		planeChain->RemoveDepthPlane();
 
-		//::MessageBox(NULL,str,"Error Message",MB_ICONHAND);
+	planeChain->SetReverseClipping(isReversedClippingPlane);
+	planeChain->SetReverseDepthPlane(isReversedDepthPlane);
+}
 
-		if(isPlaneInside(i))
-			temptBody->SetOperationTypeToIntersection();
-		else 
-			temptBody->SetOperationTypeToUnion();
+// keep the selected osteotomy plan in step with the plane widgets, so that it is saved with the scene;
+// a plan is created if none is selected
+void qSlicerSmartModelClipModuleWidget::storePlaneChain()
+{
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-		temptBody->AddFunction(makeBody(m,i-1));
-		temptBody->AddFunction(makeBody(i,n));
-		return temptBody;
-	}
+	updatePlaneChain();
+	if(numOfPlanes==0)
+		return;  //the plan keeps its planes until new ones are placed
+
+	storingPlaneChain = true;
+	vtkMRMLOsteotomyPlaneChainNode* node =
+		vtkMRMLOsteotomyPlaneChainNode::SafeDownCast(d->planeChainNodeComboBox->currentNode());
+	if(!node)
+		node = vtkMRMLOsteotomyPlaneChainNode::SafeDownCast(d->planeChainNodeComboBox->addNode());
+	vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->UpdateNodeFromPlaneChain(planeChain, node);
+	storingPlaneChain = false;
 }
 
-//Specify the depth plane to clip the model 
-vtkSmartPointer<vtkImplicitBoolean> qSlicerSmartModelClipModuleWidget::
-	SetClipDepth(vtkSmartPointer<vtkImplicitFunction> clipFunction)
+// rebuild the plane widgets of a plan from its corners, without looking for fiducials,
+// and render the view once all of them are placed
+void qSlicerSmartModelClipModuleWidget::restorePlaneChain(vtkMRMLNode* node)
 {
 	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	vtkSmartPointer<vtkImplicitBoolean> bodyWithDepth = 
-		vtkSmartPointer<vtkImplicitBoolean>::New();
-	if (d->depthButton->text() == tr("Remove Depth Plane")) 
+	vtkMRMLOsteotomyPlaneChainNode* planNode = vtkMRMLOsteotomyPlaneChainNode::SafeDownCast(node);
+	if(storingPlaneChain || !planNode || planNode->GetNumberOfPlanes()==0)
+		return;  //an empty plan takes the current planes at their next change
+
+	vtkSmartPointer<vtkOsteotomyPlaneChain> plan = vtkSmartPointer<vtkOsteotomyPlaneChain>::New();
+	vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->UpdatePlaneChainFromNode(planNode, plan);
+
+	clearPlanes();
+	renderWindowInteractor->Initialize();
+	for(int i=0;i<plan->GetNumberOfPlanes();i++)
 	{
-		vtkSmartPointer<vtkPlane> depthFunction = 
-			vtkSmartPointer<vtkPlane>::New();
-		DepthPlaneWidget->GetPlane(depthFunction);
-		bodyWithDepth->SetOperationTypeToIntersection();
-		bodyWithDepth->AddFunction(clipFunction);
-		bodyWithDepth->AddFunction(depthFunction);
-	} 
-	else 
+		if(i==0)
+			planeWidget = vtkQuadPlaneWidgetPlus::New();
+		else
+		{
+			planeWidget = vtkSpinningPlaneWidget::New();
+			(i%2 == 1)?planeWidget->SetPlaneColor(0.6,0.3,0.8):planeWidget->SetPlaneColor(1,1,1);
+		}
+		planeWidget->SetOrigin(plan->GetOrigin(i));
+		planeWidget->SetPoint1(plan->GetPoint1(i));
+		planeWidget->SetPoint2(plan->GetPoint2(i));
+		planeWidget->SetPoint3(plan->GetPoint3(i));
+		planeWidget->SetInteractor(renderWindowInteractor);
+		planeWidget->MergedGlyphsOn();
+		planeWidget->On();
+		//only the last plane can be moved, as when the planes are placed one by one
+		if(i<plan->GetNumberOfPlanes()-1)
+			planeWidget->SetHandlesVisibility(0);
+		observePlaneWidget(planeWidget);
+		planeList.append(planeWidget);
+	}
+	numOfPlanes = plan->GetNumberOfPlanes();
+	if(numOfPlanes > 1)
+		dynamic_cast<vtkQuadPlaneWidgetPlus*>(planeList.at(0))->planeFixing(1);
+	//three fiducials were taken by the first plane and one by each other plane
+	numOfFiducials = numOfPlanes + 2;
+
+	if(plan->GetHasDepthPlane())
 	{
-		bodyWithDepth->AddFunction(clipFunction);
+		DepthPlaneWidget = vtkQuadPlaneWidgetPlus::New();
+		DepthPlaneWidget->SetPlaneColor(0.8,0.4,0.2);
+		DepthPlaneWidget->SetOrigin(plan->GetDepthPlaneOrigin());
+		DepthPlaneWidget->SetPoint1(plan->GetDepthPlanePoint1());
+		DepthPlaneWidget->SetPoint2(plan->GetDepthPlanePoint2());
+		DepthPlaneWidget->SetPoint3(plan->GetDepthPlanePoint3());
+		DepthPlaneWidget->SetRepresentationToSurface();
+		DepthPlaneWidget->SetInteractor(renderWindowInteractor);
+		DepthPlaneWidget->On();
+		observePlaneWidget(DepthPlaneWidget);
+		d->depthButton->setText(tr("Remove Depth Plane"));
 	}
-		return bodyWithDepth;
+	isReversedClippingPlane = plan->GetReverseClipping();
+	isReversedDepthPlane = plan->GetReverseDepthPlane();
+
+	renderWindow->Render();
+	setButtonState();
+	updatePlaneChain();
+	updatePreview();
 }
 
-// If the last plane's line segment is intersected with its previous planes' line segments twice,we define the 
-// first plane Of clipping model is the larger sequence number.Or we define the first plane Of clipping model 
-// is the plane 0
-int qSlicerSmartModelClipModuleWidget::determineFirstPlaneOfClipping()
+// ---------------------------------CLIP HISTORY---------------------------------------------
+
+void qSlicerSmartModelClipModuleWidget::addToClipHistory(vtkMRMLModelNode* model)
 {
-	if(numOfPlanes<4)
-		return 0;
-	else
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	int id = logic->GetClipHistory()->AddEntry(model->GetPolyData());
+	historyModelNodes[model] = id;
+	qvtkConnect(model, vtkCommand::DeleteEvent, this, SLOT(onResultNodeDeleted(vtkObject*)));
+
+	vtkMRMLDisplayNode* display = model->GetDisplayNode();
+	if(display)
 	{
-		int i=numOfPlanes-3;//numOfPlanes>=4;i>=1
-		int firstPlaneNum=0;
-		int intersectPlaneNum;
-		while(i>=0)
-		{
-			if(isInterSectWithTheSingleLineSegment(i))
-			{
-			    intersectPlaneNum=i;
-				if(firstPlaneNum==0)
-					firstPlaneNum=i;
-				if(intersectPlaneNum!=firstPlaneNum)
-					return firstPlaneNum;
-			}
-			i--;
-		}
-        return 0;  //return the  0th plane
+		historyDisplayNodes[display] = id;
+		qvtkConnect(display, vtkCommand::ModifiedEvent, this, SLOT(onResultDisplayModified(vtkObject*)));
 	}
 }
 
-// judge whether the plane i is inside plane i-1(i>=1)
-int qSlicerSmartModelClipModuleWidget::isPlaneInside(int i)
+// hide the results whose data has been compressed
+void qSlicerSmartModelClipModuleWidget::updateClipHistoryVisibility()
 {
-	double *oP2 = new double[3];
-	vtkMath::Subtract(
-		this->planeList.at(i)->GetPoint2(),
-		this->planeList.at(i)->GetOrigin(),
-		oP2);
-	double dot = vtkMath::Dot(
-		this->planeList.at(i-1)->GetNormal(),
-		oP2);
-	delete []oP2;
-	return (dot<0)?1:0;
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	QMap<vtkObject*, int>::const_iterator it;
+	for(it=historyDisplayNodes.constBegin();it!=historyDisplayNodes.constEnd();++it)
+	{
+		vtkMRMLDisplayNode* display = vtkMRMLDisplayNode::SafeDownCast(it.key());
+		if(logic->GetClipHistory()->IsCompressed(it.value()) && display->GetVisibility())
+			display->SetVisibility(0);
+	}
 }
 
-// extend a line segment on plane i,the line of which pass through Point2,
-// from the Origin on the plane to infinitive
-double* qSlicerSmartModelClipModuleWidget::extendLineSegment(int i)
+// showing a compressed result restores its data
+void qSlicerSmartModelClipModuleWidget::onResultDisplayModified(vtkObject* caller)
 {
-	double *pt2 = this->planeList.at(i)->GetPoint2();
-	double *o = this->planeList.at(i)->GetOrigin();
-	double *output = new double[3];
-	double *vector = new double[3];
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	vtkMRMLDisplayNode* display = vtkMRMLDisplayNode::SafeDownCast(caller);
+	if(!display || !historyDisplayNodes.contains(caller))
+		return;
 
-	vtkMath::Subtract(pt2, o, vector);
-	vtkMath::MultiplyScalar(vector, 100);
-	vtkMath::Add(vector, o, output);
+	int id = historyDisplayNodes.value(caller);
+	if(display->GetVisibility() && logic->GetClipHistory()->IsCompressed(id))
+	{
+		logic->GetClipHistory()->Restore(id);
+		updateClipHistoryVisibility();
+	}
+}
 
-	delete []vector;
-	return output;
+void qSlicerSmartModelClipModuleWidget::onResultNodeDeleted(vtkObject* caller)
+{
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	if(!historyModelNodes.contains(caller))
+		return;
+
+	int id = historyModelNodes.take(caller);
+	logic->GetClipHistory()->RemoveEntry(id);
+	QMutableMapIterator<vtkObject*, int> it(historyDisplayNodes);
+	while(it.hasNext())
+	{
+		if(it.next().value() == id)
+			it.remove();
+	}
 }
 
-// extend a line segment on plane i reversely,which pass through Origin,
-// from the Point2 on the plane to infinitive
-double* qSlicerSmartModelClipModuleWidget::reverseExtendLineSegment(int i)//the first plane is m
+// the storage nodes of compressed results would write empty models; the scene
+// writes every model at once, so the whole history is in memory until the save ends
+void qSlicerSmartModelClipModuleWidget::onSceneStartSave()
 {
-	double *pt2 = this->planeList.at(i)->GetPoint2();
-	double *o = this->planeList.at(i)->GetOrigin();
-	double *output = new double[3];
-	double *vector = new double[3];
-	vtkMath::Subtract(o,pt2,vector);
-	vtkMath::MultiplyScalar(vector, 100);
-	vtkMath::Add(vector, pt2, output);
-	delete []vector;
-	return output;
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	logic->GetClipHistory()->RestoreAllEntries();
 }
 
-// judge whether the plane i will intersect with the previous plane from plane m to plane i-2
-// the line segment of plane i is extended infinitely on both of the line segment direction
-bool qSlicerSmartModelClipModuleWidget::isIntersect1(int m,int i)
+void qSlicerSmartModelClipModuleWidget::onSceneEndSave()
 {
-	if ((i-m) == 1)
-		return false;
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	logic->GetClipHistory()->Trim();
+	updateClipHistoryVisibility();
+}
 
-	//	create a vtkPoints object and store the points in it
-	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
-	int numOfLines = i-m - 1;      //number of line segments
-	double* originExtend;
+// ---------------------------------LIVE PREVIEW---------------------------------------------
 
-	for (int j = m; j <= i-1; j++) 
+void qSlicerSmartModelClipModuleWidget::setPreviewEnabled(bool enabled)
+{
+	if(enabled)
 	{
-		if(j==m)
-		{
-			originExtend = reverseExtendLineSegment(m);
-			points->InsertNextPoint(originExtend);
-		    delete []originExtend;
-		}
-		else
-			points->InsertNextPoint(this->planeList.at(j)->GetOrigin());
+		//a release queued when the preview was turned off must not free the new pyramid
+		pyramidFuture.waitForFinished();
+		buildPreviewPyramid();
+		updatePreview();
+	}
+	else
+	{
+		previewPending = false;
+		removePreviewModel();
+		//the pyramid and the clipper caches hold several copies of the model; free them on a worker,
+		//since the logic serializes the release with the preview jobs
+		vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+		logic->AbortPreview();
+		pyramidFuture = QtConcurrent::run(logic, &vtkSlicerSmartModelClipLogic::ReleasePreview);
 	}
-
-
-	//	create a vtkPolyLine object and store the polyline in it
-	vtkSmartPointer<vtkPolyLine> polyLine = vtkSmartPointer<vtkPolyLine>::New();
-		polyLine->GetPoints()->DeepCopy(points);
-		polyLine->GetPointIds()->SetNumberOfIds(numOfLines+1);
-		for(int j = 0; j <=i-m-1; j++) 
-			polyLine->GetPointIds()->SetId(j, j);
-
-	double tolerance = 0.001;
-	double t;
-	double x[3];
-	double pcoords[3];
-	int subId;
-	int intersection;
-	int intersection2;
-
-	double* output = extendLineSegment(i);//iƽӳ
-	intersection = polyLine->IntersectWithLine(
-		this->planeList.at(i)->GetOrigin(),   
-		output, tolerance, t, x, pcoords, subId);
-
-	double* output2 = reverseExtendLineSegment(i);//iƽ淴ӳ
-	intersection2 = polyLine->IntersectWithLine(
-		this->planeList.at(i)->GetOrigin(),
-		output2, tolerance, t, x, pcoords, subId);
-
-	delete []output;
-	delete []output2;
-
-	if ((intersection2 != 0) || (intersection != 0))
-		return true;
-	else 
-		return false;
 }
 
-bool qSlicerSmartModelClipModuleWidget::isIntersect2(int a,int n)
+// called on every InteractionEvent of the plane widgets, so it must return at once
+void qSlicerSmartModelClipModuleWidget::updatePreview()
 {
-	if ((n-a) == 1)
-		return false;
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	//	create a vtkPoints object and store the points in it
-	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
-	int numOfLines = n-a - 1;      //number of line segments
-	double* lastExtend;
+	if(!d->previewBox->isChecked())
+		return;
 
-	for (int j = a+2; j <= n; j++) 
+	if(previewWatcher.isRunning())
 	{
-		points->InsertNextPoint(this->planeList.at(j)->GetOrigin());
-		if(j==n)
-		{
-			lastExtend = extendLineSegment(n);
-			points->InsertNextPoint(lastExtend);
-		    delete []lastExtend;
-		}	
+		//only the latest position matters, it is clipped as soon as the running clip ends
+		previewPending = true;
+		return;
 	}
+	startPreview(vtkSlicerSmartModelClipLogic::PreviewCoarse);
+}
 
+// decimate the selected model in the background, so that the first preview does not wait for it
+void qSlicerSmartModelClipModuleWidget::buildPreviewPyramid()
+{
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	//	create a vtkPolyLine object and store the polyline in it
-	vtkSmartPointer<vtkPolyLine> polyLine = vtkSmartPointer<vtkPolyLine>::New();
-		polyLine->GetPoints()->DeepCopy(points);
-		polyLine->GetPointIds()->SetNumberOfIds(numOfLines+1);
-		for(int j = 0; j <= numOfLines; j++) 
-			polyLine->GetPointIds()->SetId(j, j);
+	if(!d->previewBox->isChecked())
+		return;
+	vtkMRMLModelNode* sourceModel = vtkMRMLModelNode::SafeDownCast(d->clipNodeComboBox->currentNode());
+	if(!sourceModel || !sourceModel->GetPolyData())
+		return;
 
-	double tolerance = 0.001;
-	double t;
-	double x[3];
-	double pcoords[3];
-	int subId;
-	int intersection;
-	int intersection2;
+	//the job keeps its own reference to the poly data; the logic serializes it with the preview clips
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	pyramidFuture = QtConcurrent::run(logic, &vtkSlicerSmartModelClipLogic::BuildPreviewPyramid,
+		vtkSmartPointer<vtkPolyData>(sourceModel->GetPolyData()));
+}
 
-	double* output = extendLineSegment(a);//aƽӳ
-	intersection = polyLine->IntersectWithLine(
-		this->planeList.at(a)->GetOrigin(),   
-		output, tolerance, t, x, pcoords, subId);
+void qSlicerSmartModelClipModuleWidget::observePlaneWidget(vtkQuadPlaneWidget* widget)
+{
+	//the connections are removed by ctk when the widget is deleted
+	qvtkConnect(widget, vtkCommand::StartInteractionEvent, this, SLOT(onPlaneInteractionStarted()));
+	qvtkConnect(widget, vtkCommand::InteractionEvent, this, SLOT(updatePreview()));
+	qvtkConnect(widget, vtkCommand::EndInteractionEvent, this, SLOT(onPlaneInteractionEnded()));
+}
 
-	//double* output2 = reverseExtendLineSegment(a);//aƽ淴ӳ
-	//intersection2 = polyLine->IntersectWithLine(
-	//	this->planeList.at(n)->GetOrigin(),
-	//	output2, tolerance, t, x, pcoords, subId);
+void qSlicerSmartModelClipModuleWidget::onPlaneInteractionStarted()
+{
+	previewInteracting = true;
+	//a refinement of the last position is stale now; the first move previews the new one
+	if(previewWatcher.isRunning())
+		vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic())->AbortPreview();
+}
 
-	delete []output;
-	//delete []output2;
+// refine the preview of the released position up to the full resolution
+void qSlicerSmartModelClipModuleWidget::onPlaneInteractionEnded()
+{
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	
-	//if ((intersection2 != 0) || (intersection != 0))
-	if (intersection != 0)
-	{
-		//MessageBox(NULL,"1","Error Message",MB_ICONHAND);
-		return true;
-	}
-	else 
-	{
-		//MessageBox(NULL,"2","Error Message",MB_ICONHAND);
-		return false;
-	}
+	previewInteracting = false;
+	storePlaneChain();
+	if(!d->previewBox->isChecked() || previewWatcher.isRunning() || !previewModel)
+		return;  //onPreviewFinished() goes on with the refinement
+	if(previewLevel < vtkSlicerSmartModelClipLogic::PreviewFull)
+		startPreview(previewLevel + 1);
 }
 
-// If the last plane's line segment is intersected with its previous planes' line segments twice,we define the 
-// first plane Of clipping model is the larger sequence number.This function checks whteher the final plane's extended
-// line segment will intersected with the line segment of plane m.
-bool qSlicerSmartModelClipModuleWidget::isInterSectWithTheSingleLineSegment(int m)
+void qSlicerSmartModelClipModuleWidget::startPreview(int level)
 {
-	//	create a vtkPoints object and store the points in it
-	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
-	int numOfLines = 1;
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	double* originExtend;
-	if(m==0)
-	{
-		originExtend = reverseExtendLineSegment(m);
-		points->InsertNextPoint(originExtend);
-		points->InsertNextPoint(planeList.at(1)->GetOrigin());
-		delete []originExtend;
-	}
-	else
+	vtkMRMLModelNode* sourceModel = vtkMRMLModelNode::SafeDownCast(d->clipNodeComboBox->currentNode());
+	if(numOfPlanes==0 || !sourceModel || !sourceModel->GetPolyData())
 	{
-		points->InsertNextPoint(this->planeList.at(m)->GetOrigin());
-		points->InsertNextPoint(this->planeList.at(m)->GetPoint2());
+		removePreviewModel();
+		return;
 	}
+	if(!previewHiddenNodeID.isEmpty() && previewHiddenNodeID != sourceModel->GetID())
+		removePreviewModel();
+
+	//the worker gets its own copy of the chain, so the widgets can keep moving
+	updatePlaneChain();
+	previewChain->DeepCopy(planeChain);
+	previewSource = sourceModel->GetPolyData();
+
+	vtkSlicerSmartModelClipLogic* logic = vtkSlicerSmartModelClipLogic::SafeDownCast(this->logic());
+	previewLevel = level;
+	logic->ResetAbortPreview();
+	previewWatcher.setFuture(QtConcurrent::run(logic, &vtkSlicerSmartModelClipLogic::ClipPreview,
+		previewSource.GetPointer(), previewChain.GetPointer(), previewResult.GetPointer(), level));
+}
 
+void qSlicerSmartModelClipModuleWidget::onPreviewFinished()
+{
+	Q_D(qSlicerSmartModelClipModuleWidget);
 
-	//	create a vtkPolyLine object and store the polyline in it
-	vtkSmartPointer<vtkPolyLine> polyLine = vtkSmartPointer<vtkPolyLine>::New();
-	polyLine->GetPoints()->DeepCopy(points);
-	polyLine->GetPointIds()->SetNumberOfIds(numOfLines+1);
-	polyLine->GetPointIds()->SetId(0, 0);
-	polyLine->GetPointIds()->SetId(1, 1);
+	vtkMRMLScene *mrmlScene = qSlicerApplication::application()->mrmlScene();
+	if(previewModel && !mrmlScene->IsNodePresent(previewModel))
+		previewModel = 0;  //removed by the user
 
-	double tolerance = 0.001;
-	double t;
-	double x[3];
-	double pcoords[3];
-	int subId;
-	double* output = extendLineSegment(numOfPlanes-1);
-	int intersection = polyLine->IntersectWithLine(
-		this->planeList.at(numOfPlanes-1)->GetOrigin(),   
-		output, tolerance, t, x, pcoords, subId);
+	vtkMRMLModelNode* sourceModel = vtkMRMLModelNode::SafeDownCast(d->clipNodeComboBox->currentNode());
+	if(d->previewBox->isChecked() && previewWatcher.result() && sourceModel)
+	{
+		if(!previewModel)
+		{
+			vtkSmartPointer<vtkMRMLModelNode> model = vtkSmartPointer<vtkMRMLModelNode>::New();
+			model->SetName("Clip Preview");
+			model->SetHideFromEditors(1);
+			model->SetSaveWithScene(0);
+			model->SetScene(mrmlScene);
+			vtkSmartPointer<vtkMRMLModelDisplayNode> display = vtkSmartPointer<vtkMRMLModelDisplayNode>::New();
+			display->SetScene(mrmlScene);
+			display->SetColor(1.0, 1.0, 0.0);
+			display->SetSaveWithScene(0);
+			mrmlScene->AddNode(display);
+			model->SetAndObserveDisplayNodeID(display->GetID());
+			mrmlScene->AddNode(model);
+			previewModel = model;
+		}
+		previewModel->SetAndObservePolyData(previewResult);
+		previewModel->GetModelDisplayNode()->SetInputPolyData(previewResult);
+		//the displayed poly data is never written by the worker again
+		previewResult = vtkSmartPointer<vtkPolyData>::New();
 
-	delete []output;
+		//hide the source model so that it does not overlap the preview
+		if(previewHiddenNodeID.isEmpty() && sourceModel->GetDisplayNode())
+		{
+			sourceModel->GetDisplayNode()->SetVisibility(0);
+			previewHiddenNodeID = sourceModel->GetID();
+		}
+	}
 
-	if (intersection != 0) 
-		return true;
-	else
-		return false;
+	if(previewPending)
+	{
+		previewPending = false;
+		updatePreview();
+	}
+	else if(d->previewBox->isChecked() && previewModel && !previewInteracting &&
+		previewLevel < vtkSlicerSmartModelClipLogic::PreviewFull)
+	{
+		//a level aborted by a click without a move is clipped again
+		startPreview(previewWatcher.result() ? previewLevel + 1 : previewLevel);
+	}
 }
 
+void qSlicerSmartModelClipModuleWidget::removePreviewModel()
+{
+	vtkMRMLScene *mrmlScene = qSlicerApplication::application()->mrmlScene();
 
+	if(previewModel && mrmlScene->IsNodePresent(previewModel))
+	{
+		if(previewModel->GetDisplayNode())
+			mrmlScene->RemoveNode(previewModel->GetDisplayNode());
+		mrmlScene->RemoveNode(previewModel);
+	}
+	previewModel = 0;
 
-
-
-
+	if(!previewHiddenNodeID.isEmpty())
+	{
+		vtkMRMLModelNode* hiddenModel = vtkMRMLModelNode::SafeDownCast(
+			mrmlScene->GetNodeByID(previewHiddenNodeID.toLatin1().data()));
+		if(hiddenModel && hiddenModel->GetDisplayNode())
+			hiddenModel->GetDisplayNode()->SetVisibility(1);
+		previewHiddenNodeID.clear();
+	}
+}
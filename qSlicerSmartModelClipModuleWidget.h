@@ -19,6 +19,10 @@
 #define __qSlicerSmartModelClipModuleWidget_h
 
 #include <Qt/qlist.h>
+#include <QFutureWatcher>
+#include <QMap>
+#include <QStringList>
+#include <QTimer>
 
 // SlicerQt includes
 #include "qSlicerAbstractModuleWidget.h"
@@ -32,14 +36,16 @@
 #include <vtkPlaneCollection.h>
 #include <vtkPolyData.h>
 #include <vtkSmartPointer.h>
-#include <vtkImplicitBoolean.h>
 #include <vtkAppendPolyData.h>
+#include <vtkCollection.h>
 //#include <vtkPlaneWidget.h>
 #include "vtkQuadPlaneWidget.h"
 #include "vtkQuadPlaneWidgetPlus.h"
 #include "vtkSpinningPlaneWidget.h"
+#include "vtkOsteotomyPlaneChain.h"
 
 class qSlicerSmartModelClipModuleWidgetPrivate;
+class vtkMRMLModelNode;
 class vtkMRMLNode;
 
 /// \ingroup Slicer_QtModules_ExtensionTemplate
@@ -70,73 +76,110 @@ public slots:
 	void SetPlaneVisibility();
 	void setDepthPlane();
 	void clip();
+	void batchClip();
+	void cancelClip();
+	void exportTimings();
+	void exportPlaneChain();
 	void reverseClippingPlane();
 	void reverseDepthPlane();
+	void setPreviewEnabled(bool enabled);
+	void updatePreview();
+	void buildPreviewPyramid();
+	void restorePlaneChain(vtkMRMLNode* node);
+
+protected slots:
+	void onClipFinished();
+	void updateClipProgress();
+	void onResultDisplayModified(vtkObject* caller);
+	void onResultNodeDeleted(vtkObject* caller);
+	void onSceneStartSave();
+	void onSceneEndSave();
+	void onPreviewFinished();
+	void onPlaneInteractionStarted();
+	void onPlaneInteractionEnded();
 
 protected:
 	QScopedPointer<qSlicerSmartModelClipModuleWidgetPrivate> d_ptr;
 
 	virtual void setup();
 
-	QList<vtkSmartPointer<vtkPolyData>> reservedList;
-	QList<vtkSmartPointer<vtkPolyData>> clippedList;
+	// entries of the clip history of the logic, by result model node and by its display node
+	QMap<vtkObject*, int> historyModelNodes;
+	QMap<vtkObject*, int> historyDisplayNodes;
 
 	int timesOfClip;
 	int numOfFiducials;
 
 private:
-	//The algorithm of model clipping is based on recursion
-	vtkSmartPointer<vtkImplicitBoolean> makeBody(int m,int n);
-
-	//Specify the depth plane to clip the model 
-	vtkSmartPointer<vtkImplicitBoolean> SetClipDepth(vtkSmartPointer<vtkImplicitFunction>);
-
     // get the position of a fiducial and return its coordinates.The function returns 0 if no fiducial is on the scenery.
 	double* getPositionOfFiducials();
 
-    // If the last plane's line segment is intersected with its previous planes' line segments twice,we define the 
-    // first plane Of clipping model is the larger sequence number.Or we define the first plane Of clipping model 
-    // is the plane 0
-	int determineFirstPlaneOfClipping();
-
 	// calculate the intersection point of the plane(which pass through Origin of plane m-2,
     // Point2 of plane m-2 and Point2 of plane m-1)and the line (which pass through Point3 and Point2 
     // of plane m).We define this intersection point as the plane m 's new coordinates of point2's.
     // We do this because it's convenient to judge whether the plane m is intersected with the previous plane
 	double* CalIntersectionPointOfPlaneAndLine(int m);
 
-	// judge whether the plane i is inside plane i-1(i>=1)
-	int isPlaneInside(int i);
-
-	// extend a line segment on plane i,the line of which pass through Point2,
-    // from the Origin on the plane to infinitive
-	double* extendLineSegment(int);
-
-	// extend a line segment on plane i reversely,which pass through Origin,
-    // from the Point2 on the plane to infinitive
-	double* reverseExtendLineSegment(int i);//the first plane is m
-
-	// judge whether the plane i will intersect with the previous plane from plane m to plane i-2
-    // the line segment of plane i is extended infinitely on both of the line segment direction
-	bool isIntersect1(int,int);
-
-	bool isIntersect2(int,int);
-
-	// If the last plane's line segment is intersected with its previous planes' line segments twice,we define the 
-    // first plane Of clipping model is the larger sequence number.This function checks whteher the final plane's extended
-    // line segment will intersected with the line segment of plane m.
-	bool isInterSectWithTheSingleLineSegment(int m);
-
 	// Point2 coordinates of first two planes satisfy such requirements that the line segment of Point2 and Point3 is
     // perpendicular with the line segment of Origin and Point1.
 	double* CalculatePoint2CoordinatesOfFirstTwoPlanes(
 		double* newPlaneOrigin,double* newPlanePoint1,double* newPlanePoint2);
 
+	// copy the corners of the plane widgets, the depth plane and the reverse flags into planeChain
+	void updatePlaneChain();
+
+	// GUI-free description of the clipping path handed to the logic
+	vtkSmartPointer<vtkOsteotomyPlaneChain> planeChain;
+
+	// update planeChain and copy it into the selected osteotomy plan node
+	void storePlaneChain();
+	bool storingPlaneChain;
+
 	bool isReversedClippingPlane;
 	bool isReversedDepthPlane;
 
 	void setButtonState();
 
+	// clip the models of clipNodeIDs now, or once the running clip has stopped
+	void requestClip();
+	// snapshot the models and the plane chain and clip them on a worker thread
+	void startClip();
+
+	// the worker only reads clipSources and clipChain and only writes clipReservedParts and clipClippedParts
+	QFutureWatcher<bool> clipWatcher;
+	bool clipPending;
+	QStringList clipNodeIDs;
+	QTimer clipProgressTimer;
+	vtkSmartPointer<vtkCollection> clipSources;
+	QStringList clipSourceNames;
+	vtkSmartPointer<vtkOsteotomyPlaneChain> clipChain;
+	vtkSmartPointer<vtkCollection> clipReservedParts;
+	vtkSmartPointer<vtkCollection> clipClippedParts;
+
+	// hand a result to the clip history, which compresses the least recently used results
+	// beyond its memory budget; a compressed result is hidden and restored when shown again
+	void addToClipHistory(vtkMRMLModelNode* model);
+	void updateClipHistoryVisibility();
+
+	// re-clip the preview proxy whenever a plane widget is dragged
+	void observePlaneWidget(vtkQuadPlaneWidget* widget);
+	// snapshot the plane chain and clip a level of the preview pyramid on a worker thread
+	void startPreview(int level);
+	void removePreviewModel();
+
+	// the worker only reads previewChain and previewSource and only writes previewResult
+	QFutureWatcher<bool> previewWatcher;
+	QFuture<void> pyramidFuture;
+	bool previewPending;
+	// coarse levels are clipped while a handle is held, finer ones once it is released
+	bool previewInteracting;
+	int previewLevel;
+	vtkSmartPointer<vtkOsteotomyPlaneChain> previewChain;
+	vtkSmartPointer<vtkPolyData> previewSource;
+	vtkSmartPointer<vtkPolyData> previewResult;
+	vtkMRMLModelNode* previewModel;
+	QString previewHiddenNodeID;
+
 private:
 	Q_DECLARE_PRIVATE(qSlicerSmartModelClipModuleWidget);
 	Q_DISABLE_COPY(qSlicerSmartModelClipModuleWidget);
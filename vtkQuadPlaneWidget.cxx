@@ -20,16 +20,20 @@
 #include "vtkCallbackCommand.h"
 #include "vtkCamera.h"
 #include "vtkCellArray.h"
+#include "vtkCellData.h"
 #include "vtkCellPicker.h"
 #include "vtkConeSource.h"
 #include "vtkDoubleArray.h"
 #include "vtkFloatArray.h"
+#include "vtkIntArray.h"
 #include "vtkLineSource.h"
 #include "vtkMath.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlane.h"
 #include "vtkQuadPlaneSource.h"
 #include "vtkPlanes.h"
+#include "vtkPointData.h"
+#include "vtkPolygon.h"
 #include "vtkPolyData.h"
 #include "vtkPolyDataMapper.h"
 #include "vtkProperty.h"
@@ -37,6 +41,7 @@
 #include "vtkRenderer.h"
 #include "vtkSphereSource.h"
 #include "vtkTransform.h"
+#include "vtkUnsignedCharArray.h"
 #include "vtkLineWidget.h"
 
 
@@ -48,6 +53,21 @@ vtkQuadPlaneWidget::vtkQuadPlaneWidget() : vtkPolyDataSourceWidget()
 {
   this->State = vtkQuadPlaneWidget::Start;
   this->EventCallbackCommand->SetCallback(vtkQuadPlaneWidget::ProcessEvents);
+
+  this->MotionInterval = 16;
+  this->MotionPending = 0;
+  this->MotionTimerId = 0;
+  this->MotionObserverTag = 0;
+  this->MotionFrom[0] = this->MotionFrom[1] = 0;
+  this->MotionCallbackCommand = vtkCallbackCommand::New();
+  this->MotionCallbackCommand->SetClientData(this);
+  this->MotionCallbackCommand->SetCallback(vtkQuadPlaneWidget::ProcessMotionTimer);
+
+  this->CornersPositioned = 0;
+  this->OutlinePositioned = 0;
+  this->SelectedRepresentation = -1;
+  this->SelectedRenderer = NULL;
+  this->SelectedProperty = NULL;
   
   this->NormalToXAxis = 0;
   this->NormalToYAxis = 0;
@@ -143,6 +163,45 @@ vtkQuadPlaneWidget::vtkQuadPlaneWidget() : vtkPolyDataSourceWidget()
   }
   this->UpdateBoundary();
 
+  // The parts of the widget drawn by the glyph actor when they are merged
+  for (i=0; i<4; i++)
+    {
+    this->GlyphPartActors[vtkQuadPlaneWidget::HandlePart+i] = this->Handle[i];
+    this->GlyphPartSources[vtkQuadPlaneWidget::HandlePart+i] = this->HandleGeometry[i];
+    this->GlyphPartActors[vtkQuadPlaneWidget::BoundaryPart+i] = this->BoundaryActor[i];
+    this->GlyphPartSources[vtkQuadPlaneWidget::BoundaryPart+i] = this->BoundarySource[i];
+    }
+  this->GlyphPartActors[vtkQuadPlaneWidget::NormalPart] = this->LineActor;
+  this->GlyphPartSources[vtkQuadPlaneWidget::NormalPart] = this->LineSource;
+  this->GlyphPartActors[vtkQuadPlaneWidget::NormalPart+1] = this->ConeActor;
+  this->GlyphPartSources[vtkQuadPlaneWidget::NormalPart+1] = this->ConeSource;
+  this->GlyphPartActors[vtkQuadPlaneWidget::NormalPart+2] = this->LineActor2;
+  this->GlyphPartSources[vtkQuadPlaneWidget::NormalPart+2] = this->LineSource2;
+  this->GlyphPartActors[vtkQuadPlaneWidget::NormalPart+3] = this->ConeActor2;
+  this->GlyphPartSources[vtkQuadPlaneWidget::NormalPart+3] = this->ConeSource2;
+
+  this->MergedGlyphs = 0;
+  this->GlyphPartPointIds[0] = 0;
+  for (i=0; i<vtkQuadPlaneWidget::NumberOfGlyphParts; i++)
+    {
+    this->GlyphPartPointIds[i+1] = 0;
+    this->GlyphPartFacets[i] = 0;
+    this->GlyphPartSourceTimes[i] = 0;
+    }
+  this->GlyphPolyData = vtkPolyData::New();
+  this->GlyphMapper = vtkPolyDataMapper::New();
+  this->GlyphMapper->SetInput(this->GlyphPolyData);
+  this->GlyphMapper->SetScalarModeToUseCellData();
+  this->GlyphActor = vtkActor::New();
+  this->GlyphActor->SetMapper(this->GlyphMapper);
+  // some light on the lines, whose normals are the plane normal
+  this->GlyphActor->GetProperty()->SetAmbient(0.3);
+  this->GlyphActor->GetProperty()->SetDiffuse(0.7);
+  this->GlyphObserverTag = 0;
+  this->GlyphCallbackCommand = vtkCallbackCommand::New();
+  this->GlyphCallbackCommand->SetClientData(this);
+  this->GlyphCallbackCommand->SetCallback(vtkQuadPlaneWidget::ProcessGlyphEvents);
+
   this->Transform = vtkTransform::New();
 
   // Define the point coordinates
@@ -157,28 +216,16 @@ vtkQuadPlaneWidget::vtkQuadPlaneWidget() : vtkPolyDataSourceWidget()
   //Manage the picking stuff
   this->HandlePicker = vtkCellPicker::New();
   this->HandlePicker->SetTolerance(0.001);
-  for (i=0; i<4; i++)
-    {
-    this->HandlePicker->AddPickList(this->Handle[i]);
-    }
   this->HandlePicker->PickFromListOn();
 
   this->PlanePicker = vtkCellPicker::New();
   this->PlanePicker->SetTolerance(0.005); //need some fluff
-  this->PlanePicker->AddPickList(this->PlaneActor);
-  this->PlanePicker->AddPickList(this->ConeActor);
-  this->PlanePicker->AddPickList(this->LineActor);
-  this->PlanePicker->AddPickList(this->ConeActor2);
-  this->PlanePicker->AddPickList(this->LineActor2);
   this->PlanePicker->PickFromListOn();
 
   this->BoundaryPicker = vtkCellPicker::New();
   this->BoundaryPicker->SetTolerance(0.005);
-  for (i=0; i<4; i++)
-  {
-	  this->BoundaryPicker->AddPickList(this->BoundaryActor[i]);
-  }
   this->BoundaryPicker->PickFromListOn();
+  this->UpdatePickLists();
   
   this->CurrentHandle = NULL;
   
@@ -202,6 +249,9 @@ vtkQuadPlaneWidget::vtkQuadPlaneWidget() : vtkPolyDataSourceWidget()
 
 vtkQuadPlaneWidget::~vtkQuadPlaneWidget()
 {
+  this->StopMotionTimer();
+  this->MotionCallbackCommand->Delete();
+
   this->PlaneActor->Delete();
   this->PlaneMapper->Delete();
   this->PlaneSource->Delete();
@@ -240,6 +290,15 @@ vtkQuadPlaneWidget::~vtkQuadPlaneWidget()
   this->ConeMapper2->Delete();
   this->ConeSource2->Delete();
 
+  if ( this->GlyphObserverTag && this->CurrentRenderer )
+    {
+    this->CurrentRenderer->RemoveObserver(this->GlyphObserverTag);
+    }
+  this->GlyphCallbackCommand->Delete();
+  this->GlyphActor->Delete();
+  this->GlyphMapper->Delete();
+  this->GlyphPolyData->Delete();
+
   this->LineActor2->Delete();
   this->LineMapper2->Delete();
   this->LineSource2->Delete();
@@ -341,21 +400,16 @@ void vtkQuadPlaneWidget::SetEnabled(int enabling)
     // turn on the handles
     for (int j=0; j<4; j++)
       {
-      this->CurrentRenderer->AddActor(this->Handle[j]);
       this->Handle[j]->SetProperty(this->HandleProperty);
-	  this->CurrentRenderer->AddActor(this->BoundaryActor[j]);
 	  this->BoundaryActor[j]->SetProperty(this->BoundaryProperty);
       }
 
     // add the normal vector
-    this->CurrentRenderer->AddActor(this->LineActor);
     this->LineActor->SetProperty(this->HandleProperty);
-    this->CurrentRenderer->AddActor(this->ConeActor);
     this->ConeActor->SetProperty(this->HandleProperty);
-    this->CurrentRenderer->AddActor(this->LineActor2);
     this->LineActor2->SetProperty(this->HandleProperty);
-    this->CurrentRenderer->AddActor(this->ConeActor2);
     this->ConeActor2->SetProperty(this->HandleProperty);
+    this->AddGlyphActors();
 
     this->SelectRepresentation();
     this->InvokeEvent(vtkCommand::EnableEvent,NULL);
@@ -374,24 +428,18 @@ void vtkQuadPlaneWidget::SetEnabled(int enabling)
     
     this->Enabled = 0;
 
+    // drop the motion not applied yet
+    this->StopMotionTimer();
+
     // don't listen for events any more
     this->Interactor->RemoveObserver(this->EventCallbackCommand);
 
     // turn off the plane
     this->CurrentRenderer->RemoveActor(this->PlaneActor);
+    this->SelectedRenderer = NULL;
 
-    // turn off the handles
-    for (int i=0; i<4; i++)
-      {
-      this->CurrentRenderer->RemoveActor(this->Handle[i]);
-	  this->CurrentRenderer->RemoveActor(this->BoundaryActor[i]);
-      }
-
-    // turn off the normal vector
-    this->CurrentRenderer->RemoveActor(this->LineActor);
-    this->CurrentRenderer->RemoveActor(this->ConeActor);
-    this->CurrentRenderer->RemoveActor(this->LineActor2);
-    this->CurrentRenderer->RemoveActor(this->ConeActor2);
+    // turn off the handles, the boundaries and the normal vector
+    this->RemoveGlyphActors();
 
     this->CurrentHandle = NULL;
     this->InvokeEvent(vtkCommand::DisableEvent,NULL);
@@ -408,6 +456,12 @@ void vtkQuadPlaneWidget::ProcessEvents(vtkObject* vtkNotUsed(object),
 {
   vtkQuadPlaneWidget* self = reinterpret_cast<vtkQuadPlaneWidget *>( clientdata );
 
+  // a button changes the state, so the pending motion is applied first
+  if ( event != vtkCommand::MouseMoveEvent )
+    {
+    self->ApplyPendingMotion();
+    }
+
   //okay, let's do the right thing
   switch(event)
     {
@@ -430,11 +484,457 @@ void vtkQuadPlaneWidget::ProcessEvents(vtkObject* vtkNotUsed(object),
       self->OnRightButtonUp();
       break;
     case vtkCommand::MouseMoveEvent:
-      self->OnMouseMove();
+      self->QueueMouseMove();
       break;
     }
 }
 
+void vtkQuadPlaneWidget::ProcessMotionTimer(vtkObject* vtkNotUsed(object), 
+                                            unsigned long vtkNotUsed(event),
+                                            void* clientdata, 
+                                            void* calldata)
+{
+  vtkQuadPlaneWidget* self = reinterpret_cast<vtkQuadPlaneWidget *>( clientdata );
+  int* timerId = reinterpret_cast<int *>( calldata );
+
+  // the timers of the other observers are left to them
+  if ( !self->MotionPending || !timerId || *timerId != self->MotionTimerId )
+    {
+    return;
+    }
+  self->MotionCallbackCommand->SetAbortFlag(1);
+  self->ApplyPendingMotion();
+}
+
+// Mouse moves of an interaction are not applied as they arrive: the position
+// before the first of them is kept and a one shot timer is started. Moves
+// arriving meanwhile only advance the interactor's event position, and when
+// the timer fires the whole motion is applied at once, so the plane, the
+// handles and the boundaries are updated, InteractionEvent is invoked and the
+// view is rendered once per MotionInterval however fast the moves come.
+// Only the translations are coalesced: the angles of Rotate() and Spin() and
+// the factor of Scale() depend on the cursor position and the length of each
+// move, so one move over the whole motion would not give the same plane as
+// the moves one by one. Those interactions apply every move as it arrives.
+void vtkQuadPlaneWidget::QueueMouseMove()
+{
+  if ( this->State == vtkQuadPlaneWidget::Outside || 
+       this->State == vtkQuadPlaneWidget::Start ||
+       this->State == vtkQuadPlaneWidget::Rotating ||
+       this->State == vtkQuadPlaneWidget::Spinning ||
+       this->State == vtkQuadPlaneWidget::Scaling ||
+       this->MotionInterval <= 0 )
+    {
+    this->OnMouseMove();
+    return;
+    }
+
+  this->EventCallbackCommand->SetAbortFlag(1);
+  if ( this->MotionPending )
+    {
+    return;
+    }
+
+  this->Interactor->GetLastEventPosition(this->MotionFrom);
+  this->MotionTimerId = this->Interactor->CreateOneShotTimer(this->MotionInterval);
+  if ( !this->MotionTimerId ) //no timer support, apply the move now
+    {
+    this->OnMouseMove();
+    return;
+    }
+  this->MotionObserverTag = this->Interactor->AddObserver(
+    vtkCommand::TimerEvent, this->MotionCallbackCommand, this->Priority);
+  this->MotionPending = 1;
+}
+
+void vtkQuadPlaneWidget::ApplyPendingMotion()
+{
+  if ( !this->MotionPending )
+    {
+    return;
+    }
+  this->StopMotionTimer();
+
+  // OnMouseMove() moves the plane from the last event position to the event
+  // position, so the last one is pointed to where the pending motion started
+  int lastEventPosition[2];
+  this->Interactor->GetLastEventPosition(lastEventPosition);
+  this->Interactor->SetLastEventPosition(this->MotionFrom);
+  this->OnMouseMove();
+  this->Interactor->SetLastEventPosition(lastEventPosition);
+}
+
+void vtkQuadPlaneWidget::StopMotionTimer()
+{
+  if ( !this->MotionPending )
+    {
+    return;
+    }
+  this->MotionPending = 0;
+  if ( this->Interactor )
+    {
+    this->Interactor->RemoveObserver(this->MotionObserverTag);
+    this->Interactor->DestroyTimer(this->MotionTimerId);
+    }
+}
+
+void vtkQuadPlaneWidget::ProcessGlyphEvents(vtkObject* vtkNotUsed(object), 
+                                            unsigned long vtkNotUsed(event),
+                                            void* clientdata, 
+                                            void* vtkNotUsed(calldata))
+{
+  // the renderer is about to render: bring the merged glyphs up to date
+  reinterpret_cast<vtkQuadPlaneWidget *>( clientdata )->UpdateGlyphs();
+}
+
+void vtkQuadPlaneWidget::SetMergedGlyphs(int merged)
+{
+  merged = merged ? 1 : 0;
+  if ( merged == this->MergedGlyphs )
+    {
+    return;
+    }
+
+  int shown = this->Enabled && this->CurrentRenderer;
+  if ( shown )
+    {
+    this->RemoveGlyphActors();
+    }
+  this->MergedGlyphs = merged;
+  this->UpdatePickLists();
+  if ( shown )
+    {
+    this->AddGlyphActors();
+    this->Interactor->Render();
+    }
+  this->Modified();
+}
+
+void vtkQuadPlaneWidget::AddGlyphActors()
+{
+  if ( this->MergedGlyphs )
+    {
+    this->UpdateGlyphs();
+    this->CurrentRenderer->AddActor(this->GlyphActor);
+    this->GlyphObserverTag = this->CurrentRenderer->AddObserver(
+      vtkCommand::StartEvent, this->GlyphCallbackCommand);
+    }
+  else
+    {
+    for (int i=0; i<vtkQuadPlaneWidget::NumberOfGlyphParts; i++)
+      {
+      this->CurrentRenderer->AddActor(this->GlyphPartActors[i]);
+      }
+    }
+}
+
+void vtkQuadPlaneWidget::RemoveGlyphActors()
+{
+  for (int i=0; i<vtkQuadPlaneWidget::NumberOfGlyphParts; i++)
+    {
+    this->CurrentRenderer->RemoveActor(this->GlyphPartActors[i]);
+    }
+  this->CurrentRenderer->RemoveActor(this->GlyphActor);
+  if ( this->GlyphObserverTag )
+    {
+    this->CurrentRenderer->RemoveObserver(this->GlyphObserverTag);
+    this->GlyphObserverTag = 0;
+    }
+}
+
+// The spheres keep their normals. The cones have only polygons and no
+// normals, so each of their facets gets its own points and normal; the lines
+// get the plane normal.
+static int IsFacetedGlyph(vtkPolyData *pd)
+{
+  return ( !pd->GetPointData()->GetNormals() && pd->GetPolys()->GetNumberOfCells() > 0 );
+}
+
+// Number of points of a part in the merged glyphs
+static vtkIdType GetNumberOfGlyphPoints(vtkPolyData *pd)
+{
+  if ( !IsFacetedGlyph(pd) )
+    {
+    return pd->GetNumberOfPoints();
+    }
+  vtkIdType numberOfPoints = 0;
+  vtkIdType npts, *pts;
+  vtkCellArray *polys = pd->GetPolys();
+  for (polys->InitTraversal(); polys->GetNextCell(npts,pts); )
+    {
+    numberOfPoints += npts;
+    }
+  return numberOfPoints;
+}
+
+// The part actors are kept as they are when the glyphs are merged: they are
+// no longer in the renderer, but their sources, visibility and properties
+// are still set by the widget. Each part has a fixed range of points in the
+// merged polydata: when a source changes only the coordinates of its range
+// are rewritten, and the cells and colors are rebuilt only when a visibility
+// or a property changes. A source giving another number of points lays the
+// ranges out again.
+void vtkQuadPlaneWidget::UpdateGlyphs()
+{
+  if ( !this->MergedGlyphs )
+    {
+    return;
+    }
+
+  int i;
+  int layout = ( this->GlyphPolyData->GetPoints() == NULL );
+  int moved = 0;
+  int changed[vtkQuadPlaneWidget::NumberOfGlyphParts];
+  unsigned long mtime = 0;
+  for (i=0; i<vtkQuadPlaneWidget::NumberOfGlyphParts; i++)
+    {
+    vtkActor *actor = this->GlyphPartActors[i];
+    unsigned long actorTimes[2] = { actor->GetMTime(), actor->GetProperty()->GetMTime() };
+    for (int j=0; j<2; j++)
+      {
+      mtime = ( actorTimes[j] > mtime ? actorTimes[j] : mtime );
+      }
+
+    vtkPolyDataAlgorithm *source = this->GlyphPartSources[i];
+    changed[i] = ( source->GetMTime() != this->GlyphPartSourceTimes[i] );
+    if ( changed[i] || layout )
+      {
+      source->Update();
+      vtkPolyData *pd = source->GetOutput();
+      vtkIdType numberOfPoints =
+        this->GlyphPartPointIds[i+1] - this->GlyphPartPointIds[i];
+      if ( IsFacetedGlyph(pd) != this->GlyphPartFacets[i] ||
+           GetNumberOfGlyphPoints(pd) != numberOfPoints )
+        {
+        layout = 1;
+        }
+      moved = 1;
+      }
+    }
+  if ( !moved && mtime < this->GlyphsTime.GetMTime() )
+    {
+    return;
+    }
+
+  if ( layout )
+    {
+    for (i=0; i<vtkQuadPlaneWidget::NumberOfGlyphParts; i++)
+      {
+      vtkPolyData *pd = this->GlyphPartSources[i]->GetOutput();
+      this->GlyphPartFacets[i] = IsFacetedGlyph(pd);
+      this->GlyphPartPointIds[i+1] = this->GlyphPartPointIds[i] + GetNumberOfGlyphPoints(pd);
+      changed[i] = 1;
+      }
+    vtkPoints *points = vtkPoints::New();
+    points->SetNumberOfPoints(this->GlyphPartPointIds[vtkQuadPlaneWidget::NumberOfGlyphParts]);
+    vtkFloatArray *normals = vtkFloatArray::New();
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(points->GetNumberOfPoints());
+    normals->SetName("Normals");
+    this->GlyphPolyData->Initialize();
+    this->GlyphPolyData->SetPoints(points);
+    this->GlyphPolyData->GetPointData()->SetNormals(normals);
+    points->Delete();
+    normals->Delete();
+    }
+
+  if ( moved )
+    {
+    for (i=0; i<vtkQuadPlaneWidget::NumberOfGlyphParts; i++)
+      {
+      if ( changed[i] )
+        {
+        this->WriteGlyphPartPoints(i);
+        }
+      }
+    this->GlyphPolyData->GetPoints()->Modified();
+    this->GlyphPolyData->GetPointData()->GetNormals()->Modified();
+    this->GlyphPolyData->Modified();
+    }
+
+  if ( layout || mtime >= this->GlyphsTime.GetMTime() )
+    {
+    this->BuildGlyphCells();
+    }
+}
+
+// Write the points and normals of a part in its range of the merged glyphs
+void vtkQuadPlaneWidget::WriteGlyphPartPoints(int part)
+{
+  vtkPolyDataAlgorithm *source = this->GlyphPartSources[part];
+  vtkPolyData *pd = source->GetOutput();
+  vtkPoints *points = this->GlyphPolyData->GetPoints();
+  vtkDataArray *normals = this->GlyphPolyData->GetPointData()->GetNormals();
+  vtkIdType id = this->GlyphPartPointIds[part];
+  vtkIdType p;
+  if ( !this->GlyphPartFacets[part] )
+    {
+    vtkDataArray *pointNormals = pd->GetPointData()->GetNormals();
+    for (p=0; p<pd->GetNumberOfPoints(); p++, id++)
+      {
+      points->SetPoint(id, pd->GetPoint(p));
+      normals->SetTuple(id, pointNormals ? pointNormals->GetTuple(p) : this->Normal);
+      }
+    }
+  else
+    {
+    vtkIdType npts, *pts;
+    vtkCellArray *polys = pd->GetPolys();
+    for (polys->InitTraversal(); polys->GetNextCell(npts,pts); )
+      {
+      double n[3];
+      vtkPolygon::ComputeNormal(pd->GetPoints(), static_cast<int>(npts), pts, n);
+      for (p=0; p<npts; p++, id++)
+        {
+        points->SetPoint(id, pd->GetPoint(pts[p]));
+        normals->SetTuple(id, n);
+        }
+      }
+    }
+  this->GlyphPartSourceTimes[part] = source->GetMTime();
+}
+
+// Rebuild the cells of the visible parts over their ranges of points, with
+// the colors of their properties
+void vtkQuadPlaneWidget::BuildGlyphCells()
+{
+  vtkCellArray *lines = vtkCellArray::New();
+  vtkCellArray *polys = vtkCellArray::New();
+  vtkIntArray *partIds = vtkIntArray::New();
+  partIds->SetName("PartId");
+  vtkUnsignedCharArray *colors = vtkUnsignedCharArray::New();
+  colors->SetNumberOfComponents(3);
+  colors->SetName("Colors");
+
+  // The lines come before the polygons in the cell ids of a polydata, so
+  // the lines of all the parts are appended first
+  for (int pass=0; pass<2; pass++)
+    {
+    vtkCellArray *outCells = ( pass == 0 ? lines : polys );
+    for (int i=0; i<vtkQuadPlaneWidget::NumberOfGlyphParts; i++)
+      {
+      vtkActor *actor = this->GlyphPartActors[i];
+      if ( !actor->GetVisibility() || ( pass == 0 && this->GlyphPartFacets[i] ) )
+        {
+        continue;
+        }
+      vtkPolyData *pd = this->GlyphPartSources[i]->GetOutput();
+      vtkCellArray *cells = ( pass == 0 ? pd->GetLines() : pd->GetPolys() );
+      if ( cells->GetNumberOfCells() == 0 )
+        {
+        continue;
+        }
+
+      double *color = actor->GetProperty()->GetColor();
+      unsigned char rgb[3];
+      for (int c=0; c<3; c++)
+        {
+        rgb[c] = static_cast<unsigned char>(255.0 * color[c] + 0.5);
+        }
+
+      // the facets are numbered in order, the other cells keep the point
+      // ids of their part
+      vtkIdType offset = this->GlyphPartPointIds[i];
+      vtkIdType id = offset;
+      vtkIdType npts, *pts;
+      for (cells->InitTraversal(); cells->GetNextCell(npts,pts); )
+        {
+        outCells->InsertNextCell(npts);
+        for (vtkIdType p=0; p<npts; p++)
+          {
+          outCells->InsertCellPoint(this->GlyphPartFacets[i] ? id++ : offset + pts[p]);
+          }
+        partIds->InsertNextValue(i);
+        colors->InsertNextTupleValue(rgb);
+        }
+      }
+    }
+
+  // the cell links of a previous pick refer to the previous cells
+  this->GlyphPolyData->DeleteCells();
+  this->GlyphPolyData->SetLines(lines);
+  this->GlyphPolyData->SetPolys(polys);
+  this->GlyphPolyData->GetCellData()->Initialize();
+  this->GlyphPolyData->GetCellData()->SetScalars(colors);
+  this->GlyphPolyData->GetCellData()->AddArray(partIds);
+  lines->Delete();
+  polys->Delete();
+  partIds->Delete();
+  colors->Delete();
+
+  // a single line width for the boundaries and the normal lines
+  this->GlyphActor->GetProperty()->SetLineWidth(this->BoundaryProperty->GetLineWidth());
+  this->GlyphsTime.Modified();
+}
+
+void vtkQuadPlaneWidget::UpdatePickLists()
+{
+  int i;
+  this->HandlePicker->InitializePickList();
+  this->BoundaryPicker->InitializePickList();
+  this->PlanePicker->InitializePickList();
+  this->PlanePicker->AddPickList(this->PlaneActor);
+  if ( this->MergedGlyphs )
+    {
+    this->HandlePicker->AddPickList(this->GlyphActor);
+    this->BoundaryPicker->AddPickList(this->GlyphActor);
+    this->PlanePicker->AddPickList(this->GlyphActor);
+    return;
+    }
+
+  for (i=0; i<4; i++)
+    {
+    this->HandlePicker->AddPickList(this->Handle[i]);
+    this->BoundaryPicker->AddPickList(this->BoundaryActor[i]);
+    }
+  this->PlanePicker->AddPickList(this->ConeActor);
+  this->PlanePicker->AddPickList(this->LineActor);
+  this->PlanePicker->AddPickList(this->ConeActor2);
+  this->PlanePicker->AddPickList(this->LineActor2);
+}
+
+// Pick with one of the three pickers and return the picked prop, NULL if
+// none. A pick of the merged glyphs returns the part actor of the picked
+// cell, or NULL if that part is not one the picker is for (a boundary for the
+// handle picker), as if the parts were actors of their own.
+vtkProp* vtkQuadPlaneWidget::PickPart(vtkCellPicker *picker, int X, int Y)
+{
+  this->UpdateGlyphs();
+  picker->Pick(X,Y,0.0,this->CurrentRenderer);
+  vtkAssemblyPath *path = picker->GetPath();
+  if ( path == NULL )
+    {
+    return NULL;
+    }
+  vtkProp *prop = path->GetFirstNode()->GetViewProp();
+  if ( prop != this->GlyphActor )
+    {
+    return prop;
+    }
+
+  vtkIntArray *partIds = vtkIntArray::SafeDownCast(
+    this->GlyphPolyData->GetCellData()->GetArray("PartId"));
+  vtkIdType cellId = picker->GetCellId();
+  if ( !partIds || cellId < 0 || cellId >= partIds->GetNumberOfTuples() )
+    {
+    return NULL;
+    }
+  int part = partIds->GetValue(cellId);
+  int first = vtkQuadPlaneWidget::NormalPart;
+  int last = vtkQuadPlaneWidget::NumberOfGlyphParts;
+  if ( picker == this->HandlePicker )
+    {
+    first = vtkQuadPlaneWidget::HandlePart;
+    last = vtkQuadPlaneWidget::BoundaryPart;
+    }
+  else if ( picker == this->BoundaryPicker )
+    {
+    first = vtkQuadPlaneWidget::BoundaryPart;
+    last = vtkQuadPlaneWidget::NormalPart;
+    }
+  return ( part >= first && part < last ) ? this->GlyphPartActors[part] : NULL;
+}
+
 void vtkQuadPlaneWidget::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
@@ -521,6 +1021,8 @@ void vtkQuadPlaneWidget::PrintSelf(ostream& os, vtkIndent indent)
   double *pt3 = this->PlaneSource->GetPoint3();
 
   os << indent << "Resolution: " << res << "\n";
+  os << indent << "Motion Interval: " << this->MotionInterval << "\n";
+  os << indent << "Merged Glyphs: " << (this->MergedGlyphs ? "On\n" : "Off\n");
   os << indent << "Origin: (" << o[0] << ", "
      << o[1] << ", "
      << o[2] << ")\n";
@@ -537,30 +1039,58 @@ void vtkQuadPlaneWidget::PrintSelf(ostream& os, vtkIndent indent)
 
 void vtkQuadPlaneWidget::PositionHandles()
 {
-	
-  double *o = this->PlaneSource->GetOrigin();
-  double *pt1 = this->PlaneSource->GetPoint1();
-  double *pt2 = this->PlaneSource->GetPoint2();
-  double *pt3 = this->PlaneSource->GetPoint3();
-
-  this->HandleGeometry[0]->SetCenter(o);
-  this->HandleGeometry[1]->SetCenter(pt1);
-  this->HandleGeometry[2]->SetCenter(pt2);
-  this->HandleGeometry[3]->SetCenter(pt3);
+  double *corners[4];
+  corners[0] = this->PlaneSource->GetOrigin();
+  corners[1] = this->PlaneSource->GetPoint1();
+  corners[2] = this->PlaneSource->GetPoint2();
+  corners[3] = this->PlaneSource->GetPoint3();
+
+  // Only the glyphs of the corners that moved since the last call are
+  // updated: moving one handle leaves the three other spheres and the
+  // boundary opposite to it untouched.
+  int cornerModified[4];
+  int anyModified = 0;
+  for (int i=0; i<4; i++)
+    {
+    cornerModified[i] = !this->CornersPositioned ||
+      corners[i][0] != this->PositionedCorners[i][0] ||
+      corners[i][1] != this->PositionedCorners[i][1] ||
+      corners[i][2] != this->PositionedCorners[i][2];
+    if ( cornerModified[i] )
+      {
+      this->PositionedCorners[i][0] = corners[i][0];
+      this->PositionedCorners[i][1] = corners[i][1];
+      this->PositionedCorners[i][2] = corners[i][2];
+      this->HandleGeometry[i]->SetCenter(corners[i]);
+      anyModified = 1;
+      }
+    }
+  this->CornersPositioned = 1;
   
-  // set up the outline
+  // set up the outline, which is not kept up to date while it is not shown
   if ( this->Representation == VTK_PLANE_OUTLINE )
     {
-    this->PlaneOutline->GetPoints()->SetPoint(0,o);
-    this->PlaneOutline->GetPoints()->SetPoint(1,pt1);
-    //this->PlaneOutline->GetPoints()->SetPoint(2,x);
-	this->PlaneOutline->GetPoints()->SetPoint(2,pt2);
-    /*this->PlaneOutline->GetPoints()->SetPoint(3,pt2);*/
-	this->PlaneOutline->GetPoints()->SetPoint(3,pt3);
-    this->PlaneOutline->Modified();
+    if ( anyModified || !this->OutlinePositioned )
+      {
+      for (int i=0; i<4; i++)
+        {
+        this->PlaneOutline->GetPoints()->SetPoint(i,corners[i]);
+        }
+      this->PlaneOutline->Modified();
+      this->OutlinePositioned = 1;
+      }
+    }
+  else
+    {
+    this->OutlinePositioned = 0;
     }
   this->SelectRepresentation();
 
+  if ( !anyModified )
+    {
+    return;
+    }
+
   // Create the normal vector
   double center[3];
   this->PlaneSource->GetCenter(center);
@@ -587,7 +1117,7 @@ void vtkQuadPlaneWidget::PositionHandles()
   this->ConeSource2->SetCenter(p2);
   this->ConeSource2->SetDirection(this->Normal);
 
-  this->UpdateBoundary();
+  this->UpdateBoundary(cornerModified);
 }
 
 int vtkQuadPlaneWidget::HighlightHandle(vtkProp *prop)
@@ -692,37 +1222,31 @@ void vtkQuadPlaneWidget::OnLeftButtonDown()
 
 	// Okay, we can process this. Try to pick handles first;
 	// if no handles picked, then try to pick the plane.
-	vtkAssemblyPath *path;
-	this->HandlePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-	path = this->HandlePicker->GetPath();
+	vtkProp *prop = this->PickPart(this->HandlePicker, X, Y);
 
-	if ( path != NULL )
+	if ( prop != NULL )
 	{
 		this->State = vtkQuadPlaneWidget::Moving;
-		this->HighlightHandle(path->GetFirstNode()->GetViewProp());
+		this->HighlightHandle(prop);
 	}
 	else
 	{
-		this->BoundaryPicker->Pick(X,Y,0.0,this->CurrentRenderer);
-		path = this->BoundaryPicker->GetPath();
-		if ( path != NULL )
+		prop = this->PickPart(this->BoundaryPicker, X, Y);
+		if ( prop != NULL )
 		{
-			vtkProp *prop = path->GetFirstNode()->GetViewProp();
 			if(prop == this->BoundaryActor[0] || prop == this->BoundaryActor[1] ||
 				prop == this->BoundaryActor[2] || prop == this->BoundaryActor[3])
 			{
 				this->State = vtkQuadPlaneWidget::BoundaryDragging;
-				this->HighlightBoundary(path->GetFirstNode()->GetViewProp());
+				this->HighlightBoundary(prop);
 			}
 		}
 		else
 		{
-			this->PlanePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-			path = this->PlanePicker->GetPath();
+			prop = this->PickPart(this->PlanePicker, X, Y);
 
-			if ( path != NULL )
+			if ( prop != NULL )
 			{
-				vtkProp *prop = path->GetFirstNode()->GetViewProp();
 				if ( prop == this->ConeActor || prop == this->LineActor ||
 					prop == this->ConeActor2 || prop == this->LineActor2 )
 				{
@@ -795,21 +1319,18 @@ void vtkQuadPlaneWidget::OnMiddleButtonDown()
   
   // Okay, we can process this. If anything is picked, then we
   // can start pushing the plane.
-  vtkAssemblyPath *path;
-  this->HandlePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-  path = this->HandlePicker->GetPath();
-  if ( path != NULL )
+  vtkProp *prop = this->PickPart(this->HandlePicker, X, Y);
+  if ( prop != NULL )
     {
     this->State = vtkQuadPlaneWidget::Pushing;
     this->HighlightPlane(1);
     this->HighlightNormal(1);
-    this->HighlightHandle(path->GetFirstNode()->GetViewProp());
+    this->HighlightHandle(prop);
     }
   else
     {
-    this->PlanePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-    path = this->PlanePicker->GetPath();
-    if ( path == NULL ) //nothing picked
+    prop = this->PickPart(this->PlanePicker, X, Y);
+    if ( prop == NULL ) //nothing picked
       {
       this->State = vtkQuadPlaneWidget::Outside;
       return;
@@ -862,20 +1383,17 @@ void vtkQuadPlaneWidget::OnRightButtonDown()
   
   // Okay, we can process this. Try to pick handles first;
   // if no handles picked, then pick the bounding box.
-  vtkAssemblyPath *path;
-  this->HandlePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-  path = this->HandlePicker->GetPath();
-  if ( path != NULL )
+  vtkProp *prop = this->PickPart(this->HandlePicker, X, Y);
+  if ( prop != NULL )
     {
     this->State = vtkQuadPlaneWidget::Scaling;
     this->HighlightPlane(1);
-    this->HighlightHandle(path->GetFirstNode()->GetViewProp());
+    this->HighlightHandle(prop);
     }
   else //see if we picked the plane or a normal
     {
-    this->PlanePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-    path = this->PlanePicker->GetPath();
-    if ( path == NULL )
+    prop = this->PickPart(this->PlanePicker, X, Y);
+    if ( prop == NULL )
       {
       this->State = vtkQuadPlaneWidget::Outside;
       return;
@@ -1493,6 +2011,19 @@ void vtkQuadPlaneWidget::SelectRepresentation()
     return;
     }
 
+  // PositionHandles() calls this on every move: leave the renderer, the
+  // mapper and the property alone unless one of them is not the one the
+  // representation was last selected for
+  if ( this->Representation == this->SelectedRepresentation &&
+       this->CurrentRenderer == this->SelectedRenderer &&
+       this->PlaneActor->GetProperty() == this->SelectedProperty )
+    {
+    return;
+    }
+  this->SelectedRepresentation = this->Representation;
+  this->SelectedRenderer = this->CurrentRenderer;
+  this->SelectedProperty = this->PlaneActor->GetProperty();
+
   if ( this->Representation == VTK_PLANE_OFF )
     {
     this->CurrentRenderer->RemoveActor(this->PlaneActor);
@@ -1819,4 +2350,19 @@ void vtkQuadPlaneWidget::UpdateBoundary()
 	this->BoundarySource[2]->SetPoint2(this->GetPoint2());
 	this->BoundarySource[3]->SetPoint1(this->GetPoint2());
 	this->BoundarySource[3]->SetPoint2(this->GetOrigin());
+}
+
+// update the boundaries that end at a modified corner
+void vtkQuadPlaneWidget::UpdateBoundary(const int cornerModified[4])
+{
+	// corners at the ends of each boundary, as in UpdateBoundary()
+	static const int ends[4][2] = { {0,1}, {1,3}, {3,2}, {2,0} };
+	for(int i=0;i<4;i++)
+	{
+		if(cornerModified[ends[i][0]] || cornerModified[ends[i][1]])
+		{
+			this->BoundarySource[i]->SetPoint1(this->PositionedCorners[ends[i][0]]);
+			this->BoundarySource[i]->SetPoint2(this->PositionedCorners[ends[i][1]]);
+		}
+	}
 }
\ No newline at end of file
@@ -81,6 +81,7 @@
 #include "vtkSmartPointer.h"
 
 class vtkActor;
+class vtkCallbackCommand;
 class vtkCellPicker;
 class vtkConeSource;
 class vtkLineSource;
@@ -90,6 +91,7 @@ class vtkPolyData;
 class vtkPolyDataMapper;
 class vtkProp;
 class vtkProperty;
+class vtkRenderer;
 class vtkSphereSource;
 class vtkTransform;
 class vtkPlane;
@@ -275,6 +277,26 @@ public:
   virtual void SetPlaneProperty(vtkProperty*);
   vtkGetObjectMacro(PlaneProperty,vtkProperty);
   vtkGetObjectMacro(SelectedPlaneProperty,vtkProperty);
+
+  // Description:
+  // Interval in milliseconds at which the mouse moves of an interaction are
+  // applied. The moves arriving within an interval are coalesced into one
+  // update of the plane, one InteractionEvent and one render. 0 applies
+  // every move as it arrives. The default, 16, is about one per frame at 60Hz.
+  // Rotating, spinning and scaling always apply every move, as their result
+  // depends on the path of the cursor and not only on where it ends.
+  vtkSetClampMacro(MotionInterval,int,0,1000);
+  vtkGetMacro(MotionInterval,int);
+
+  // Description:
+  // Draw the handles, the boundaries and the normal vector with one actor
+  // instead of twelve. Their polydata are appended into one, with the part
+  // of each cell in a "PartId" cell array and the color of the property of
+  // the part as cell scalars, so highlighting works as before. Picking a
+  // cell of the merged glyphs stands for picking its part. Off by default.
+  virtual void SetMergedGlyphs(int merged);
+  vtkGetMacro(MergedGlyphs,int);
+  vtkBooleanMacro(MergedGlyphs,int);
   
 protected:
   vtkQuadPlaneWidget();
@@ -310,6 +332,23 @@ protected:
   virtual void OnRightButtonUp();
   virtual void OnMouseMove();
 
+  // Coalescing of the mouse moves: QueueMouseMove() is called for every
+  // MouseMoveEvent and ApplyPendingMotion() calls OnMouseMove() once for
+  // the moves received since the last one was applied.
+  static void ProcessMotionTimer(vtkObject* object, 
+                                 unsigned long event,
+                                 void* clientdata, 
+                                 void* calldata);
+  void QueueMouseMove();
+  void ApplyPendingMotion();
+  void StopMotionTimer();
+  int MotionInterval;
+  int MotionPending;
+  int MotionTimerId;
+  unsigned long MotionObserverTag;
+  int MotionFrom[2]; //last event position before the pending moves
+  vtkCallbackCommand *MotionCallbackCommand;
+
   // controlling ivars
   int NormalToXAxis;
   int NormalToYAxis;
@@ -317,6 +356,11 @@ protected:
   int Representation;
   void SelectRepresentation();
 
+  // state applied by the last SelectRepresentation(), the pointers are only compared
+  int          SelectedRepresentation;
+  vtkRenderer *SelectedRenderer;
+  vtkProperty *SelectedProperty;
+
   // the plane
   vtkActor          *PlaneActor;
   vtkPolyDataMapper *PlaneMapper;
@@ -367,6 +411,40 @@ protected:
   vtkCellPicker *PlanePicker;
   vtkCellPicker *BoundaryPicker;
   vtkActor *CurrentHandle;
+  vtkProp* PickPart(vtkCellPicker *picker, int X, int Y);
+  void UpdatePickLists();
+
+//BTX - the parts drawn by the glyph actor when merged, in PartId order
+  enum GlyphPart
+  {
+    HandlePart=0,
+    BoundaryPart=4,
+    NormalPart=8, //line, cone, line 2, cone 2
+    NumberOfGlyphParts=12
+  };
+//ETX
+  int                   MergedGlyphs;
+  vtkActor             *GlyphPartActors[NumberOfGlyphParts];
+  vtkPolyDataAlgorithm *GlyphPartSources[NumberOfGlyphParts];
+  vtkActor             *GlyphActor;
+  vtkPolyDataMapper    *GlyphMapper;
+  vtkPolyData          *GlyphPolyData;
+  vtkTimeStamp          GlyphsTime;
+  // points GlyphPartPointIds[i] to GlyphPartPointIds[i+1]-1 are those of part i
+  vtkIdType             GlyphPartPointIds[NumberOfGlyphParts+1];
+  int                   GlyphPartFacets[NumberOfGlyphParts];
+  unsigned long         GlyphPartSourceTimes[NumberOfGlyphParts];
+  vtkCallbackCommand   *GlyphCallbackCommand;
+  unsigned long         GlyphObserverTag;
+  static void ProcessGlyphEvents(vtkObject* object, 
+                                 unsigned long event,
+                                 void* clientdata, 
+                                 void* calldata);
+  void UpdateGlyphs();
+  void WriteGlyphPartPoints(int part);
+  void BuildGlyphCells();
+  void AddGlyphActors();
+  void RemoveGlyphActors();
   
   // Methods to manipulate the hexahedron.
   void MoveOrigin(double *p1, double *p2);
@@ -380,6 +458,13 @@ protected:
   void Push(double *p1, double *p2);
   void BoundaryDrag(double *p1, double *p2);
   void UpdateBoundary();
+  void UpdateBoundary(const int cornerModified[4]);
+
+  // Corners as of the last PositionHandles(), which updates only the glyphs
+  // of the corners that differ from them
+  double PositionedCorners[4][3];
+  int    CornersPositioned;
+  int    OutlinePositioned;
   
   // Plane normal, normalized
   double Normal[3];
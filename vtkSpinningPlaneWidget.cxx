@@ -48,6 +48,12 @@ void vtkSpinningPlaneWidget::ProcessEvents(vtkObject* vtkNotUsed(object),
 	
   vtkSpinningPlaneWidget* self = reinterpret_cast<vtkSpinningPlaneWidget *>( clientdata );
 
+  // a button changes the state, so the pending motion is applied first
+  if ( event != vtkCommand::MouseMoveEvent )
+    {
+    self->ApplyPendingMotion();
+    }
+
   //okay, let's do the right thing
   switch(event)
     {
@@ -64,7 +70,7 @@ void vtkSpinningPlaneWidget::ProcessEvents(vtkObject* vtkNotUsed(object),
       self->OnRightButtonUp();
       break;
     case vtkCommand::MouseMoveEvent:
-      self->OnMouseMove();
+      self->QueueMouseMove();
       break;
 
     }
@@ -84,35 +90,29 @@ void vtkSpinningPlaneWidget::OnLeftButtonDown()
   
   // Okay, we can process this. Try to pick handles first;
   // if no handles picked, then try to pick the plane.
-  vtkAssemblyPath *path;
-  this->HandlePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-  path = this->HandlePicker->GetPath();
-  if ( path != NULL )
+  vtkProp *prop = this->PickPart(this->HandlePicker, X, Y);
+  if ( prop != NULL )
   {
 	  this->State = vtkSpinningPlaneWidget::Moving;
-	  this->HighlightHandle(path->GetFirstNode()->GetViewProp());
+	  this->HighlightHandle(prop);
   }
   else
   {
-	  this->BoundaryPicker->Pick(X,Y,0.0,this->CurrentRenderer);
-	  path = this->BoundaryPicker->GetPath();
-	  if ( path != NULL )
+	  prop = this->PickPart(this->BoundaryPicker, X, Y);
+	  if ( prop != NULL )
 	  {
-		  vtkProp *prop = path->GetFirstNode()->GetViewProp();
 		  if(prop == this->BoundaryActor[2])
 		  {
 			  this->State = vtkQuadPlaneWidget::BoundaryDragging;
-			  this->HighlightBoundary(path->GetFirstNode()->GetViewProp());
+			  this->HighlightBoundary(prop);
 		  }
 	  }
 	  else 
 	  {
-		  this->PlanePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-		  path = this->PlanePicker->GetPath();
+		  prop = this->PickPart(this->PlanePicker, X, Y);
 
-		  if ( path != NULL )
+		  if ( prop != NULL )
 		  {
-			  vtkProp *prop = path->GetFirstNode()->GetViewProp();
 			  if ( prop == this->ConeActor || prop == this->LineActor ||
 				  prop == this->ConeActor2 || prop == this->LineActor2 )
 			  {
@@ -176,20 +176,17 @@ void vtkSpinningPlaneWidget::OnRightButtonDown()
   
   // Okay, we can process this. Try to pick handles first;
   // if no handles picked, then pick the bounding box.
-  vtkAssemblyPath *path;
-  this->HandlePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-  path = this->HandlePicker->GetPath();
-  if ( path != NULL )
+  vtkProp *prop = this->PickPart(this->HandlePicker, X, Y);
+  if ( prop != NULL )
     {
     this->State = vtkSpinningPlaneWidget::Scaling;
     this->HighlightPlane(1);
-    this->HighlightHandle(path->GetFirstNode()->GetViewProp());
+    this->HighlightHandle(prop);
     }
   else //see if we picked the plane or a normal
     {
-    this->PlanePicker->Pick(X,Y,0.0,this->CurrentRenderer);
-    path = this->PlanePicker->GetPath();
-    if ( path == NULL )
+    prop = this->PickPart(this->PlanePicker, X, Y);
+    if ( prop == NULL )
       {
       this->State = vtkSpinningPlaneWidget::Outside;
       return;